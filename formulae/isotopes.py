@@ -0,0 +1,324 @@
+"""
+Element and isotope database of the formula tools: nominal and exact
+isotope masses and natural abundances, one table for
+
+- the formula engine (el[] in smformula.cpp: monoisotopic masses),
+- the isotope pattern library (smisotope_lib.c: nominal masses and
+  abundances),
+- formulae/utils.py (eles).
+
+Run as script, it writes the C/C++ header of the database:
+
+    python3 formulae/isotopes.py > smisodb.h      ("make isodb")
+
+The labels D (2H), X (13C) and M (15N) are elements of their own with
+one isotope, which is the natural isotope of H, C and N.
+"""
+import sys
+
+# symbol, [(nominal mass, abundance), ...], in the order of the atom
+# numbers of smisotope_lib.c (H = 1, D = 2, ...)
+ELEMENTS = [
+    ("H", [(1, .999885), (2, .000115)]),
+    ("D", [(2, 1.0)]),
+    ("He", [(3, .00000134), (4, .99999866)]),
+    ("Li", [(6, .0759), (7, .9241)]),
+    ("Be", [(9, 1.00)]),
+    ("B", [(10, .199), (11, .801)]),
+    ("C", [(12, .9893), (13, .0107)]),
+    ("X", [(13, 1.0)]),
+    ("N", [(14, .99636), (15, .00364)]),
+    ("M", [(15, 1.0)]),
+    ("O", [(16, .99757), (17, .00038), (18, .00205)]),
+    ("F", [(19, 1.00)]),
+    ("Ne", [(20, .9048), (21, .0027), (22, .0925)]),
+    ("Na", [(23, 1.00)]),
+    ("Mg", [(24, .7899), (25, .1000), (26, .1101)]),
+    ("Al", [(27, 1.00)]),
+    ("Si", [(28, .92223), (29, .04685), (30, .03092)]),
+    ("P", [(31, 1.00)]),
+    ("S", [(32, .9499), (33, .0075), (34, .0425), (36, .0001)]),
+    ("Cl", [(35, .7576), (37, .2424)]),
+    ("Ar", [(36, .003365), (38, .000632), (40, .996003)]),
+    ("K", [(39, .932581), (40, .000117), (41, .067302)]),
+    ("Ca", [(40, .96941), (42, .00647), (43, .00135), (44, .02086), (46, .00004), (48, .00187)]),
+    ("Sc", [(45, 1.00)]),
+    ("Ti", [(46, .0825), (47, .0744), (48, .7372), (49, .0541), (50, .0518)]),
+    ("V", [(50, .00250), (51, .99750)]),
+    ("Cr", [(50, .04345), (52, .83789), (53, .09501), (54, .02365)]),
+    ("Mn", [(55, 1.00)]),
+    ("Fe", [(54, .05845), (56, .91754), (57, .02119), (58, .00282)]),
+    ("Co", [(59, 1.00)]),
+    ("Ni", [(58, .680769), (60, .262231), (61, .011399), (62, .036345), (64, .009256)]),
+    ("Cu", [(63, .6915), (65, .3085)]),
+    ("Zn", [(64, .48268), (66, .27975), (67, .04102), (68, .19024), (70, .00631)]),
+    ("Ga", [(69, .60108), (71, .39892)]),
+    ("Ge", [(70, .2038), (72, .2731), (73, .0776), (74, .3672), (76, .0783)]),
+    ("As", [(75, 1.00)]),
+    ("Se", [(74, .0089), (76, .0937), (77, .0763), (78, .2377), (80, .4961), (82, .0873)]),
+    ("Br", [(79, .5069), (81, .4931)]),
+    ("Kr", [(78, .00355), (80, .02286), (82, .11593), (83, .11500), (84, .56987), (86, .17279)]),
+    ("Rb", [(85, .7217), (87, .2783)]),
+    ("Sr", [(84, .0056), (86, .0986), (87, .0700), (88, .8258)]),
+    ("Y", [(89, 1.00)]),
+    ("Zr", [(90, .5145), (91, .1122), (92, .1715), (94, .1738), (96, .0280)]),
+    ("Nb", [(93, 1.00)]),
+    ("Mo", [(92, .1477), (94, .0923), (95, .1590), (96, .1668), (97, .0956), (98, .2419), (100, .0967)]),
+    ("Tc", [(98, 1.00)]),
+    ("Ru", [(96, .0554), (98, .0187), (99, .1276), (100, .1260), (101, .1706), (102, .3155), (104, .1862)]),
+    ("Rh", [(103, 1.00)]),
+    ("Pd", [(102, .0102), (104, .1114), (105, .2233), (106, .2733), (108, .2646), (110, .1172)]),
+    ("Ag", [(107, .51839), (109, .48161)]),
+    ("Cd", [(106, .0125), (108, .0089), (110, .1249), (111, .1280), (112, .2413), (113, .1222), (114, .2873), (116, .0749)]),
+    ("In", [(113, .0429), (115, .9571)]),
+    ("Sn", [(112, .0097), (114, .0066), (115, .0034), (116, .1454), (117, .0768), (118, .2422), (119, .0859), (120, .3258), (122, .0463), (124, .0579)]),
+    ("Sb", [(121, .5721), (123, .4279)]),
+    ("Te", [(120, .0009), (122, .0255), (123, .0089), (124, .0474), (125, .0707), (126, .1884), (128, .3174), (130, .3408)]),
+    ("I", [(127, 1.00)]),
+    ("Xe", [(124, .000952), (126, .000890), (128, .019102), (129, .264006), (130, .040710), (131, .212324), (132, .269086), (134, .104357), (136, .088573)]),
+    ("Cs", [(133, 1.00)]),
+    ("Ba", [(130, .00106), (132, .00101), (134, .02417), (135, .06592), (136, .07854), (137, .11232), (138, .71698)]),
+    ("La", [(138, .00090), (139, .99910)]),
+    ("Ce", [(136, .00185), (138, .00251), (140, .88450), (142, .11114)]),
+    ("Pr", [(141, 1.00)]),
+    ("Nd", [(142, .272), (143, .122), (144, .238), (145, .083), (146, .172), (148, .057), (150, .056)]),
+    ("Pm", [(145, 1.00)]),
+    ("Sm", [(144, .0307), (147, .1499), (148, .1124), (149, .1382), (150, .0738), (152, .2675), (154, .2275)]),
+    ("Eu", [(151, .4781), (153, .5219)]),
+    ("Gd", [(152, .0020), (154, .0218), (155, .1480), (156, .2047), (157, .1565), (158, .2484), (160, .2186)]),
+    ("Tb", [(159, 1.00)]),
+    ("Dy", [(156, .00056), (158, .00095), (160, .02329), (161, .18889), (162, .25475), (163, .24896), (164, .28260)]),
+    ("Ho", [(165, 1.00)]),
+    ("Er", [(162, .00139), (164, .01601), (166, .33503), (167, .22869), (168, .26978), (170, .14910)]),
+    ("Tm", [(169, 1.00)]),
+    ("Yb", [(168, .0013), (170, .0304), (171, .1428), (172, .2183), (173, .1613), (174, .3183), (176, .1276)]),
+    ("Lu", [(175, .9741), (176, .0259)]),
+    ("Hf", [(174, .0016), (176, .0526), (177, .1860), (178, .2728), (179, .1362), (180, .3508)]),
+    ("Ta", [(180, .00012), (181, .99988)]),
+    ("W", [(180, .0012), (182, .2650), (183, .1431), (184, .3064), (186, .2843)]),
+    ("Re", [(185, .3740), (187, .6260)]),
+    ("Os", [(184, .0002), (186, .0159), (187, .0196), (188, .1324), (189, .1615), (190, .2626), (192, .4078)]),
+    ("Ir", [(191, .373), (193, .627)]),
+    ("Pt", [(190, .00014), (192, .00782), (194, .32967), (195, .33832), (196, .25242), (198, .07163)]),
+    ("Au", [(197, 1.00)]),
+    ("Hg", [(196, .0015), (198, .0997), (199, .1687), (200, .2310), (201, .1318), (202, .2986), (204, .0687)]),
+    ("Tl", [(203, .2952), (205, .7048)]),
+    ("Pb", [(204, .014), (206, .241), (207, .221), (208, .524)]),
+    ("Bi", [(209, 1.00)]),
+    ("Po", [(209, 1.00)]),
+    ("At", [(210, 1.00)]),
+    ("Rn", [(222, 1.00)]),
+    ("Fr", [(223, 1.00)]),
+    ("Ra", [(226, 1.00)]),
+    ("Ac", [(227, 1.00)]),
+    ("Th", [(232, 1.00)]),
+    ("Pa", [(231, 1.00)]),
+    ("U", [(234, .000054), (235, .007204), (238, .992742)]),
+    ("Np", [(237, 1.00)]),
+    ("Pu", [(244, 1.00)]),
+]
+
+LABELS = {"D": ("H", 2), "X": ("C", 13), "M": ("N", 15)}
+
+# exact isotope masses (Da): the values the formula tools have always used
+# for the elements of el[] and elements.txt, NIST (2013) for the other
+# isotopes up to Br and I. Isotopes not listed are nominal only.
+EXACT = {
+    ("H", 1): 1.0078250321, ("H", 2): 2.0141017778,
+    ("He", 3): 3.0160293201, ("He", 4): 4.00260325413,
+    ("Li", 6): 6.0151228874, ("Li", 7): 7.0160034366,
+    ("Be", 9): 9.012183065,
+    ("B", 10): 10.01293695, ("B", 11): 11.00930536,
+    ("C", 12): 12.000000000, ("C", 13): 13.0033548378,
+    ("N", 14): 14.0030740048, ("N", 15): 15.0001088982,
+    ("O", 16): 15.9949146196, ("O", 17): 16.9991317565, ("O", 18): 17.9991596129,
+    ("F", 19): 18.99840322,
+    ("Ne", 20): 19.9924401762, ("Ne", 21): 20.993846685, ("Ne", 22): 21.991385114,
+    ("Na", 23): 22.9897692809,
+    ("Mg", 24): 23.985041697, ("Mg", 25): 24.985836976, ("Mg", 26): 25.982592968,
+    ("Al", 27): 26.98153853,
+    ("Si", 28): 27.9769265325, ("Si", 29): 28.9764946649, ("Si", 30): 29.973770136,
+    ("P", 31): 30.97376163,
+    ("S", 32): 31.972071, ("S", 33): 32.9714589098, ("S", 34): 33.967867004,
+    ("S", 36): 35.96708071,
+    ("Cl", 35): 34.96885268, ("Cl", 37): 36.965902602,
+    ("Ar", 36): 35.967545105, ("Ar", 38): 37.96273211, ("Ar", 40): 39.9623831237,
+    ("K", 39): 38.9637064864, ("K", 40): 39.963998166, ("K", 41): 40.9618252579,
+    ("Ca", 40): 39.962590863, ("Ca", 42): 41.95861783, ("Ca", 43): 42.95876644,
+    ("Ca", 44): 43.95548156, ("Ca", 46): 45.953689, ("Ca", 48): 47.95252276,
+    ("Sc", 45): 44.95590828,
+    ("Ti", 46): 45.95262772, ("Ti", 47): 46.95175879, ("Ti", 48): 47.94794198,
+    ("Ti", 49): 48.94786568, ("Ti", 50): 49.94478689,
+    ("V", 50): 49.94715601, ("V", 51): 50.94395704,
+    ("Cr", 50): 49.94604183, ("Cr", 52): 51.94050623, ("Cr", 53): 52.94064815,
+    ("Cr", 54): 53.93887916,
+    ("Mn", 55): 54.93804391,
+    ("Fe", 54): 53.93960899, ("Fe", 56): 55.93493633, ("Fe", 57): 56.93539284,
+    ("Fe", 58): 57.93327443,
+    ("Co", 59): 58.93319429,
+    ("Ni", 58): 57.93534241, ("Ni", 60): 59.93078588, ("Ni", 61): 60.93105557,
+    ("Ni", 62): 61.92834537, ("Ni", 64): 63.92796682,
+    ("Cu", 63): 62.92959772, ("Cu", 65): 64.9277897,
+    ("Zn", 64): 63.92914201, ("Zn", 66): 65.92603381, ("Zn", 67): 66.92712775,
+    ("Zn", 68): 67.92484455, ("Zn", 70): 69.9253192,
+    ("Ga", 69): 68.9255735, ("Ga", 71): 70.92470258,
+    ("Ge", 70): 69.92424875, ("Ge", 72): 71.922075826, ("Ge", 73): 72.923458956,
+    ("Ge", 74): 73.921177761, ("Ge", 76): 75.921402726,
+    ("As", 75): 74.92159457,
+    ("Se", 74): 73.922475934, ("Se", 76): 75.919213704, ("Se", 77): 76.919914154,
+    ("Se", 78): 77.91730928, ("Se", 80): 79.9165218, ("Se", 82): 81.9166995,
+    ("Br", 79): 78.9183371, ("Br", 81): 80.9162897,
+    ("I", 127): 126.9044719,
+}
+
+
+def isotopes(sym):
+    """[(nominal, exact or None, abundance), ...] of element sym"""
+    for s, iso in ELEMENTS:
+        if s == sym:
+            nat = LABELS.get(s, (s, None))[0]
+            return [(m, EXACT.get((nat, m)), fr) for m, fr in iso]
+    raise KeyError(sym)
+
+
+def mono_mass(sym):
+    """exact mass of the most abundant isotope (label: of its isotope), the
+    "monoisotopic" mass of the formula tools (56Fe, 80Se)"""
+    return max(isotopes(sym), key=lambda x: x[2])[1]
+
+
+def check():
+    """what smisodb.h checks at compile time"""
+    for s, iso in ELEMENTS:
+        assert abs(sum(fr for m, fr in iso) - 1.0) < 1e-3, s
+        assert all(a[0] < b[0] for a, b in zip(iso, iso[1:])), s
+        for m, exact, fr in isotopes(s):
+            assert exact is None or abs(exact - m) < 0.5, (s, m)
+    for lab, (nat, m) in LABELS.items():
+        assert isotopes(lab) == [(m, EXACT[(nat, m)], 1.0)], lab
+
+
+def header(out):
+    """writes smisodb.h"""
+    w = out.write
+    w("""/*
+
+SMISODB.H
+
+ Element and isotope database of the formula engine (el[] in
+ smformula.cpp) and the isotope pattern library (smisotope_lib.c).
+ GENERATED by formulae/isotopes.py ("make isodb"), edit that instead.
+
+ ISODB_ELEMENTS(E): E(symbol, 1st letter, 2nd letter or 0, atom #,
+ no. of isotopes, index of the first one in ISODB_ISOTOPES) in the order
+ of the atom numbers of smisotope_lib.c; the labels D (2H), X (13C) and
+ M (15N) are elements with one isotope.
+ ISODB_ISOTOPES(I): I(nominal mass, exact mass in Da or 0 if not in the
+ database, natural abundance).
+
+ In C++, the same as constexpr tables with isodb_mass(), and the
+ consistency of the data is checked at compile time.
+
+*/
+
+#ifndef SMISODB_H
+#define SMISODB_H
+
+""")
+    w("#define ISODB_ELEMENTS(E) \\\n")
+    first = 0
+    for atno, (s, iso) in enumerate(ELEMENTS, 1):
+        c2 = "'%s'" % s[1] if len(s) > 1 else "0"
+        w("E(%-5s '%s', %-3s, %2d, %2d, %3d) \\\n" % ('"%s",' % s, s[0], c2, atno, len(iso), first))
+        first += len(iso)
+    w("\n#define ISODB_ISOTOPES(I) \\\n")
+    for s, iso in ELEMENTS:
+        for k, (m, exact, fr) in enumerate(isotopes(s)):
+            w("I(%3d, %-14s, %-10s) %s\\\n" % (m, repr(exact) if exact else "0",
+                                               repr(fr), "/* %s */ " % s if k == 0 else ""))
+    w("""
+#define ISODB_NEL\t%d
+#define ISODB_NISO\t%d
+""" % (len(ELEMENTS), first))
+    w("""
+#ifdef __cplusplus
+
+struct isodb_isotope	{ int m; double mass; double fr; };
+struct isodb_element	{ const char *sym; int atno, niso, first; };
+
+#define ISODB_E(sym, c1, c2, atno, niso, first)	{ sym, atno, niso, first },
+#define ISODB_I(m, mass, fr)			{ m, mass, fr },
+constexpr isodb_element isodb_el[ISODB_NEL] = { ISODB_ELEMENTS(ISODB_E) };
+constexpr isodb_isotope isodb_iso[ISODB_NISO] = { ISODB_ISOTOPES(ISODB_I) };
+#undef ISODB_E
+#undef ISODB_I
+
+constexpr bool isodb_same(const char *a, const char *b)
+{
+return (*a == *b) && ((*a == 0) || isodb_same(a + 1, b + 1));
+}
+
+/* index of element 'sym' in isodb_el[], -1 if none */
+constexpr int isodb_find(const char *sym)
+{
+for (int i = 0; i < ISODB_NEL; i++)
+	if (isodb_same(isodb_el[i].sym, sym))
+		return i;
+return -1;
+}
+
+/* exact mass of isotope m of 'sym', of the most abundant one if m = 0
+   (the "monoisotopic" mass of el[]: 56Fe, 80Se); 0 if not in the database */
+constexpr double isodb_mass(const char *sym, int m = 0)
+{
+int e = isodb_find(sym), top = 0;
+
+if (e < 0)
+	return 0.0;
+for (int k = 0; k < isodb_el[e].niso; k++)
+	{
+	const isodb_isotope &p = isodb_iso[isodb_el[e].first + k];
+	if (p.m == m)
+		return p.mass;
+	if (p.fr > isodb_iso[isodb_el[e].first + top].fr)
+		top = k;
+	}
+return (m == 0) ? isodb_iso[isodb_el[e].first + top].mass : 0.0;
+}
+
+/* abundances add up to 1, isotopes by mass, exact masses near the nominal ones */
+constexpr bool isodb_consistent(void)
+{
+for (int e = 0; e < ISODB_NEL; e++)
+	{
+	double sum = 0.0;
+	for (int k = 0; k < isodb_el[e].niso; k++)
+		{
+		const isodb_isotope &p = isodb_iso[isodb_el[e].first + k];
+		sum += p.fr;
+		if ((k > 0) && (p.m <= isodb_iso[isodb_el[e].first + k - 1].m))
+			return false;
+		if ((p.mass != 0.0) && ((p.mass < p.m - 0.5) || (p.mass > p.m + 0.5)))
+			return false;
+		}
+	if ((sum < 0.999) || (sum > 1.001))
+		return false;
+	}
+return true;
+}
+
+static_assert(isodb_consistent(), "isotope database: abundances, order or masses");
+static_assert(isodb_mass("D") == isodb_mass("H", 2), "label D is not 2H");
+static_assert(isodb_mass("X") == isodb_mass("C", 13), "label X is not 13C");
+static_assert(isodb_mass("M") == isodb_mass("N", 15), "label M is not 15N");
+static_assert(isodb_mass("C") == 12.0, "12C defines the mass scale");
+
+#endif /* __cplusplus */
+
+#endif /* SMISODB_H */
+""")
+
+
+if __name__ == "__main__":
+    check()
+    header(sys.stdout)
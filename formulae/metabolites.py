@@ -0,0 +1,282 @@
+"""
+Generates metabolites.tsv, the list of known formulas used by the
+recall benchmark (smrecall.cpp): amino acids and small peptides, fatty
+acids and their esters, glycero-, phospho- and sphingolipids,
+acylcarnitines, sugars, nucleotides, bile acids, steroids, flavonoid
+glycosides, phase II conjugates and some halogenated drugs/pesticides.
+
+The classes are built from their building blocks (condensation = sum
+minus water), so the formulas are exact; isomers collapse to one entry.
+
+    python3 formulae/metabolites.py > formulae/metabolites.tsv
+"""
+import re
+import sys
+from collections import Counter
+from itertools import combinations_with_replacement, product
+
+
+def f(formula):
+    """'C6H12O6' -> Counter"""
+    c = Counter()
+    for atom, num in re.findall(r'([A-Z][a-z]*)(\d*)', formula):
+        c[atom] += int(num) if num else 1
+    return c
+
+
+def hill(c):
+    """Counter -> Hill notation"""
+    keys = sorted(k for k in c if c[k] > 0)
+    if "C" in keys:
+        order = ["C"] + (["H"] if "H" in keys else []) + [k for k in keys if k not in ("C", "H")]
+    else:
+        order = keys
+    return ''.join(k + (str(c[k]) if c[k] > 1 else '') for k in order)
+
+
+WATER = f("H2O")
+
+
+def condense(*parts):
+    """building blocks joined by n-1 ester/amide/glycosidic bonds"""
+    c = Counter()
+    for p in parts:
+        c.update(p)
+    c.subtract({k: v * (len(parts) - 1) for k, v in WATER.items()})
+    return c
+
+
+def fa(n, db, ox=0):
+    """fatty acid n:db, with ox extra oxygens (hydroxy/epoxy/oxo)"""
+    return Counter({"C": n, "H": 2 * n - 2 * db, "O": 2 + ox})
+
+
+AMINO_ACIDS = {
+    "Gly": "C2H5NO2", "Ala": "C3H7NO2", "Ser": "C3H7NO3", "Pro": "C5H9NO2",
+    "Val": "C5H11NO2", "Thr": "C4H9NO3", "Cys": "C3H7NO2S", "Leu": "C6H13NO2",
+    "Asn": "C4H8N2O3", "Asp": "C4H7NO4", "Gln": "C5H10N2O3", "Lys": "C6H14N2O2",
+    "Glu": "C5H9NO4", "Met": "C5H11NO2S", "His": "C6H9N3O2", "Phe": "C9H11NO2",
+    "Arg": "C6H14N4O2", "Tyr": "C9H11NO3", "Trp": "C11H12N2O2",
+}
+
+OTHER_AMINES = {
+    "ornithine": "C5H12N2O2", "citrulline": "C6H13N3O3", "taurine": "C2H7NO3S",
+    "GABA": "C4H9NO2", "beta-alanine": "C3H7NO2", "homocysteine": "C4H9NO2S",
+    "cystathionine": "C7H14N2O4S", "sarcosine": "C3H7NO2", "creatine": "C4H9N3O2",
+    "creatinine": "C4H7N3O", "carnitine": "C7H15NO3", "betaine": "C5H11NO2",
+    "choline": "C5H14NO", "dopamine": "C8H11NO2", "serotonin": "C10H12N2O",
+    "histamine": "C5H9N3", "tyramine": "C8H11NO", "tryptamine": "C10H12N2",
+    "kynurenine": "C10H12N2O3", "spermidine": "C7H19N3", "spermine": "C10H26N4",
+    "putrescine": "C4H12N2", "cadaverine": "C5H14N2", "glutathione": "C10H17N3O6S",
+    "S-adenosylmethionine": "C15H22N6O5S", "melatonin": "C13H16N2O2",
+    "N-acetylaspartate": "C6H9NO5", "pyroglutamate": "C5H7NO3",
+    "hydroxyproline": "C5H9NO3", "thyroxine": "C15H11I4NO4",
+}
+
+ORGANIC_ACIDS = {
+    "lactate": "C3H6O3", "pyruvate": "C3H4O3", "citrate": "C6H8O7", "isocitrate": "C6H8O7",
+    "succinate": "C4H6O4", "fumarate": "C4H4O4", "malate": "C4H6O5", "oxaloacetate": "C4H4O5",
+    "2-oxoglutarate": "C5H6O5", "cis-aconitate": "C6H6O6", "glycolate": "C2H4O3",
+    "glyoxylate": "C2H2O3", "3-hydroxybutyrate": "C4H8O3", "acetoacetate": "C4H6O3",
+    "urate": "C5H4N4O3", "urea": "CH4N2O", "hippurate": "C9H9NO3", "benzoate": "C7H6O2",
+    "salicylate": "C7H6O3", "4-hydroxybenzoate": "C7H6O3", "vanillate": "C8H8O4",
+    "caffeate": "C9H8O4", "ferulate": "C10H10O4", "coumarate": "C9H8O3", "sinapate": "C11H12O5",
+    "gallate": "C7H6O5", "quinate": "C7H12O6", "shikimate": "C7H10O5", "chlorogenate": "C16H18O9",
+    "phenylacetate": "C8H8O2", "indole-3-acetate": "C10H9NO2", "nicotinate": "C6H5NO2",
+    "pantothenate": "C9H17NO5", "ascorbate": "C6H8O6", "mevalonate": "C6H12O4",
+    "methylmalonate": "C4H6O4", "glutarate": "C5H8O4", "adipate": "C6H10O4",
+}
+
+SUGARS = {"hexose": "C6H12O6", "pentose": "C5H10O5", "deoxyhexose": "C6H12O5",
+          "hexuronic acid": "C6H10O7", "N-acetylhexosamine": "C8H15NO6",
+          "hexosamine": "C6H13NO5", "sialic acid": "C11H19NO9", "tetrose": "C4H8O4",
+          "heptose": "C7H14O7", "deoxypentose": "C5H10O4", "inositol": "C6H12O6",
+          "sorbitol": "C6H14O6", "glycerol": "C3H8O3", "erythritol": "C4H10O4"}
+
+PHOSPHATE = f("H3PO4")
+SULFATE = f("H2SO4")
+
+NUCLEOBASES = {"adenine": "C5H5N5", "guanine": "C5H5N5O", "cytosine": "C4H5N3O",
+               "uracil": "C4H4N2O2", "thymine": "C5H6N2O2", "hypoxanthine": "C5H4N4O",
+               "xanthine": "C5H4N4O2", "5-methylcytosine": "C5H7N3O"}
+
+AGLYCONES = {
+    "quercetin": "C15H10O7", "kaempferol": "C15H10O6", "myricetin": "C15H10O8",
+    "isorhamnetin": "C16H12O7", "apigenin": "C15H10O5", "luteolin": "C15H10O6",
+    "naringenin": "C15H12O5", "eriodictyol": "C15H12O6", "hesperetin": "C16H14O6",
+    "genistein": "C15H10O5", "daidzein": "C15H10O4", "catechin": "C15H14O6",
+    "cyanidin": "C15H11O6", "delphinidin": "C15H11O7", "resveratrol": "C14H12O3",
+    "chrysin": "C15H10O4", "diosmetin": "C16H12O6", "phloretin": "C15H14O5",
+}
+
+STEROIDS = {
+    "cholesterol": "C27H46O", "cholestanol": "C27H48O", "desmosterol": "C27H44O",
+    "lanosterol": "C30H50O", "sitosterol": "C29H50O", "campesterol": "C28H48O",
+    "stigmasterol": "C29H48O", "ergosterol": "C28H44O", "testosterone": "C19H28O2",
+    "dihydrotestosterone": "C19H30O2", "androstenedione": "C19H26O2", "DHEA": "C19H28O2",
+    "estradiol": "C18H24O2", "estrone": "C18H22O2", "estriol": "C18H24O3",
+    "progesterone": "C21H30O2", "pregnenolone": "C21H32O2", "cortisol": "C21H30O5",
+    "cortisone": "C21H28O5", "corticosterone": "C21H30O4", "aldosterone": "C21H28O5",
+    "11-deoxycortisol": "C21H30O4", "calcitriol": "C27H44O3", "calcidiol": "C27H44O2",
+    "vitamin D3": "C27H44O", "7-dehydrocholesterol": "C27H44O",
+}
+
+BILE_ACIDS = {"cholate": "C24H40O5", "chenodeoxycholate": "C24H40O4",
+              "deoxycholate": "C24H40O4", "lithocholate": "C24H40O3",
+              "ursodeoxycholate": "C24H40O4", "muricholate": "C24H40O5",
+              "7-oxo-lithocholate": "C24H38O4", "3-oxo-cholate": "C24H38O5"}
+
+PHENOLS = {  # substrates of phase II conjugation
+    "phenol": "C6H6O", "p-cresol": "C7H8O", "4-ethylphenol": "C8H10O",
+    "catechol": "C6H6O2", "hydroquinone": "C6H6O2", "indoxyl": "C8H7NO",
+    "paracetamol": "C8H9NO2", "tyrosol": "C8H10O2", "hydroxytyrosol": "C8H10O3",
+    "equol": "C15H14O3", "enterolactone": "C18H18O4", "enterodiol": "C18H22O4",
+    "bisphenol A": "C15H16O2", "4-nonylphenol": "C15H24O", "triclosan": "C12H7Cl3O2",
+    "pentachlorophenol": "C6HCl5O", "2,4-dichlorophenol": "C6H4Cl2O",
+    "4-bromophenol": "C6H5BrO", "4-fluorophenol": "C6H5FO", "estradiol": "C18H24O2",
+    "morphine": "C17H19NO3", "propofol": "C12H18O", "ethinylestradiol": "C20H24O2",
+}
+
+DRUGS = {  # incl. halogenated compounds, covering F, Cl, Br
+    "hexaflumuron": "C16H8Cl2F6N2O3", "cangrelor": "C17H25Cl2F3N5O12P3S2",
+    "diclofenac": "C14H11Cl2NO2", "ibuprofen": "C13H18O2", "naproxen": "C14H14O3",
+    "fluoxetine": "C17H18F3NO", "sertraline": "C17H17Cl2N", "ciprofloxacin": "C17H18FN3O3",
+    "levofloxacin": "C18H20FN3O4", "atorvastatin": "C33H35FN2O5", "rosuvastatin": "C22H28FN3O6S",
+    "haloperidol": "C21H23ClFNO2", "diazepam": "C16H13ClN2O", "lorazepam": "C15H10Cl2N2O2",
+    "clonazepam": "C15H10ClN3O3", "chlorpromazine": "C17H19ClN2S", "carbamazepine": "C15H12N2O",
+    "omeprazole": "C17H19N3O3S", "metformin": "C4H11N5", "sitagliptin": "C16H15F6N5O",
+    "fluconazole": "C13H12F2N6O", "clopidogrel": "C16H16ClNO2S", "losartan": "C22H23ClN6O",
+    "hydrochlorothiazide": "C7H8ClN3O4S2", "furosemide": "C12H11ClN2O5S",
+    "chlorambucil": "C14H19Cl2NO2", "bromazepam": "C14H10BrN3O", "brompheniramine": "C16H19BrN2",
+    "bromocriptine": "C32H40BrN5O5", "dexamethasone": "C22H29FO5", "fluticasone": "C22H27F3O4S",
+    "efavirenz": "C14H9ClF3NO2", "celecoxib": "C17H14F3N3O2S", "tamoxifen": "C26H29NO",
+    "caffeine": "C8H10N4O2", "theophylline": "C7H8N4O2", "nicotine": "C10H14N2",
+    "cotinine": "C10H12N2O", "atrazine": "C8H14ClN5", "glyphosate": "C3H8NO5P",
+    "chlorpyrifos": "C9H11Cl3NO3PS", "malathion": "C10H19O6PS2", "imidacloprid": "C9H10ClN5O2",
+    "fipronil": "C12H4Cl2F6N4OS", "DDT": "C14H9Cl5", "permethrin": "C21H20Cl2O3",
+    "bromoxynil": "C7H3Br2NO", "PFOA": "C8HF15O2", "PFOS": "C8HF17O3S", "triclocarban": "C13H9Cl3N2O",
+    "tetrabromobisphenol A": "C15H12Br4O2", "sulfamethoxazole": "C10H11N3O3S",
+    "trimethoprim": "C14H18N4O3", "amoxicillin": "C16H19N3O5S", "penicillin G": "C16H18N2O4S",
+    "warfarin": "C19H16O4", "metoprolol": "C15H25NO3", "propranolol": "C16H21NO2",
+    "lidocaine": "C14H22N2O", "ketamine": "C13H16ClNO", "cocaine": "C17H21NO4",
+}
+
+HEADGROUPS = {  # glycerophosphate + head group, as the free lyso backbone without acyls
+    "PC": "C8H20NO6P", "PE": "C5H14NO6P", "PS": "C6H14NO8P", "PG": "C6H15O8P",
+    "PI": "C9H19O11P", "PA": "C3H9O6P",
+}
+
+SPHINGOID = f("C18H37NO2")              # sphingosine d18:1
+PHOSPHOCHOLINE = f("C5H14NO4P")
+
+
+def chains(cmin, cmax, dbmax, step=2):
+    for n in range(cmin, cmax + 1, step):
+        for db in range(0, min(dbmax, n // 2 - 1) + 1):
+            yield n, db
+
+
+def generate():
+    out = {}
+
+    def add(name, c):
+        form = hill(c if isinstance(c, Counter) else f(c))
+        out.setdefault(form, name)
+
+    for group in (AMINO_ACIDS, OTHER_AMINES, ORGANIC_ACIDS, SUGARS, NUCLEOBASES,
+                  AGLYCONES, STEROIDS, BILE_ACIDS, PHENOLS, DRUGS):
+        for name, form in group.items():
+            add(name, form)
+
+    aas = list(AMINO_ACIDS.items())
+    for (n1, a1), (n2, a2) in product(aas, aas):                # dipeptides
+        add(n1 + "-" + n2, condense(f(a1), f(a2)))
+    for (n1, a1), (n2, a2), (n3, a3) in combinations_with_replacement(aas, 3):
+        add(n1 + "-" + n2 + "-" + n3, condense(f(a1), f(a2), f(a3)))
+
+    for n, db in chains(2, 36, 6, 1):                           # fatty acids and oxylipins
+        add("FA %d:%d" % (n, db), fa(n, db))
+        if n >= 12:
+            for ox in (1, 2, 3):
+                add("FA %d:%d;O%d" % (n, db, ox), fa(n, db, ox))
+        add("CAR %d:%d" % (n, db), condense(f("C7H15NO3"), fa(n, db)))
+        if n >= 8:
+            add("MG %d:%d" % (n, db), condense(f("C3H8O3"), fa(n, db)))
+            add("FA %d:%d-methyl ester" % (n, db), condense(f("CH4O"), fa(n, db)))
+            add("NAE %d:%d" % (n, db), condense(f("C2H7NO"), fa(n, db)))
+        if n >= 12:
+            for hg, form in HEADGROUPS.items():
+                add("L%s %d:%d" % (hg, n, db), condense(f(form), fa(n, db)))
+
+    for n, db in chains(24, 46, 12):                             # diacyl lipids, sum composition
+        half = n // 2
+        acyls = (fa(half, db // 2), fa(n - half, db - db // 2))
+        add("DG %d:%d" % (n, db), condense(f("C3H8O3"), *acyls))
+        for hg, form in HEADGROUPS.items():
+            add("%s %d:%d" % (hg, n, db), condense(f(form), *acyls))
+            add("%s O-%d:%d" % (hg, n, db), condense(f(form), *acyls) + Counter({"H": 2}) - Counter({"O": 1}))
+    for n, db in chains(36, 60, 12):
+        third = n // 3
+        acyls = (fa(third, db // 3), fa(third, db // 3), fa(n - 2 * third, db - 2 * (db // 3)))
+        add("TG %d:%d" % (n, db), condense(f("C3H8O3"), *acyls))
+    for n, db in chains(12, 32, 3):                             # ceramides, sphingomyelins
+        cer = condense(SPHINGOID, fa(n, db))
+        add("Cer d18:1/%d:%d" % (n, db), cer)
+        add("Cer d18:1/%d:%d;O" % (n, db), cer + Counter({"O": 1}))
+        add("SM d18:1/%d:%d" % (n, db), condense(cer, PHOSPHOCHOLINE))
+        add("HexCer d18:1/%d:%d" % (n, db), condense(cer, f(SUGARS["hexose"])))
+        add("CE %d:%d" % (n, db), condense(f(STEROIDS["cholesterol"]), fa(n, db)))
+
+    hexose, pentose, dhex = f(SUGARS["hexose"]), f(SUGARS["pentose"]), f(SUGARS["deoxyhexose"])
+    for k in range(2, 8):                                       # oligosaccharides
+        add("hexose x%d" % k, condense(*[hexose] * k))
+    for name, form in SUGARS.items():                           # sugar phosphates
+        add(name + " phosphate", condense(f(form), PHOSPHATE))
+        add(name + " bisphosphate", condense(f(form), PHOSPHATE, PHOSPHATE))
+
+    ribose, deoxyribose = pentose, f(SUGARS["deoxypentose"])
+    for base, form in NUCLEOBASES.items():                      # nucleosides, nucleotides
+        for sugar, sname in ((ribose, "ribo"), (deoxyribose, "deoxyribo")):
+            nuc = condense(f(form), sugar)
+            add(base + " " + sname + "side", nuc)
+            p = nuc
+            for k in (1, 2, 3):
+                p = condense(p, PHOSPHATE)
+                add(base + " " + sname + "side %dP" % k, p)
+                if k == 1:
+                    add(base + " " + sname + "side 3',5'-cP", p - WATER)
+
+    for name, form in AGLYCONES.items():                        # flavonoid glycosides
+        for sugars, sname in (((hexose,), "hexoside"), ((dhex,), "rhamnoside"), ((pentose,), "pentoside"),
+                              ((f(SUGARS["hexuronic acid"]),), "glucuronide"),
+                              ((hexose, dhex), "rutinoside"), ((hexose, hexose), "dihexoside"),
+                              ((hexose, pentose), "hexosylpentoside")):
+            add(name + " " + sname, condense(f(form), *sugars))
+        add(name + " sulfate", condense(f(form), SULFATE))
+        add(name + " methyl ether", condense(f(form), f("CH4O")))
+
+    for name, form in list(BILE_ACIDS.items()):                 # bile acid conjugates
+        add("glyco" + name, condense(f(form), f("C2H5NO2")))
+        add("tauro" + name, condense(f(form), f("C2H7NO3S")))
+        add(name + " sulfate", condense(f(form), SULFATE))
+        add(name + " glucuronide", condense(f(form), f(SUGARS["hexuronic acid"])))
+
+    for group in (PHENOLS, STEROIDS, DRUGS):                    # phase II conjugates
+        for name, form in group.items():
+            add(name + " glucuronide", condense(f(form), f(SUGARS["hexuronic acid"])))
+            add(name + " sulfate", condense(f(form), SULFATE))
+    for name, form in list(AMINO_ACIDS.items()) + list(ORGANIC_ACIDS.items()):
+        add("N-acetyl" + name, condense(f(form), f("C2H4O2")))
+    for name, form in ORGANIC_ACIDS.items():                    # glycine / taurine / CoA-free conjugates
+        add(name + "-glycine", condense(f(form), f("C2H5NO2")))
+
+    return out
+
+
+if __name__ == "__main__":
+    rows = generate()
+    w = sys.stdout
+    w.write("# known formulas for smrecall, generated by formulae/metabolites.py\n")
+    w.write("# formula\tname\n")
+    for form, name in rows.items():
+        w.write("%s\t%s\n" % (form, name))
@@ -0,0 +1,14 @@
+"""The output of ./formula as a DataFrame; pandas only, so it can be
+used (and tested) without the rest of the package"""
+import io
+import pandas as pd
+
+def formula_df(strout):
+    sio = io.StringIO(strout)
+    df = pd.read_table(sio,delimiter=';')
+    df.columns = df.columns.str.strip()  # the header line ends in " "
+    return df
+
+def retighten(df,ppm):
+    """hits of a -T run within ppm: a prefix, they are sorted by error"""
+    return df.iloc[:int((df.Tol_ppm <= ppm).sum())]
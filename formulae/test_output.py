@@ -0,0 +1,41 @@
+"""formula_df() and retighten() on the output of the built ./formula:
+python3 formulae/test_output.py (make check-python)"""
+import importlib.util
+import os
+import subprocess
+import unittest
+
+here = os.path.dirname(os.path.abspath(__file__))
+formula = os.path.join(here, "..", "formula")
+
+# by path: the package imports utils, which needs rdkit and local data
+spec = importlib.util.spec_from_file_location("output", os.path.join(here, "output.py"))
+output = importlib.util.module_from_spec(spec)
+spec.loader.exec_module(output)
+
+
+def run(*args):
+    return subprocess.run([formula] + list(args), stdout=subprocess.PIPE,
+                          check=True).stdout.decode("utf-8")
+
+
+class TestTiers(unittest.TestCase):
+
+    def test_retighten(self):
+        """-T 1,5,20: each tolerance is a prefix of the hits, the same
+        formulas as a search at that tolerance"""
+        mz = 180.0634
+        df = output.formula_df(run("-e", "fast", "-m", str(mz), "-T", "1,5,20"))
+        self.assertIn("Tol_ppm", df.columns)
+        self.assertIn("C6H12O6", set(df.Formula))
+        for ppm in (1, 5, 20):
+            tight = output.retighten(df, ppm)
+            self.assertTrue((tight.Tol_ppm <= ppm).all())
+            single = output.formula_df(run("-e", "fast", "-m", str(mz),
+                                           "-t", str(ppm * 1e-6 * mz * 1e3)))
+            self.assertEqual(set(tight.Formula), set(single.Formula))
+        self.assertEqual(len(output.retighten(df, 20)), len(df))
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -1,4 +1,6 @@
 from . import data
+from . import isotopes
+from .output import formula_df, retighten
 import os
 from subprocess import run,PIPE
 import io
@@ -23,10 +25,16 @@ def get_elemaxs(mz):
 simple_eles = {"C","H","O","N"}
 
 def mass2formula_args(mz,ppm=5,all_ele=True,charge=None):
+    """ppm may be a list of tolerances: one search at the widest (-T),
+    see retighten()"""
 
-    tol = ((ppm * 1E-6 ) * mz) * (1E3)
     base_cmd = str(os.path.join(cmd_path,"formula.exe"))
-    args_list = [base_cmd, f"-m {mz}",f"-t {tol}"]
+    if isinstance(ppm,(list,tuple)):
+        tols = ",".join(str(p) for p in ppm)
+        args_list = [base_cmd, f"-m {mz}", "-e fast", f"-T {tols}"]
+    else:
+        tol = ((ppm * 1E-6 ) * mz) * (1E3)
+        args_list = [base_cmd, f"-m {mz}",f"-t {tol}"]
     erestrict = get_elemaxs(mz)
     for ele,maxno in erestrict.items():
         if not all_ele:
@@ -47,11 +55,6 @@ def run_formula(*args,**kwargs):
     strout = runo.stdout.decode("utf-8")
     return strout
 
-def formula_df(strout):
-    sio = io.StringIO(strout)
-    df = pd.read_table(sio,delimiter=';')
-    return df
-
 def fuzz_mass(mass,ppm=5,add_h=False):
     r = random.random()
     rppm = r*ppm
@@ -84,18 +87,7 @@ def get_soome_mols(n=100):
 
 
 
-eles = {
-    "Br" : 78.9183371,
-    "Cl" : 34.96885268,
-    "S":  31.972071,
-    "P" :  30.97376163,
-    "Si" : 27.9769265325,
-    "F" :  18.99840322,
-    "O" :  15.9949146196,
-    "N" :  14.0030740048,
-    "C" :  12.000000000,
-    "H" :   1.0078250321,
-    }
+eles = {s : isotopes.mono_mass(s) for s in ("Br","Cl","S","P","Si","F","O","N","C","H")}
 elel = sorted([(s,m) for s,m in eles.items()],key = lambda x:x[1],reverse=True) #sort by mass
 massl = [x[1] for x in elel]# only keep exactmass
 elel = [x[0] for x in elel] # only keep symbol
@@ -0,0 +1,239 @@
+/*
+
+SMBATCH.CPP
+
+ Batch of queries on a pool of threads. The cost of a search grows
+ steeply with the mass and the element ranges, one 1500 Da query can
+ take longer than thousands of 200 Da ones, so static shares of the
+ batch leave threads idle. Instead each query gets an estimate of its
+ search (search_cost()); queries above a share of the total are split
+ on their outermost level (split_query()) until the parts are small
+ enough, and the threads take the parts longest first from one list
+ (LPT). The parts of a query are joined in their order, which is the
+ order of a single search, and ranked by the thread that finishes the
+ last one. The worker processes of smworkers.cpp split and join the
+ same way (split_batch(), join_parts()).
+
+ Copyright (c) 2026, distributed under the terms of version 2 of the
+ GNU General Public License, see smformula_stdout.cpp.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#include "smformula.h"
+using namespace std;
+
+#define SPLIT_SHARE	4	/* parts of a query: at most the total / (threads * SPLIT_SHARE) */
+#define MAXSPLIT	10	/* halvings of one query */
+
+typedef struct	{
+		const vector<Query> *qs;
+		vector< vector<Candidate> > *hits;
+		SearchStats *stats;
+		vector<QueryPart> parts;	/* the parts of each query together, in order */
+		vector<size_t> first;		/* first part of each query, + the end */
+		vector<size_t> by_cost;		/* part indices, longest first */
+		atomic<size_t> next;		/* in by_cost */
+		atomic<int> *left;		/* parts of each query not done */
+		} Batch;
+
+
+double  batch_min_share = 1000.0;	/* cost not worth splitting (search_cost() is >= 1), 0 = any */
+
+static bool longer(const pair<double, size_t> &a, const pair<double, size_t> &b)
+{
+if (a.first != b.first)
+	return a.first > b.first;
+return a.second < b.second;
+}
+
+
+/* parts of q with a cost <= 'share' (if they can be split), in order */
+static void split_part(vector<QueryPart> &parts, size_t j, const Query *q, double cost, double share, int depth)
+{
+QueryPart p;
+Query lo, hi;
+double clo, chi;
+
+if ((cost > share) && (depth < MAXSPLIT) && split_query(q, &lo, &hi))
+	{
+	clo = search_cost(&lo);
+	chi = search_cost(&hi);
+	lo.share = q->share * ((clo + chi > 0.0) ? clo / (clo + chi) : 0.5);	/* of a budget */
+	hi.share = q->share - lo.share;
+	split_part(parts, j, &lo, clo, share, depth + 1);
+	split_part(parts, j, &hi, chi, share, depth + 1);
+	return;
+	}
+memset(&p.st, 0, sizeof(p.st));
+p.query = j;
+p.cost = cost;
+p.q = *q;
+parts.push_back(p);
+}
+
+
+/* st of a part into sum; 'first': sum has no part yet */
+static void add_stats(SearchStats *sum, const SearchStats *st, int first)
+{
+int i;
+
+sum->evaluated += st->evaluated;
+sum->hits += st->hits;
+for (i = 0; i < NRULES; i++)
+	sum->rejected[i] += st->rejected[i];
+for (i = 0; i < NEL; i++)
+	sum->pruned[i] += st->pruned[i];
+sum->ns_enumerate += st->ns_enumerate;
+sum->ns_filter += st->ns_filter;
+sum->cached = (first || sum->cached) && st->cached;	/* all parts from the cache */
+sum->cache_lookups = max(sum->cache_lookups, st->cache_lookups);	/* running totals */
+sum->cache_hits = max(sum->cache_hits, st->cache_hits);
+sum->partial |= st->partial;
+}
+
+
+/************************************************************************
+* SPLIT_BATCH:	The parts of a batch for 'nparallel' threads or		*
+*		processes: each query gets an estimate of its search,	*
+*		those above a share of the total are halved on their	*
+*		outermost level until the parts are small enough (each	*
+*		with its share of a budget). With -f or --suspects the	*
+*		queries are not split.					*
+* Input: 	queries, no. of threads or processes; the parts of	*
+*		each query together, in order, and the first part of	*
+*		each query (+ the end) are returned.			*
+*************************************************************************/
+void split_batch(const vector<Query> &qs, int nparallel, vector<QueryPart> &parts, vector<size_t> &first)
+{
+vector<double> cost(qs.size());
+double total = 0.0, share;
+size_t j;
+
+for (j = 0; j < qs.size(); j++)
+	{
+	cost[j] = (frag_mode || suspect_mode) ? 1.0 : search_cost(&qs[j]);
+	total += cost[j];
+	}
+share = (nparallel > 1) ? max(total / (nparallel * SPLIT_SHARE), batch_min_share) : total;
+parts.clear();
+first.clear();
+for (j = 0; j < qs.size(); j++)
+	{
+	first.push_back(parts.size());
+	if (frag_mode || suspect_mode)
+		split_part(parts, j, &qs[j], cost[j], cost[j], MAXSPLIT);
+	else
+		split_part(parts, j, &qs[j], cost[j], share, 0);
+	}
+first.push_back(parts.size());
+}
+
+
+/************************************************************************
+* JOIN_PARTS:	The hits of a query from its parts parts[from...to-1]	*
+*		in their order, which is the order of a single search,	*
+*		ranked; the stats are summed, "covered" weighted by the	*
+*		cost of the parts. The hits of the parts are freed.	*
+* Input: 	query, parts, hits are appended to 'hits', optional	*
+*		stats.							*
+*************************************************************************/
+void join_parts(const Query *q, vector<QueryPart> &parts, size_t from, size_t to,
+		vector<Candidate> &hits, SearchStats *stats)
+{
+SearchStats st;
+double done = 0.0, total = 0.0;
+size_t k;
+
+memset(&st, 0, sizeof(st));
+for (k = from; k < to; k++)
+	{
+	hits.insert(hits.end(), parts[k].hits.begin(), parts[k].hits.end());
+	add_stats(&st, &parts[k].st, k == from);
+	done += parts[k].cost * (parts[k].st.partial ? parts[k].st.covered : 1.0);
+	total += parts[k].cost;
+	vector<Candidate>().swap(parts[k].hits);
+	}
+st.covered = (total > 0.0) ? done / total : 1.0;
+st.hits = hits.size();
+rank_hits(q, hits, &st);
+if (stats != NULL)
+	*stats = st;
+}
+
+
+static void *batch_thread(void *arg)
+{
+Batch *b = (Batch *)arg;
+QueryPart *p;
+size_t k, j;
+
+while ((k = b->next++) < b->by_cost.size())
+	{
+	p = &b->parts[b->by_cost[k]];
+	search_hits(&p->q, p->hits, &p->st);
+	j = p->query;
+	if (--b->left[j] == 0)		/* the last part of query j: join, rank */
+		join_parts(&(*b->qs)[j], b->parts, b->first[j], b->first[j + 1], (*b->hits)[j],
+			(b->stats != NULL) ? &b->stats[j] : NULL);
+	}
+return NULL;
+}
+
+
+/************************************************************************
+* BATCH_SEARCH:	search_ranked() of every query of a batch, on a pool	*
+*		of threads, the longest searches first, large ones	*
+*		split into parts (see above).				*
+* Input: 	queries, hits[j] for qs[j] (hits are appended), optional	*
+*		stats[j], no. of threads, optional no. of parts		*
+*		returned.						*
+* Returns. 	total no. of hits.					*
+*************************************************************************/
+long batch_search(const vector<Query> &qs, vector< vector<Candidate> > &hits,
+		SearchStats *stats, int nthreads, long *tasks)
+{
+Batch b;
+vector< pair<double, size_t> > order;
+vector<pthread_t> tid;
+size_t j;
+long n = 0;
+int i;
+
+hits.resize(qs.size());
+if (nthreads < 1)
+	nthreads = 1;
+b.qs = &qs;
+b.hits = &hits;
+b.stats = stats;
+split_batch(qs, nthreads, b.parts, b.first);
+
+b.left = new atomic<int>[qs.size()];
+for (j = 0; j < qs.size(); j++)
+	b.left[j] = b.first[j + 1] - b.first[j];
+for (j = 0; j < b.parts.size(); j++)
+	order.push_back(make_pair(b.parts[j].cost, j));
+sort(order.begin(), order.end(), longer);
+for (j = 0; j < order.size(); j++)
+	b.by_cost.push_back(order[j].second);
+b.next = 0;
+
+tid.resize(nthreads);
+for (i = 0; i < nthreads; i++)
+	pthread_create(&tid[i], NULL, batch_thread, &b);
+for (i = 0; i < nthreads; i++)
+	pthread_join(tid[i], NULL);
+delete[] b.left;
+
+for (j = 0; j < qs.size(); j++)
+	n += hits[j].size();
+if (tasks != NULL)
+	*tasks = b.parts.size();
+return n;
+}
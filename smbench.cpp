@@ -0,0 +1,262 @@
+/*
+
+SMBENCH.CPP
+
+ Benchmark of the formula calculation (smformula.cpp). It runs the
+ queries quoted in the header of smformula_stdout.cpp (Cangrelor at
+ 1 ppm, Hexaflumuron at 3 ppm) and a sweep over 100...2000 Da and
+ 1...10 ppm, always with the same element ranges, and writes formulas
+ evaluated, hits, wall time and evaluations per second as JSON, so that
+ every change of the engine is measured against the same workload.
+
+ usage: smbench [-l] [-e engine] [-q name] [-r n] [-x box] [-o file]
+
+ Note: the calculation loop visits every composition of the element
+ ranges ("box"), so the two header queries take minutes to hours; use
+ -x to skip queries above a given box size, or -q to select queries.
+
+ Copyright (c) 2026, distributed under the terms of version 2 of the
+ GNU General Public License, see smformula_stdout.cpp.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "smformula.h"
+using namespace std;
+
+#define VERSION "20261019"
+
+typedef struct	{
+		string	name;
+		double	mass;		/* measured mass */
+		double	tol;		/* tolerance in mmu */
+		double	charge;
+		string	ranges;		/* "C1-64 H1-112 ...", keys as on the cmd line */
+		} BenchQuery;
+
+
+/* --- the workload --- */
+
+static const char *sweep_ranges[][2] =	/* upper mass, CHNOPS ranges of formulae/data.py */
+{
+{ "500",  "C0-39 H0-72 N0-20 O0-20 P0-9 S0-10" },
+{ "1000", "C0-78 H0-126 N0-25 O0-27 P0-9 S0-14" },
+{ "2000", "C0-156 H0-236 N0-32 O0-63 P0-9 S0-14" },
+};
+
+static const double sweep_mass[] = { 100, 200, 300, 500, 750, 1000, 1500, 2000 };	/* nominal */
+#define SWEEP_DEFECT 0.0005		/* mass defect per Da, typical of CHNOPS compounds */
+static const double sweep_ppm[]  = { 1, 2, 5, 10 };
+
+
+vector<BenchQuery> workload(void)
+{
+vector<BenchQuery> q;
+BenchQuery b;
+char name[64];
+size_t i, j, k;
+
+b.charge = 0.0;
+
+b.name = "cangrelor_1ppm";	/* header: 4465 formulas in 41 s, 2,003,436,894 evaluated */
+b.mass = 774.948;
+b.tol = 0.77;
+b.ranges = "C1-64 H1-112 N0-30 O0-80 P0-12 S0-9 F0-10 L0-10";
+q.push_back(b);
+
+b.name = "hexaflumuron_3ppm";	/* header: 945 formulas, 253 s -> 4 s */
+b.mass = 459.982882;
+b.tol = 1.37995;
+b.ranges = "C0-39 H0-98 N0-34 O0-30 P0-12 S0-12 F0-12 L0-14 B0-7 I0-0";
+q.push_back(b);
+
+for (i = 0; i < sizeof(sweep_mass) / sizeof(sweep_mass[0]); i++)
+	for (j = 0; j < sizeof(sweep_ppm) / sizeof(sweep_ppm[0]); j++)
+		{
+		for (k = 0; atof(sweep_ranges[k][0]) < sweep_mass[i]; k++)
+			;
+		snprintf(name, sizeof(name), "sweep_%.0fDa_%.0fppm", sweep_mass[i], sweep_ppm[j]);
+		b.name = name;
+		b.mass = sweep_mass[i] * (1.0 + SWEEP_DEFECT);
+		b.tol = sweep_ppm[j] * 1e-6 * b.mass * 1e3;
+		b.ranges = sweep_ranges[k][1];
+		q.push_back(b);
+		}
+return q;
+}
+
+
+/************************************************************************
+* SET_RANGES:	Sets el[].min/max from "C1-64 H1-112 ..."; elements	*
+*		not mentioned get 0-0.					*
+* Returns. 	no. of compositions in the ranges (search box), 0 if	*
+*		the string is invalid.					*
+*************************************************************************/
+double set_ranges(const string &ranges)
+{
+const char *p = ranges.c_str();
+int i, lo, hi, n;
+double box = 1.0;
+
+for (i = 0; i < nr_el; i++)
+	el[i].min = el[i].max = 0;
+
+while (*p)
+	{
+	if (*p == ' ')
+		{
+		p++;
+		continue;
+		}
+	for (i = 0; (i < nr_el) && (el[i].key != *p); i++)
+		;
+	if ((i == nr_el) || (sscanf(p + 1, "%d-%d%n", &lo, &hi, &n) != 2))
+		return 0.0;
+	el[i].min = lo;
+	el[i].max = hi;
+	p += 1 + n;
+	}
+
+for (i = 0; i < nr_el; i++)
+	box *= el[i].max - el[i].min + 1;
+return box;
+}
+
+
+int main (int argc, char *argv[])
+{
+vector<BenchQuery> queries;
+const char *select = NULL, *outname = NULL;
+double maxbox = 0.0, box, best, secs;
+int i, tmp, repeat = 1, list = 0, first = 1;
+SearchStats st;
+FILE *json;
+time_t now;
+char date[32];
+
+static const char *msg =
+"Benchmark of the formula calculation, results as JSON.\n\n"
+"usage: smbench [options]\n\nValid command line options are:\n"
+"-h      This Help screen.\n"
+"-l      List the queries and exit.\n"
+"-e eng  Engine: 'legacy' (default) or 'fast', see smformula -h.\n"
+"-q txt  Run only the queries whose name contains 'txt'.\n"
+"-r n    Run each query n times, report the fastest (default 1).\n"
+"-x box  Skip queries with more than 'box' compositions in their ranges.\n"
+"-o file Write the JSON to 'file' (default: stdout).\n";
+
+while ((tmp = getopt(argc, argv, "hle:q:r:x:o:")) != EOF)
+	switch (tmp)
+		{
+		case 'h':
+			printf("%s", msg);
+			return 0;
+		case 'l':
+			list = 1;
+			continue;
+		case 'e':
+			if (!strcmp(optarg, "legacy"))
+				engine = ENGINE_LEGACY;
+			else if (!strcmp(optarg, "fast"))
+				engine = ENGINE_FAST;
+			else
+				{
+				fprintf(stderr, "Error: unknown engine '%s'.\n", optarg);
+				return 1;
+				}
+			continue;
+		case 'q':
+			select = optarg;
+			continue;
+		case 'r':
+			repeat = atoi(optarg) > 0 ? atoi(optarg) : 1;
+			continue;
+		case 'x':
+			maxbox = atof(optarg);
+			continue;
+		case 'o':
+			outname = optarg;
+			continue;
+		default:
+			printf ("'%s -h' for help.\n", argv[0]);
+			return 1;
+		}
+
+init_elements();
+queries = workload();
+
+if (list)
+	{
+	for (i = 0; i < (int)queries.size(); i++)
+		printf("%-24s m=%-11.6f tol=%-9.5f mmu  %s  (box %.3g)\n", queries[i].name.c_str(),
+			queries[i].mass, queries[i].tol, queries[i].ranges.c_str(), set_ranges(queries[i].ranges));
+	return 0;
+	}
+
+/* the engine prints its hits to stdout: keep the JSON apart, discard the rest */
+json = (outname != NULL) ? fopen(outname, "w") : fdopen(dup(fileno(stdout)), "w");
+if (json == NULL)
+	{
+	fprintf(stderr, "Error: Cannot open %s.\n", outname ? outname : "stdout");
+	return 1;
+	}
+fflush(stdout);
+if (freopen("/dev/null", "w", stdout) == NULL)
+	{
+	fprintf(stderr, "Error: Cannot redirect stdout.\n");
+	return 1;
+	}
+
+now = time(NULL);
+strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+fprintf(json, "{\n\"benchmark\": \"smbench\",\n\"version\": \"%s\",\n\"engine\": \"%s\",\n"
+	"\"date\": \"%s\",\n\"repeat\": %d,\n\"results\": [", VERSION,
+	engine == ENGINE_FAST ? "fast" : "legacy", date, repeat);
+
+for (i = 0; i < (int)queries.size(); i++)
+	{
+	const BenchQuery &q = queries[i];
+
+	if ((select != NULL) && (strstr(q.name.c_str(), select) == NULL))
+		continue;
+	box = set_ranges(q.ranges);
+	fprintf(json, "%s\n{\"name\": \"%s\", \"mass\": %.6f, \"tol_mmu\": %.6f, \"ppm\": %.3f, "
+		"\"charge\": %.0f, \"ranges\": \"%s\", \"box\": %.0f, ",
+		first ? "" : ",", q.name.c_str(), q.mass, q.tol, q.tol / q.mass * 1e3,
+		q.charge, q.ranges.c_str(), box);
+	first = 0;
+
+	if ((maxbox > 0) && (box > maxbox))
+		{
+		fprintf(json, "\"skipped\": true}");
+		fflush(json);
+		continue;
+		}
+
+	charge = q.charge;
+	best = -1.0;
+	for (tmp = 0; tmp < repeat; tmp++)
+		{
+		chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+		calculate(q.mass, q.tol, &st);
+		fflush(stdout);
+		secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+		if ((best < 0) || (secs < best))
+			best = secs;
+		}
+	fprintf(json, "\"evaluated\": %lld, \"hits\": %lld, \"wall_s\": %.6f, \"evals_per_s\": %.0f}",
+		st.evaluated, st.hits, best, best > 0 ? st.evaluated / best : 0.0);
+	fflush(json);
+	}
+
+fprintf(json, "\n]\n}\n");
+fclose(json);
+return 0;
+}
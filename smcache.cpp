@@ -0,0 +1,282 @@
+/*
+
+SMCACHE.CPP
+
+ Result cache of the formula calculation. In LC-MS runs the same m/z
+ is asked for again and again (scans, replicates, samples); the cache
+ keeps the hits of recent searches, keyed on the element ranges, the
+ charge and the rules, for a mass window widened to a grid of
+ 'quantum' mmu. A query whose window lies within a cached window is
+ answered by filtering the cached hits with the same mass test as
+ search_formulas(), so the result is the same as from a new search.
+ Adducts are resolved to the neutral mass before (see adduct_neutral()),
+ so one entry serves all adducts of a molecule.
+
+ The least recently used entry is dropped when the cache is full. With
+ a file, the entries are read at cache_open() and written back at
+ cache_close(): 4 bytes "SMC2", the no. of elements, their masses (the
+ file is ignored if they differ), then per entry the key, the window,
+ the no. of hits and per hit cnt[NEL], rdb, lewis and mass ("SMC1" had
+ NEL = 14).
+
+ Copyright (c) 2026, distributed under the terms of version 2 of the
+ GNU General Public License, see smformula_stdout.cpp.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <list>
+#include <vector>
+#include "smformula.h"
+using namespace std;
+
+typedef struct	{			/* what the hits depend on, besides the mass */
+		int	min[NEL], max[NEL];
+		double	charge;
+		int	rules;
+		} CacheKey;
+
+typedef struct	{
+		CacheKey key;
+		double	lo, hi;		/* mass window searched */
+		vector<Candidate> hits;
+		} CacheEntry;
+
+static list<CacheEntry> cache;		/* most recently used first */
+static size_t cache_max;		/* 0 = cache off */
+static double cache_quantum;		/* mmu */
+static char cache_file[FILENAME_MAX];
+static long long lookups, found;
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+static void make_key(const Query *q, CacheKey *k)
+{
+memset(k, 0, sizeof(*k));		/* no garbage in the padding, keys are memcmp'd */
+memcpy(k->min, q->min, sizeof(k->min));
+memcpy(k->max, q->max, sizeof(k->max));
+k->charge = q->charge;
+k->rules = q->rules;
+}
+
+
+/* hits of 'e' within the window of q, in the order found; error relative to q */
+static void filter_hits(const CacheEntry *e, const Query *q, vector<Candidate> &hits)
+{
+double lo = q->mass - (q->tol / 1000.0);	/* as search_formulas() */
+double hi = q->mass + (q->tol / 1000.0);
+size_t j;
+
+for (j = 0; j < e->hits.size(); j++)
+	if ((e->hits[j].mass >= lo) && (e->hits[j].mass <= hi))
+		{
+		hits.push_back(e->hits[j]);
+		hits.back().error = 1000.0 * (q->mass - hits.back().mass);
+		}
+}
+
+
+static int load_cache(FILE *f)
+{
+CacheEntry e;
+Candidate c;
+double m;
+int i, n;
+char magic[4];
+
+if ((fread(magic, 1, 4, f) != 4) || memcmp(magic, "SMC2", 4))
+	return 0;
+if ((fread(&n, sizeof(n), 1, f) != 1) || (n != nr_el))
+	return 0;
+for (i = 0; i < n; i++)
+	if ((fread(&m, sizeof(m), 1, f) != 1) || (m != el[i].mass))
+		return 0;
+
+memset(&c, 0, sizeof(c));
+while ((cache.size() < cache_max) && (fread(&e.key, sizeof(e.key), 1, f) == 1))
+	{
+	if ((fread(&e.lo, sizeof(double), 1, f) != 1) || (fread(&e.hi, sizeof(double), 1, f) != 1)
+			|| (fread(&n, sizeof(n), 1, f) != 1) || (n < 0))
+		return 0;
+	e.hits.clear();
+	for (i = 0; i < n; i++)
+		{
+		if ((fread(c.cnt, sizeof(c.cnt), 1, f) != 1) || (fread(&c.rdb, sizeof(float), 1, f) != 1)
+				|| (fread(&c.lewis, sizeof(float), 1, f) != 1) || (fread(&c.mass, sizeof(double), 1, f) != 1))
+			return 0;
+		e.hits.push_back(c);
+		}
+	cache.push_back(e);
+	}
+return 1;
+}
+
+
+static void save_cache(FILE *f)
+{
+list<CacheEntry>::const_iterator it;
+size_t j;
+int i, n;
+
+fwrite("SMC2", 1, 4, f);
+fwrite(&nr_el, sizeof(nr_el), 1, f);
+for (i = 0; i < nr_el; i++)
+	fwrite(&el[i].mass, sizeof(double), 1, f);
+for (it = cache.begin(); it != cache.end(); ++it)
+	{
+	n = it->hits.size();
+	fwrite(&it->key, sizeof(it->key), 1, f);
+	fwrite(&it->lo, sizeof(double), 1, f);
+	fwrite(&it->hi, sizeof(double), 1, f);
+	fwrite(&n, sizeof(n), 1, f);
+	for (j = 0; j < it->hits.size(); j++)
+		{
+		fwrite(it->hits[j].cnt, sizeof(it->hits[j].cnt), 1, f);
+		fwrite(&it->hits[j].rdb, sizeof(float), 1, f);
+		fwrite(&it->hits[j].lewis, sizeof(float), 1, f);
+		fwrite(&it->hits[j].mass, sizeof(double), 1, f);
+		}
+	}
+}
+
+
+/************************************************************************
+* CACHE_OPEN:	Switches the cache on.					*
+* Input: 	max. no. of entries, grid of the windows in mmu, file of	*
+*		the on-disk store (NULL = none).			*
+* Returns. 	no. of entries read from the file.			*
+*************************************************************************/
+long cache_open(size_t entries, double quantum, const char *file)
+{
+FILE *f;
+
+pthread_mutex_lock(&cache_lock);
+cache.clear();
+cache_max = entries;
+cache_quantum = (quantum > 0) ? quantum : CACHE_QUANTUM;
+lookups = found = 0;
+*cache_file = 0;
+if (file != NULL)
+	{
+	strncpy(cache_file, file, sizeof(cache_file) - 1);
+	cache_file[sizeof(cache_file) - 1] = 0;
+	if ((f = fopen(file, "rb")) != NULL)
+		{
+		if (!load_cache(f))		/* other element table or damaged: start empty */
+			cache.clear();
+		fclose(f);
+		}
+	}
+pthread_mutex_unlock(&cache_lock);
+return cache.size();
+}
+
+
+/************************************************************************
+* CACHE_CLOSE:	Writes the entries to the file (if any), switches the	*
+*		cache off.						*
+* Returns. 	0 if OK, 1 if the file could not be written.		*
+*************************************************************************/
+int cache_close(void)
+{
+FILE *f;
+int err = 0;
+
+pthread_mutex_lock(&cache_lock);
+if (*cache_file && (cache_max > 0))
+	{
+	if ((f = fopen(cache_file, "wb")) != NULL)
+		{
+		save_cache(f);
+		err = (fclose(f) != 0);
+		}
+	else
+		err = 1;
+	}
+cache.clear();
+cache_max = 0;
+pthread_mutex_unlock(&cache_lock);
+return err;
+}
+
+
+/************************************************************************
+* CACHED_SEARCH:	search_formulas() through the cache: from a cached	*
+*		entry if its window holds the query's window, else a	*
+*		search of the window widened to the grid, which is kept.	*
+* Input: 	query, vector the hits are appended to, optional stats.	*
+* Returns. 	number of hits.	       				*
+*************************************************************************/
+long cached_search(const Query *q, vector<Candidate> &hits, SearchStats *stats)
+{
+list<CacheEntry>::iterator it;
+CacheEntry e;
+Query wide;
+double lo, hi;
+size_t first = hits.size();
+long long t0;
+
+if (cache_max == 0)
+	return search_formulas(q, hits, stats);
+
+t0 = clock_ns();
+lo = q->mass - (q->tol / 1000.0);
+hi = q->mass + (q->tol / 1000.0);
+make_key(q, &e.key);
+
+pthread_mutex_lock(&cache_lock);
+lookups++;
+for (it = cache.begin(); it != cache.end(); ++it)
+	if ((lo >= it->lo) && (hi <= it->hi) && !memcmp(&it->key, &e.key, sizeof(e.key)))
+		break;
+if (it != cache.end())
+	{
+	found++;
+	cache.splice(cache.begin(), cache, it);		/* now the most recent */
+	filter_hits(&cache.front(), q, hits);
+	if (stats != NULL)
+		{
+		memset(stats, 0, sizeof(*stats));
+		stats->hits = hits.size() - first;
+		stats->ns_filter = clock_ns() - t0;
+		stats->cached = 1;
+		stats->cache_lookups = lookups;
+		stats->cache_hits = found;
+		}
+	pthread_mutex_unlock(&cache_lock);
+	return hits.size() - first;
+	}
+pthread_mutex_unlock(&cache_lock);
+
+/* miss: search the window rounded out to the grid */
+wide = *q;
+e.lo = floor(lo * 1000.0 / cache_quantum) * cache_quantum / 1000.0;
+e.hi = ceil(hi * 1000.0 / cache_quantum) * cache_quantum / 1000.0;
+wide.mass = (e.lo + e.hi) / 2.0;
+wide.tol = (e.hi - e.lo) / 2.0 * 1000.0 + 1e-6;		/* rounding */
+e.lo = wide.mass - (wide.tol / 1000.0);
+e.hi = wide.mass + (wide.tol / 1000.0);
+if ((lo < e.lo) || (hi > e.hi) || (q->budget != NULL))	/* can't happen; a partial search isn't kept */
+	return search_formulas(q, hits, stats);
+
+search_formulas(&wide, e.hits, stats);
+filter_hits(&e, q, hits);
+
+pthread_mutex_lock(&cache_lock);
+cache.push_front(e);
+while (cache.size() > cache_max)
+	cache.pop_back();
+if (stats != NULL)
+	{
+	stats->hits = hits.size() - first;
+	stats->cached = 0;
+	stats->cache_lookups = lookups;
+	stats->cache_hits = found;
+	}
+pthread_mutex_unlock(&cache_lock);
+return hits.size() - first;
+}
@@ -0,0 +1,438 @@
+/*
+
+SMDIFF.CPP
+
+ Differential test of the formula engines. do_calculations(), the full
+ loop of smformula.cpp, is the reference: every other engine must find
+ exactly the same hits. smdiff runs random queries (random element
+ ranges, the mass of a random composition in these ranges fuzzed by a
+ ppm error like fuzz_mass() in formulae/utils.py or put right on the
+ edge of the tolerance window, charge -1, 0 or +1) through all engines
+ and compares the hit sets. For a mismatch, the query is shrunk to the
+ smallest one that still shows it and printed as smformula command
+ line, so it can be reproduced with -e legacy and the engine's options.
+ Engine 'cache' is search_formulas() through the result cache
+ (smcache.cpp), 'batch' is batch_search() with every query split into
+ parts (smbatch.cpp), 'workers' the same on 3 processes (fork_search(),
+ smworkers.cpp), 'series' is series_search() of the query between its
+ neighbours in the homologous series (-s CH2), 'frag' is frag_search()
+ with the maxima of the ranges as precursor (-f; the table is kept
+ small, larger precursors take the search_formulas() path). For the
+ engines that claim the order of search_formulas() (split parts joined
+ in order), the order of the hits is compared, too.
+
+ usage: smdiff [-n queries] [-s seed] [-x box] [-v]
+
+ Returns 0 if all engines agree, 1 otherwise ("make check").
+
+ Copyright (c) 2026, distributed under the terms of version 2 of the
+ GNU General Public License, see smformula_stdout.cpp.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+#include "smformula.h"
+using namespace std;
+
+typedef long (*EngineFunc)(const Query *q, vector<Candidate> &hits);
+
+typedef struct	{
+		const char *name;
+		const char *options;	/* the same in formula */
+		EngineFunc run;
+		int	ordered;	/* hits in the order of search_formulas() */
+		} Engine;
+
+static long run_fast(const Query *q, vector<Candidate> &hits)
+{
+return search_formulas(q, hits);
+}
+
+/* a wider query first, so that q itself is answered from the cache */
+static long run_cached(const Query *q, vector<Candidate> &hits)
+{
+vector<Candidate> wide_hits;
+Query wide = *q;
+
+wide.tol *= 1.5;
+cached_search(&wide, wide_hits);
+return cached_search(q, hits);
+}
+
+/* batch_search() on 3 threads, the query split as far as it goes (batch_min_share = 0) */
+static long run_batch(const Query *q, vector<Candidate> &hits)
+{
+vector<Query> qs(1, *q);
+vector< vector<Candidate> > h;
+
+batch_search(qs, h, NULL, 3);
+hits.insert(hits.end(), h[0].begin(), h[0].end());
+return h[0].size();
+}
+
+/* fork_search() on 3 worker processes, split alike */
+static long run_workers(const Query *q, vector<Candidate> &hits)
+{
+vector<Query> qs(1, *q);
+vector< vector<Candidate> > h;
+
+if (fork_search(qs, h, NULL, 3, 0) < 0)
+	return -1;			/* no hits: a mismatch, if there are any */
+hits.insert(hits.end(), h[0].begin(), h[0].end());
+return h[0].size();
+}
+
+/* series_search() of q with q - CH2 and q + CH2 (same ranges, as the peaks of -s) */
+static long run_series(const Query *q, vector<Candidate> &hits)
+{
+vector<Query> qs;
+vector< vector<Candidate> > h;
+int unit[NEL];
+Query m;
+size_t self = 0;
+int k;
+
+memset(unit, 0, sizeof(unit));
+unit[el_index("C")] = 1;
+unit[el_index("H")] = 2;
+for (k = -1; k <= 1; k++)
+	{
+	m = *q;
+	m.mass += k * calc_mass(unit, 0.0);
+	if (k == 0)
+		self = qs.size();
+	if ((k == 0) || (m.mass > 1.0))
+		qs.push_back(m);
+	}
+series_search(qs, unit, h);
+hits.insert(hits.end(), h[self].begin(), h[self].end());
+return h[self].size();
+}
+
+/* frag_search() with the maxima of q as precursor: the hits of q */
+static long run_frag(const Query *q, vector<Candidate> &hits)
+{
+long n;
+
+frag_open(q->max);
+n = frag_search(q, hits);
+frag_mode = 0;			/* the other engines search the ranges */
+return n;
+}
+
+static const Engine engines[] =	/* the engines checked against the reference */
+{
+{ "fast",    "-e fast",         run_fast,    1 },
+{ "cache",   "-e fast --cache", run_cached,  0 },
+{ "batch",   "-e fast -j 3",    run_batch,   1 },
+{ "workers", "-e fast -w 3",    run_workers, 1 },
+{ "series",  "-e fast -s CH2",  run_series,  1 },
+{ "frag",    "-e fast -f <maxima>", run_frag, 1 },
+};
+#define NENGINES (int)(sizeof(engines) / sizeof(engines[0]))
+
+/* upper limits of the random ranges, indexed like el[] */
+static const int gen_max[NEL] = { 60, 3, 100, 4, 12, 3, 24, 6, 2, 2, 4, 4, 4, 3 };
+
+static int defmin[NEL], defmax[NEL];	/* defaults of smformula, for the reproducer */
+static unsigned long long rng;
+
+
+/* --- xorshift64*, so a seed gives the same queries everywhere --- */
+
+static unsigned long long next_random(void)
+{
+rng ^= rng >> 12;
+rng ^= rng << 25;
+rng ^= rng >> 27;
+return rng * 2685821657736338717ULL;
+}
+
+static double uniform(void)		/* 0 <= x < 1 */
+{
+return (next_random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static int between(int lo, int hi)	/* lo <= x <= hi */
+{
+return lo + (int)(uniform() * (hi - lo + 1));
+}
+
+
+static double box_size(const Query *q)
+{
+double box = 1.0;
+int i;
+
+for (i = 0; i < nr_el; i++)
+	box *= q->max[i] - q->min[i] + 1;
+return box;
+}
+
+
+/************************************************************************
+* RANDOM_QUERY:	Random ranges (C, H, N, O mostly, the others now and	*
+*		then, sometimes with a minimum), the box limited to	*
+*		'maxbox' compositions, and the mass of a composition	*
+*		inside, fuzzed or on the window edge.			*
+*************************************************************************/
+static void random_query(Query *q, double maxbox)
+{
+int cnt[NEL];
+int i, widest;
+double ppm, r;
+
+memset(q, 0, sizeof(*q));
+memset(cnt, 0, sizeof(cnt));
+
+for (i = 0; i < nr_el; i++)
+	{
+	q->min[i] = q->max[i] = 0;
+	if (uniform() < ((i == 0) || (i == 2) || (i == 4) || (i == 6) ? 0.9 : 0.25))
+		{
+		q->max[i] = between(1, gen_max[i]);
+		if (uniform() < 0.3)
+			q->min[i] = between(0, q->max[i]);
+		}
+	}
+while (box_size(q) > maxbox)		/* halve the widest range */
+	{
+	widest = 0;
+	for (i = 1; i < nr_el; i++)
+		if (q->max[i] - q->min[i] > q->max[widest] - q->min[widest])
+			widest = i;
+	q->max[widest] = q->min[widest] + (q->max[widest] - q->min[widest]) / 2;
+	}
+
+for (i = 0; i < nr_el; i++)
+	cnt[i] = between(q->min[i], q->max[i]);
+q->charge = between(-1, 1);
+q->rules = 1;			/* the reference always checks the ratios */
+q->mass = calc_mass(cnt, q->charge);
+if (q->mass <= 0.0)
+	q->mass = 1.0;
+ppm = 0.5 + 9.5 * uniform();		/* 0.5 ... 10 ppm */
+q->tol = ppm * 1e-6 * q->mass * 1e3;
+
+r = uniform();
+if (uniform() < 0.2)			/* right on the edge of the window */
+	q->mass += (r > 0.5 ? 1.0 : -1.0) * q->tol / 1000.0;
+else					/* fuzz_mass() */
+	q->mass += (r > 0.5 ? 1.0 : -1.0) * r * ppm * 1e-6 * q->mass;
+}
+
+
+/* --- reference and comparison --- */
+
+static long run_legacy(const Query *q, vector<Candidate> &hits)
+{
+int i;
+
+for (i = 0; i < nr_el; i++)
+	{
+	el[i].min = q->min[i];
+	el[i].max = q->max[i];
+	}
+charge = q->charge;
+return do_calculations(q->mass, q->tol, NULL, &hits);
+}
+
+static bool by_composition(const Candidate &a, const Candidate &b)
+{
+return lexicographical_compare(a.cnt, a.cnt + nr_el, b.cnt, b.cnt + nr_el);
+}
+
+static bool same_hit(const Candidate &a, const Candidate &b)
+{
+return (memcmp(a.cnt, b.cnt, sizeof(a.cnt)) == 0) && (a.mass == b.mass)
+	&& (a.rdb == b.rdb) && (a.lewis == b.lewis);
+}
+
+
+/************************************************************************
+* DIFFER:	Runs the query through the reference and engine 'e'.	*
+* Returns. 	0 if the hit sets are identical (and, for an ordered	*
+*		engine, in the order of search_formulas()), else 1;	*
+*		'witness' is then a hit found by only one of them, or	*
+*		the first one out of order.				*
+*************************************************************************/
+static int differ(const Query *q, int e, Candidate *witness, long *nhits)
+{
+vector<Candidate> ref, got, order;
+size_t i, j;
+
+run_legacy(q, ref);
+fflush(stdout);
+engines[e].run(q, got);
+if (nhits != NULL)
+	*nhits = ref.size();
+if (engines[e].ordered)		/* the same sequence as search_formulas() */
+	{
+	search_formulas(q, order);
+	for (i = 0; (i < order.size()) && (i < got.size()) && same_hit(order[i], got[i]); i++)
+		;
+	if ((i < order.size()) || (i < got.size()))
+		{
+		*witness = (i < got.size()) ? got[i] : order[i];
+		return 1;
+		}
+	}
+sort(ref.begin(), ref.end(), by_composition);
+sort(got.begin(), got.end(), by_composition);
+
+for (i = j = 0; (i < ref.size()) && (j < got.size()); i++, j++)
+	if (!same_hit(ref[i], got[j]))
+		break;
+if ((i == ref.size()) && (j == got.size()))
+	return 0;
+
+if ((i < ref.size()) && ((j == got.size()) || by_composition(ref[i], got[j])
+		|| !by_composition(got[j], ref[i])))
+	*witness = ref[i];
+else
+	*witness = got[j];
+return 1;
+}
+
+
+/************************************************************************
+* MINIMIZE:	Shrinks a failing query: each element range is cut down	*
+*		to the count of the witness formula, as long as the	*
+*		engines still disagree.					*
+*************************************************************************/
+static void minimize(Query *q, int e, Candidate *witness)
+{
+Query t;
+Candidate w;
+int i;
+
+for (i = 0; i < nr_el; i++)
+	{
+	if (q->min[i] == q->max[i])
+		continue;
+	t = *q;
+	t.min[i] = t.max[i] = witness->cnt[i];
+	if (differ(&t, e, &w, NULL))
+		{
+		*q = t;
+		*witness = w;
+		}
+	}
+}
+
+
+static void print_reproducer(const Query *q, const char *options, const Candidate *w)
+{
+int i;
+
+fprintf(stderr, "  formula -e legacy -m %.17g -t %.17g", q->mass, q->tol);
+if (q->charge > 0)
+	fprintf(stderr, " -p");
+else if (q->charge < 0)
+	fprintf(stderr, " -n");
+for (i = 0; i < nr_el; i++)
+	if ((q->min[i] != defmin[i]) || (q->max[i] != defmax[i]))
+		fprintf(stderr, " -%c %d-%d", el[i].key, q->min[i], q->max[i]);
+fprintf(stderr, "\n  (compare with %s), formula ", options);
+for (i = 0; i < nr_el; i++)
+	if (w->cnt[i] > 0)
+		fprintf(stderr, "%s%d", el[i].sym, w->cnt[i]);
+fprintf(stderr, "\n");
+}
+
+
+int main (int argc, char *argv[])
+{
+Query q, m;
+Candidate w;
+long n, nhits, total = 0;
+long queries = 500;
+double maxbox = 2e6;
+int i, e, tmp, verbose = 0, failed = 0;
+
+static const char *msg =
+"Compares the hits of all formula engines with the full loop (do_calculations)\n"
+"on random queries.\n\n"
+"usage: smdiff [options]\n\nValid command line options are:\n"
+"-h      This Help screen.\n"
+"-n num  Number of random queries (default 500).\n"
+"-s seed Seed of the random queries (default 1).\n"
+"-x box  Max. compositions in the element ranges of a query (default 2e6).\n"
+"-v      Print every query.\n";
+
+rng = 1;
+while ((tmp = getopt(argc, argv, "hn:s:x:v")) != EOF)
+	switch (tmp)
+		{
+		case 'h':
+			printf("%s", msg);
+			return 0;
+		case 'n':
+			queries = atol(optarg);
+			continue;
+		case 's':
+			rng = strtoull(optarg, NULL, 10);
+			continue;
+		case 'x':
+			maxbox = atof(optarg);
+			continue;
+		case 'v':
+			verbose = 1;
+			continue;
+		default:
+			printf ("'%s -h' for help.\n", argv[0]);
+			return 1;
+		}
+if (rng == 0)				/* xorshift must not start at 0 */
+	rng = 0x9E3779B97F4A7C15ULL;
+
+init_elements();
+cache_open(CACHE_ENTRIES, CACHE_QUANTUM, NULL);
+batch_min_share = 0.0;			/* split every query of 'batch' */
+frag_max_bytes = 4.0 * 1048576;		/* a table for the small precursors of 'frag' */
+for (i = 0; i < nr_el; i++)
+	{
+	defmin[i] = el[i].min;
+	defmax[i] = el[i].max;
+	}
+
+/* the reference prints its hits to stdout, only the verdict matters here */
+fflush(stdout);
+if (freopen("/dev/null", "w", stdout) == NULL)
+	{
+	fprintf(stderr, "Error: Cannot redirect stdout.\n");
+	return 1;
+	}
+
+for (n = 0; n < queries; n++)
+	{
+	random_query(&q, maxbox);
+	for (e = 0; e < NENGINES; e++)
+		{
+		if (!differ(&q, e, &w, &nhits))
+			{
+			if (e == 0)
+				total += nhits;
+			if (verbose)
+				fprintf(stderr, "query %ld: m=%.6f tol=%.4f mmu z=%+.0f box %.3g, %ld hits, %s ok\n",
+					n, q.mass, q.tol, q.charge, box_size(&q), nhits, engines[e].name);
+			continue;
+			}
+		failed++;
+		fprintf(stderr, "query %ld: engine '%s' differs from the reference, reproduce with\n",
+			n, engines[e].name);
+		m = q;
+		minimize(&m, e, &w);
+		print_reproducer(&m, engines[e].options, &w);
+		}
+	}
+
+fprintf(stderr, "%ld queries, %ld reference hits, %d engine(s): %d mismatch(es)\n",
+	queries, total, NENGINES, failed);
+return failed ? 1 : 0;
+}
@@ -0,0 +1,2493 @@
+/*
+
+SMFORMULA.CPP
+
+ Calculation engine of smformula_stdout.cpp, see there (and SMFORMULA.H)
+ for history, authors and license (GPL v2).
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <sstream>
+#include <math.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include "smformula.h"
+#include "smisodb.h"
+using namespace std; //RW
+
+/* --- atomic masses as published by IUPAC, 2002-10-02 ---------- */
+
+Element el[NEL]=
+/* array of the elements used here (or read by load_elements()):
+   Symbol, exact mass, dbe, keycode, number, default-min, default-max
+   RW: Actualization of exact masses, values from NIST, 2013
+*/
+// ele |    mass   |  dbe | key| min | max | cnt | save
+// masses: monoisotopic, from the database in smisodb.h
+{
+{ "C",  isodb_mass("C"),   +2.0, 'C', 0, 41, 0,0 },
+{ "X",  isodb_mass("X"),   +2.0, '1', 0, 0, 0 ,0 }, //13C
+{ "H",  isodb_mass("H"),   -1.0, 'H', 0, 72, 0 ,0},
+{ "D",  isodb_mass("D"),   -1.0, 'D', 0, 0, 0 ,0}, //2H
+{ "N",  isodb_mass("N"),   +1.0, 'N', 0, 34, 0,0 },		//org +1 = valence = 3: now +3 for valence = 5
+{ "M",  isodb_mass("M"),   +1.0, 'M', 0, 0, 0,0 }, //15N
+{ "O",  isodb_mass("O"),    0.0, 'O', 0, 30, 0 ,0},
+{ "F",  isodb_mass("F"),   -1.0, 'F', 0, 0, 0 ,0},
+{ "Na", isodb_mass("Na"),  -1.0, 'A', 0, 0, 0 ,0},
+{ "Si", isodb_mass("Si"),  +2.0, 'I', 0, 0, 0 ,0},	
+{ "P",  isodb_mass("P"),   +3.0, 'P', 0, 0, 0 ,0},		//org +1 valence = 3: now +3 for valence = 5
+{ "S",  isodb_mass("S"),   +4.0, 'S', 0, 0, 0 ,0},		//org 0 = valence = 2; now +4 for valence = 6
+{ "Cl", isodb_mass("Cl"),  -1.0, 'L', 0, 0, 0 ,0},
+{ "Br", isodb_mass("Br"),  -1.0, 'B', 0, 0, 0 ,0},
+};
+
+const double electron = 0.000549;	/* mass of the electron in amu */
+
+
+/* --- global variables --- */
+
+double  charge,		/* charge on the molecule */
+        tol;		/* mass tolerance in mmu */
+char    comment[MAXLEN]="";	/* some text ;-) */
+int     nr_el;		/* number of elements in array (above) */
+int     el_builtin = 1;	/* 1 = el[] as above; do_calculations() needs it */
+
+
+/* --- isotope scoring (-i) --- */
+
+int     niso_meas;		/* no. of measured isotope peaks, 0 = no scoring */
+double  iso_meas[MAXISO];	/* measured intensities, relative to M0 = 1 */
+int     iso_atno_el[NEL];	/* atom # of el[i] in the isotope tables */
+double  iso_keep;		/* -k: max. deviation of the closed-form M+1/M+2, 0 = off */
+isoapprox iso_apx;		/* closed-form M+1/M+2 coefficients of el[] */
+
+
+/* --- superset tolerances (-T) --- */
+
+int     ntiers;			/* no. of tolerances, 0 = off */
+double  tiers_ppm[MAXTIERS];	/* ascending, in ppm */
+
+
+const char *rule_names[NRULES] =	/* indexed by RULE_..., for print_stats() */
+{ "ok", "mass", "HC", "NC", "OC", "PC", "SC", "NOPS", "NOP", "OPS", "PSN", "NOS", "rdb", "lewis" };
+
+
+/* el[] indices of the elements the ratio rules look at, -1 if not in el[] */
+static int el_C, el_X, el_H, el_D, el_N, el_M, el_O, el_P, el_S;
+
+static int search_order[NEL];	/* nesting of search_formulas(), see setup_elements() */
+
+/* labels and their natural element, for search_labelled(): 13C, 15N, 2H */
+#define NLABELS	3
+static const char *label_sym[NLABELS][2] = { { "X", "C" }, { "M", "N" }, { "D", "H" } };
+static int lab_el[NLABELS], lab_nat[NLABELS];	/* el[] indices, -1 = not in el[] */
+
+
+/************************************************************************
+* EL_INDEX:	Index of element 'sym' in el[].				*
+* Returns. 	index, -1 if not in el[].				*
+*************************************************************************/
+int el_index(const char *sym)
+{
+int i;
+
+for (i = 0; i < nr_el; i++)
+	if (!strcmp(el[i].sym, sym))
+		return i;
+return -1;
+}
+
+
+/* the tables derived from el[] */
+static void setup_elements(void)
+{
+int i, k;
+
+for (i=0; i < nr_el; i++)
+	iso_atno_el[i] = iso_atno(NULL, el[i].sym);
+iso_approx_init(NULL, iso_atno_el, nr_el, &iso_apx);
+
+el_C = el_index("C");
+el_X = el_index("X");		/* 13C */
+el_H = el_index("H");
+el_D = el_index("D");		/* 2H */
+el_N = el_index("N");
+el_M = el_index("M");		/* 15N */
+el_O = el_index("O");
+el_P = el_index("P");
+el_S = el_index("S");
+
+for (k = 0; k < NLABELS; k++)	/* a label must count like its element in the rules */
+	{
+	lab_el[k] = el_index(label_sym[k][0]);
+	lab_nat[k] = el_index(label_sym[k][1]);
+	if ((lab_el[k] < 0) || (lab_nat[k] < 0) || (el[lab_el[k]].val != el[lab_nat[k]].val))
+		lab_el[k] = lab_nat[k] = -1;
+	}
+
+/* as the loop in do_calculations(): the last element outside, down to
+   the first, but D and H innermost, so the hits come out in the same order */
+k = 0;
+for (i = nr_el - 1; i >= 0; i--)
+	if ((i != el_H) && (i != el_D))
+		search_order[k++] = i;
+if (el_D >= 0)
+	search_order[k++] = el_D;
+if (el_H >= 0)
+	search_order[k++] = el_H;
+}
+
+
+/************************************************************************
+* INIT_ELEMENTS:	Sets up the tables derived from el[]; call once	*
+*		before any calculation.					*
+*************************************************************************/
+void init_elements(void)
+{
+for (nr_el = 0; (nr_el < NEL) && (el[nr_el].sym != NULL); nr_el++)
+	;
+niso_meas = 0;			/* no isotope scoring */
+iso_keep = 0.0;
+ntiers = 0;
+auto_bounds = 0;
+setup_elements();
+}
+
+
+/************************************************************************
+* LOAD_ELEMENTS:	Replaces el[] by the elements of a file, one per	*
+*		line as in el[] above: symbol, mass, dbe, key, range,	*
+*		e.g. "K 38.9637064864 -1.0 K 0-2"; '#' starts a	*
+*		comment. The isotope scoring knows all natural elements	*
+*		and the labels X (13C), D (2H) and M (15N).		*
+* Input: 	file name.						*
+* Returns. 	no. of elements; 0 if the file can't be read or has	*
+*		none, -n for an error in line n (syntax, mass <= 0, a	*
+*		symbol or key twice, more than NEL elements); el[] is	*
+*		unchanged then.						*
+*************************************************************************/
+int load_elements(const char *file)
+{
+static char syms[NEL][4];		/* of el[] after a load */
+char buf[MAXLEN], sym[MAXLEN], *p;
+char tsyms[NEL][4];			/* of tab[], copied when all is read */
+Element tab[NEL];
+double mass;
+float val;
+char key;
+int lo, hi, i, n, line;
+FILE *f;
+
+if ((f = fopen(file, "r")) == NULL)
+	return 0;
+n = line = 0;
+while (fgets(buf, sizeof(buf), f) != NULL)
+	{
+	line++;
+	if ((p = strchr(buf, '#')) != NULL)
+		*p = 0;
+	if (sscanf(buf, "%s", sym) != 1)		/* empty line */
+		continue;
+	if ((sscanf(buf, "%3s %lf %f %c %d-%d", sym, &mass, &val, &key, &lo, &hi) != 6)
+			|| (mass <= 0) || (lo < 0) || (lo > hi) || (n == NEL))
+		break;
+	for (i = 0; (i < n) && strcmp(tab[i].sym, sym) && (tab[i].key != key); i++)
+		;
+	if (i < n)
+		break;
+	strcpy(tsyms[n], sym);
+	tab[n].sym = tsyms[n];
+	tab[n].mass = mass;
+	tab[n].val = val;
+	tab[n].key = key;
+	tab[n].min = lo;
+	tab[n].max = hi;
+	tab[n].cnt = tab[n].save = 0;
+	n++;
+	}
+if (!feof(f))
+	{
+	fclose(f);
+	return -line;
+	}
+fclose(f);
+if (n == 0)
+	return 0;
+
+memcpy(syms, tsyms, sizeof(syms));	/* el[] may point there now */
+memcpy(el, tab, n * sizeof(Element));
+for (i = 0; i < n; i++)
+	el[i].sym = syms[i];
+for (i = n; i < NEL; i++)
+	el[i].sym = NULL;
+nr_el = n;
+el_builtin = 0;
+setup_elements();
+return n;
+}
+
+
+/************************************************************************
+* CALC_MASS:	Calculates mass of an ion from its composition.	  	*
+* Input: 	nothing (uses global variables) 	      		*
+* Returns. 	mass of the ion.	  				*
+* Note:		Takes care of charge and electron mass!   		*
+* 		(Positive charge means removal of electrons).	 	*
+*************************************************************************/
+double calc_mass(void)
+{
+int i;
+double sum = 0.0;
+
+for (i=0; i < nr_el; i++)
+	sum += el[i].mass * el[i].cnt;
+
+return (sum - (charge * electron));
+}
+
+
+/************************************************************************
+* CALC_MASS:	Same for a composition given as count vector, indexed	*
+*		like el[] (reentrant, for search_formulas()).		*
+*		Sums in the same order, so the result is bit-identical.	*
+*************************************************************************/
+double calc_mass(const int *cnt, double z)
+{
+int i;
+double sum = 0.0;
+
+for (i=0; i < nr_el; i++)
+	sum += el[i].mass * cnt[i];
+
+return (sum - (z * electron));
+}
+
+
+/************************************************************************
+* CALC_RDB:	Calculates rings & double bond equivalents.    		*
+* Input: 	nothing (uses global variables)			   	*
+* Returns. 	RDB.				       			*
+*************************************************************************/
+float calc_rdb(void)
+{
+int i;
+float sum = 2.0;
+
+for (i=0; i < nr_el; i++)
+	sum += el[i].val * el[i].cnt;
+
+return (sum/2.0);
+}
+
+
+float calc_rdb(const int *cnt)		/* same for a count vector */
+{
+int i;
+float sum = 2.0;
+
+for (i=0; i < nr_el; i++)
+	sum += el[i].val * cnt[i];
+
+return (sum/2.0);
+}
+/************************************************************************
+* Calculates element ratios , CH2 (more than 8 electrons needed is not handled)  		
+* Calculations element probabilities if element_probability = true 
+* Input: 	nothing (uses global variables)			   	
+* Returns. true/false.				       			
+*************************************************************************/
+bool calc_element_ratios(bool element_probability)
+{
+return (ratio_rule(element_probability) == RULE_OK);
+}
+
+
+int ratio_rule(bool element_probability)	/* see below, for el[].cnt */
+{
+int cnt[NEL];
+int i;
+
+for (i=0; i < nr_el; i++)
+	cnt[i] = el[i].cnt;
+return ratio_rule(cnt, element_probability);
+}
+
+
+/* same for a count vector indexed like el[] */
+bool calc_element_ratios(const int *cnt, bool element_probability)
+{
+return (ratio_rule(cnt, element_probability) == RULE_OK);
+}
+
+
+/************************************************************************
+* RATIO_RULE:	The checks of calc_element_ratios(), for a count	*
+*		vector indexed like el[].				*
+* Returns. 	RULE_OK, or the first rule (RULE_HC ... RULE_NOS) that	*
+*		rejects the composition.				*
+*************************************************************************/
+#define COUNT(i)	((i) >= 0 ? (float)cnt[i] : 0.0f)	/* of an element maybe not in el[] */
+
+int ratio_rule(const int *cnt, bool element_probability)
+{
+float HC_ratio;
+float NC_ratio;
+float OC_ratio;
+float PC_ratio;
+float SC_ratio;
+
+float C_count = COUNT(el_C)+COUNT(el_X); //RW added isotopes
+float H_count = COUNT(el_H)+COUNT(el_D); //RW added isotopes
+float N_count = COUNT(el_N)+COUNT(el_M); //RW added isotopes
+float O_count = COUNT(el_O);
+float P_count = COUNT(el_P);
+float S_count = COUNT(el_S);
+
+
+//RW ELEMENT RATIOS and CNOPS adjusted, according to Kind & Fiehn, 2007
+
+		/* ELEMENT RATIOS allowed
+			MIN		MAX (99.99%)
+		H/C	0.1		6.00
+		N/C	0.00	4.00
+		O/C	0.00	3.00
+		P/C	0.00	2.00
+		S/C	0.00	3.00
+		*/	
+
+//RW Probability check for common range (covering 99.7%)
+
+	// assume all ratios are ok, return at the first one which is not
+	
+	
+	if (C_count && H_count >0)					// C and H  must have one count anyway (remove for non-organics//
+	{	
+		HC_ratio = H_count/C_count;
+		if (element_probability)
+		{
+			if ((HC_ratio <  0.2) || (HC_ratio >  3.1)) // this is the H/C probability check ;
+			return RULE_HC;
+		}
+		else if (HC_ratio >  6.0) // this is the normal H/C ratio check - type cast from int to float is important
+			return RULE_HC;
+	}
+
+	if (N_count >0)	// if positive number of nitrogens then thes N/C ratio else just calc normal
+	{
+		NC_ratio = N_count/C_count;
+		if (element_probability)
+		{
+			if (NC_ratio >  1.3) // this is the N/C probability check ;
+			return RULE_NC;
+		}
+		else if (NC_ratio >  4.0)
+			return RULE_NC;
+	}	
+	
+	if (O_count >0)	// if positive number of O then thes O/C ratio else just calc normal
+	{	
+		OC_ratio = O_count/C_count;
+		if (element_probability)
+		{
+			if (OC_ratio >  1.2) // this is the O/C  probability check ;
+			return RULE_OC;		
+		}
+		else if (OC_ratio >  3.0)
+				return RULE_OC;
+	}	
+
+
+	if (P_count >0)	// if positive number of P then thes P/C ratio else just calc normal
+	{	
+		PC_ratio = 	P_count/C_count;
+		if (element_probability)
+		{
+			if (PC_ratio >  0.3) // this is the P/C  probability check ;
+			return RULE_PC;	
+		
+		}
+		else if (PC_ratio >  2.0)
+			return RULE_PC;
+	}	
+
+	if (S_count >0)	// if positive number of S then thes S/C ratio else just calc normal
+	{	
+		SC_ratio = 	S_count/C_count;
+		if (element_probability)
+		{
+			if (SC_ratio >  0.8) // this is the S/C  probability check ;
+			return RULE_SC;	
+		}
+		else if (SC_ratio >  3.0)
+			return RULE_SC;
+	}	
+
+//-----------------------------------------------------------------------------	
+		
+	// check for multiple element ratios together with probability check 
+	//if N<10, O<20, P<4, S<3 then true
+	if (element_probability && (N_count > 10) && (O_count > 20) && (P_count > 4) && (S_count > 3))
+		return RULE_NOPS;	
+	
+	// NOP check for multiple element ratios together with probability check
+	// NOP all > 3 and (N<11, O <22, P<6 then true)
+	if (element_probability && (N_count > 3) && (O_count > 3) && (P_count > 3))
+		{
+		if (element_probability && (N_count > 11) && (O_count > 22) && (P_count > 6))
+			return RULE_NOP;	
+		}
+	
+	// OPS check for multiple element ratios together with probability check
+	// O<14, P<3, S<3 then true
+	if (element_probability && (O_count > 14) && (P_count > 3) && (S_count > 3))
+		return RULE_OPS;	
+
+	// PSN check for multiple element ratios together with probability check
+	// P<3, S<3, N<4 then true
+	if (element_probability && (P_count > 3) && (S_count > 3) && (N_count >4))
+		return RULE_PSN;	
+
+	
+	// NOS check for multiple element ratios together with probability check
+	// NOS all > 6 and (N<19 O<14 S<8 then true)
+	if (element_probability && (N_count >6) && (O_count >6) && (S_count >6))
+	{
+		if (element_probability && (N_count >19) && (O_count >14) && (S_count >8))
+			return RULE_NOS;	
+	}	
+
+
+	return RULE_OK;
+}
+
+/************************************************************************
+* PARSE_ISOTOPES:	Reads the measured isotope pattern given with -i.	*
+* Input: 	comma separated intensities M0,M+1,...			*
+* Returns. 	no. of peaks (2...MAXISO), 0 if invalid.			*
+*************************************************************************/
+int parse_isotopes(char *text)
+{
+double val[MAXISO];
+int i, n;
+char *p;
+
+n = 0;
+for (p = strtok(text, ","); p != NULL; p = strtok(NULL, ","))
+	{
+	if (n >= MAXISO)
+		return 0;
+	val[n++] = atof(p);
+	}
+if ((n < 2) || (val[0] <= 0))
+	return 0;
+
+for (i = 0; i < n; i++)		/* relative to M0 */
+	iso_meas[i] = val[i] / val[0];
+niso_meas = n;
+return n;
+}
+
+
+/************************************************************************
+* PARSE_TIERS:	Reads the tolerances given with -T.			*
+* Input: 	comma separated tolerances in ppm, e.g. "1,3,5,10".	*
+* Returns. 	no. of tolerances (1...MAXTIERS), sorted; 0 if invalid.	*
+*************************************************************************/
+int parse_tiers(char *text)
+{
+char *p;
+int n;
+
+n = 0;
+for (p = strtok(text, ","); p != NULL; p = strtok(NULL, ","))
+	{
+	if ((n >= MAXTIERS) || (atof(p) <= 0))
+		return 0;
+	tiers_ppm[n++] = atof(p);
+	}
+sort(tiers_ppm, tiers_ppm + n);
+ntiers = n;
+return n;
+}
+
+
+/************************************************************************
+* CALC_ISOTOPES:	Calculates M0...M+3 of a candidate, directly from	*
+*		its composition (no formula string), see smisotope.h.	*
+* Input: 	candidate with cnt[] set; iso[] is filled in.		*
+* Returns. 	ISO_OK or error code of the isotope library.		*
+*************************************************************************/
+int calc_isotopes(Candidate *cand)
+{
+atom at[NEL];
+peak pk[MAXISO];
+int i, k, nat, npk, err;
+
+nat = 0;
+for (i = 0; i < nr_el; i++)
+	if (cand->cnt[i] > 0)
+		{
+		at[nat].atno = iso_atno_el[i];
+		at[nat].count = cand->cnt[i];
+		nat++;
+		}
+
+for (k = 0; k < MAXISO; k++)
+	cand->iso[k] = 0;
+err = iso_pattern(NULL, at, nat, 0, pk, MAXISO, &npk);
+if (err != ISO_OK)
+	return err;
+
+for (i = 0; (i < npk) && (i < MAXISO); i++)	/* tiny peaks may be missing */
+	{
+	k = pk[i].mass - pk[0].mass;
+	if (k < MAXISO)
+		cand->iso[k] = pk[i].intens / pk[0].intens;
+	}
+return ISO_OK;
+}
+
+
+/************************************************************************
+* SCORE_ISOTOPES:	RMS deviation of M+1...M+n from the measured	*
+*		pattern, in % of M0 (Kind & Fiehn, 2007, rule 5).		*
+* Returns. 	score, 0 = perfect match.					*
+*************************************************************************/
+double score_isotopes(const Candidate *cand)
+{
+double d, sum = 0.0;
+int k;
+
+for (k = 1; k < niso_meas; k++)
+	{
+	d = 100.0 * (cand->iso[k] - iso_meas[k]);
+	sum += d * d;
+	}
+return sqrt(sum / (niso_meas - 1));
+}
+
+
+/************************************************************************
+* PRESELECT_CANDIDATES:	Removes hits whose closed-form M+1/M+2 (see	*
+*		iso_approx() in smisotope.h) are more than iso_keep % of M0	*
+*		off the measured pattern, all hits in one pass.		*
+*		The closed form is within 0.001 % of the exact pattern, so	*
+*		only the exact calculation of the survivors remains.	*
+* Input: 	hits, reduced in place.					*
+*************************************************************************/
+void preselect_candidates(vector<Candidate> &cands)
+{
+size_t j, n, kept;
+int i;
+
+n = cands.size();
+if (n == 0)
+	return;
+vector<int> counts(n * nr_el);	/* column-major: element i of hit j at i*n+j */
+vector<float> m1(n), m2(n);
+
+for (j = 0; j < n; j++)
+	for (i = 0; i < nr_el; i++)
+		counts[i * n + j] = cands[j].cnt[i];
+iso_approx(&iso_apx, &counts[0], (int)n, &m1[0], &m2[0]);
+
+kept = 0;
+for (j = 0; j < n; j++)
+	{
+	if (100.0 * fabs(m1[j] - iso_meas[1]) > iso_keep)
+		continue;
+	if ((niso_meas > 2) && (100.0 * fabs(m2[j] - iso_meas[2]) > iso_keep))
+		continue;
+	cands[kept++] = cands[j];
+	}
+cands.resize(kept);
+}
+
+
+bool smaller_error(const Candidate &a, const Candidate &b)	/* for sort(), -T */
+{
+return fabs(a.error) < fabs(b.error);
+}
+
+
+bool better_candidate(const Candidate &a, const Candidate &b)	/* for sort() */
+{
+if (a.score != b.score)
+	return a.score < b.score;
+return fabs(a.error) < fabs(b.error);
+}
+
+
+/************************************************************************
+* HIT_HEADER:	Columns of the hit list, without the line end.		*
+*************************************************************************/
+string hit_header(void)
+{
+stringstream hroutstream;   //RW string stream used for the conversion to string and file output
+hroutstream << "Formula" << ";" << "RDB" << ";" << "LEWIS"  << ";"  << "Mass_Da" << ";" << "Mass_Error_mDa"; //RW
+if (niso_meas > 0)
+	hroutstream << ";" << "M1" << ";" << "M2" << ";" << "M3" << ";" << "Iso_Score";
+if (ntiers > 0)
+	hroutstream << ";" << "Tol_ppm";
+if (frag_mode)
+	hroutstream << ";" << "Loss";
+if (suspect_mode)
+	hroutstream << ";" << "Adduct" << ";" << "Suspect";
+return hroutstream.str();	//RW conversion of the stream to a string
+}
+
+
+/************************************************************************
+* HIT_LINE:	One hit in the columns of hit_header(), without the	*
+*		line end.						*
+*************************************************************************/
+string hit_line(const Candidate &c)
+{
+ostringstream hroutstream;
+int i;
+
+for (i = 0; i < nr_el; i++)
+	if (c.cnt[i] > 0)
+		hroutstream << el[i].sym << c.cnt[i];
+hroutstream << ";" << c.rdb << ";" << c.lewis << ";" << c.mass << ";" << c.error;
+if (niso_meas > 0)
+	hroutstream << ";" << 100.0 * c.iso[1] << ";" << 100.0 * c.iso[2] << ";" << 100.0 * c.iso[3] << ";" << c.score;
+if (ntiers > 0)
+	hroutstream << ";" << tiers_ppm[c.tier];
+if (frag_mode)
+	hroutstream << ";" << neutral_loss(c);
+if (suspect_mode)
+	hroutstream << ";" << suspect_label(c);
+return hroutstream.str();
+}
+
+
+/************************************************************************
+* PRINT_HEADER:	Prints the csv header of the hit list.			*
+*************************************************************************/
+void print_header(void)
+{
+cout << hit_header() << " \n"; //RW writing the string to the file
+}
+
+
+/************************************************************************
+* PRINT_HITS:	Prints hits in the given order, with the isotope	*
+*		columns if a pattern was measured (-i).			*
+* Input: 	hits.								*
+*************************************************************************/
+void print_hits(const vector<Candidate> &cands)
+{
+size_t j;
+
+for (j = 0; j < cands.size(); j++)
+	cout << hit_line(cands[j]) + " \n";
+}
+
+
+/************************************************************************
+* PRINT_CANDIDATES:	Prints the scored hits, best isotope match first.	*
+* Input: 	hits.								*
+*************************************************************************/
+void print_candidates(vector<Candidate> &cands)
+{
+sort(cands.begin(), cands.end(), better_candidate);
+print_hits(cands);
+}
+
+/************************************************************************
+* DO_CALCULATIONS: Does the actual calculation loop.			*
+* Input: 	   measured mass (in amu), tolerance (in mmu),		*
+*		   optional pointer to stats (may be NULL),		*
+*		   optional vector the hits are appended to (may be NULL)	*
+* Returns. 	   number of hits.	       				*
+*************************************************************************/
+long do_calculations (double measured_mass, double tolerance, SearchStats *stats, vector<Candidate> *hits)
+{
+double mass;			/* calc'd mass */
+double limit_lo, limit_hi;	/* mass limits */
+float rdb, lewis;			/* Rings & double bonds */
+long i;
+long long hit;		/* counts the hits, with long declaration, overflow after 25h with all formulas < 2000 Da
+							    long = FFFFFFFFh = 4,294,967,295d*/
+long long counter;
+bool elementcheck;
+vector<Candidate> cands;	/* hits to be scored, with -i */
+Candidate cand;
+int rule;
+long long rejected[NRULES];	/* by rule, for stats */
+long long inwindow;
+long long t0, t1, t_loop, t_filter, t_output;
+
+
+printf("\n");		/* linefeed */
+
+/* calculate limits */
+
+limit_lo = measured_mass - (tolerance / 1000.0);
+limit_hi = measured_mass + (tolerance / 1000.0);
+
+// if (strlen(comment))	/* print only if there is some text to print */
+// 	printf ("Text      \t%s\n", comment);
+
+// printf ("Composition\t");
+// for (i=0; i < nr_el; i++)
+// 	if (el[i].max > 0)
+// 		printf("%s:%d-%d ", el[i].sym, el[i].min, el[i].max);
+// printf ("\n");
+
+// printf ("Tol (mmu)\t%.1f\n",tolerance);
+// printf ("Measured\t%.4lf\n", measured_mass);
+// printf ("Charge  \t%+.1lf\n", charge);
+
+
+
+/*
+RW defining the csv file name and writing the header
+*/
+
+
+// ofstream denovofile; //RW define output file variable
+// denovofile.open ("HR3.csv"); //RW define output file name
+print_header();
+
+hit = 0;			/* Reset counter */
+counter = 0;
+mass = 0.0;		/* no break before the first mass */
+memset(rejected, 0, sizeof(rejected));
+memset(&cand, 0, sizeof(cand));	/* counts beyond nr_el stay 0 */
+inwindow = 0;
+t_filter = t_output = 0;
+t0 = t1 = 0;
+t_loop = clock_ns();
+
+/* Now let's run the big big loop ... I'd like to do that
+   recursively but did not yet figure out how ;-) 
+   TK Adds: the loop is just fine.
+*/
+
+/* now comes the "COOL trick" for calculating all formulae:
+sorting the high mass elements to the outer loops, the small weights (H)
+to the inner loops;
+
+This will reduce the computational time by factor ~10-60-1000
+OLD HR: Cangrelor at 1ppm  4465 formulas found in   5866 seconds.
+NEW HR2: Cangrelor at 1ppm 4465 formulas found in     96 seconds.
+NEW2 HR2: Cangrelor at 1ppm 4465 formulas found in     60 seconds.
+NEW3 HR2: Cangrelor at 1ppm 4465 formulas found in     59 seconds.
+HR2 Fast: Cangrelor at 1ppm 4465 formulas found in     41 seconds by evaluating 2,003,436,894 formulae.
+hr2 -c "Cangrelor" -m  774.948 -t 0.77 -C 1-64 -H 1-112 -N 0-30 -O 0-80 -P 0-12 -S 0-9 -F 0-10 -L 0-10
+
+Another additional trick is to end the 2nd.. 3rd.. 4th.. xth innermost loop
+to prevent loops which are just higher and higher in mass.
+*/
+
+el[13].cnt = el[13].min - 1;  el[13].save = el[13].cnt; 
+while (el[13].cnt++ < el[13].max) /* "Br"*/ { 
+
+el[12].cnt = el[12].min - 1;  el[12].save = el[12].cnt; 
+while (el[12].cnt++ < el[12].max) /*"Cl"*/ { 
+	 
+el[11].cnt = el[11].min - 1;  el[11].save = el[11].cnt; 
+while (el[11].cnt++ < el[11].max) /*"S"*/ { 
+	 
+el[10].cnt = el[10].min - 1;  el[10].save = el[10].cnt; 
+while (el[10].cnt++ < el[10].max) /*"P"*/ { 
+	 
+el[9].cnt = el[9].min - 1;  el[9].save = el[9].cnt; 
+while (el[9].cnt++ < el[9].max) /*"Si"*/ { 
+
+el[8].cnt = el[8].min - 1;  el[8].save = el[8].cnt; 
+while (el[8].cnt++ < el[8].max) /*"Na"*/{ 
+
+el[7].cnt = el[7].min - 1;  el[7].save = el[7].cnt; 
+while (el[7].cnt++ < el[7].max) /*"F"*/ { 
+ 
+el[6].cnt = el[6].min - 1;  el[6].save = el[6].cnt; 
+while (el[6].cnt++ < el[6].max) /*"O"*/ { 
+	 
+el[5].cnt = el[5].min - 1;  el[5].save = el[5].cnt; 
+while (el[5].cnt++ < el[5].max) /*"15N"*/{ 
+
+el[4].cnt = el[4].min - 1; el[4].save = el[4].cnt; 
+while (el[4].cnt++ < el[4].max) /*"N"*/{ 
+	 
+el[1].cnt = el[1].min - 1; el[1].save = el[1].cnt; 
+while (el[1].cnt++ < el[1].max) /*"13C"*/ { 
+
+el[0].cnt = el[0].min - 1; el[0].save = el[0].cnt; 
+while (el[0].cnt++ < el[0].max) /* "C"*/ { 
+
+el[3].cnt = el[3].min - 1; 	el[3].save = el[3].cnt; 
+while (el[3].cnt++ < el[3].max) /*"D"*/{ 
+
+el[2].cnt = el[2].min - 1; el[2].save = el[2].cnt; 
+while (el[2].cnt++ < el[2].max) /*"H"*/{ 
+
+	mass = calc_mass();
+	counter++;
+
+	//just for debug purposes
+	//if (mass > limit_hi)  
+	//printf("mass: %f\tC: %d  H: %d  N: %d O: %d P: %d S: %d Cl: %d Br: %d\n",mass,el[0].cnt,el[2].cnt,el[4].cnt,el[6].cnt,el[10].cnt,el[11].cnt,el[12].cnt,el[13].cnt);
+    	
+	/* if we exceed the upper limit, we can stop the calculation
+       for this particular element (JHa 20050227). <-- comment TK that will only bust the innermost while loop, which is "H"*/
+
+	// break H loop 	if (mass > limit_hi)  break;
+
+    //************************************************************************************************************/	
+	//Calculus loop with print out
+	//************************************************************************************************************/	
+	
+
+
+	if ((mass >= limit_lo) && (mass <= limit_hi)) /* within limits? */
+	{	
+		// element check will be performed always, if variable bool element_probability is true also probabilities will be calculated
+		// not an elegant implementation, but fast.
+		 inwindow++;
+		 if (stats != NULL)
+			t0 = clock_ns();
+		 rule = ratio_rule(true);
+		 elementcheck = (rule == RULE_OK);
+		 if (!elementcheck)
+			rejected[rule]++;
+		 if (elementcheck)
+	{ 
+	rdb = calc_rdb();	/* get RDB */
+	lewis = (float)(fmod(rdb, 1)); /*calc remainder*/
+	if (rdb < 0)
+		rejected[RULE_RDB]++;
+	else if ((lewis == 0.5) || (lewis == -0.5))
+		rejected[RULE_LEWIS]++;
+	if ((rdb >= 0) && (lewis != 0.5) && (lewis !=-0.5))/* less than -0.5 RDB does not make sense */
+
+		{													/* NO(!) CH3F10NS2 exists , RDB =  -4.0   M= 282.9547*/
+
+		if (stats != NULL)
+			t1 = clock_ns();
+		
+		hit ++;
+		if ((niso_meas > 0) || (hits != NULL))
+			{
+			for (i = 0; i < nr_el; i++)
+				cand.cnt[i] = el[i].cnt;
+			cand.rdb = rdb;
+			cand.lewis = lewis;
+			cand.mass = mass;
+			cand.error = 1000.0 * (measured_mass - mass);
+			if (hits != NULL)
+				hits->push_back(cand);
+			}
+		if (niso_meas > 0)	/* score it in-process, printed ranked below */
+			cands.push_back(cand);
+		else
+		{
+		for (i = 0; i < nr_el; i++)	 /* print composition */
+		    if (el[i].cnt > 0)	/* but only if useful */
+		 
+			  {
+			  // printf("%s%d.", el[i].sym, el[i].cnt);	//print formula to screen
+			  ostringstream hroutstream;   //RW string stream used for the conversion to string and file output
+			  hroutstream << el[i].sym << el[i].cnt; //RW generation of formula string
+			  string stringResult;          //RW resulting string variable
+			  stringResult = hroutstream.str(); //RW conversion of the stream to a string
+			  cout << stringResult; //RW writing the string to the stdout
+		      }
+			  // printf("\t\t%.1f\t%.4lf\t%+.1lf mmu \n", rdb, mass, 1000.0 * (measured_mass - mass));
+			  
+			  double mass_out = mass;
+  		
+	  		  float rdb_out = rdb;
+	  		  
+	  		  float lewis_out = lewis;
+	  		  
+	  		  ostringstream hroutstream;   //RW stream used for the conversion to string and file output
+	  		  hroutstream << ";" << rdb_out << ";" << lewis_out  << ";"  << mass_out << ";" << 1000.0 * (measured_mass - mass) << " \n"; //RW
+			  
+			  string stringResult;          //RW resulting string variable
+			  stringResult = hroutstream.str(); //RW conversion of the stream to a string
+			  cout << stringResult; //RW writing the string to the file
+		}
+		if (stats != NULL)
+			t_output += clock_ns() - t1;
+			  
+  
+		}	/* end of 'rdb' loop */
+		else if (stats != NULL)
+			t1 = clock_ns();
+
+	}	// end of elementcheck loop
+	else if (stats != NULL)
+		t1 = clock_ns();
+	if (stats != NULL)
+		t_filter += t1 - t0;
+	
+	}	/* end of 'limit' loop */
+	//************************************************************************************************************/
+		
+
+	/*
+	TK: if the current mass is larger than the limit the loop can be exited.
+	Each element must point to the element which is in use and before.
+	This is a static implementation which can be enhanced with a pointer chain to the lower element.
+	Actually now its only allowed for CHNSOP-Fl-Cl-Br-Si !!! Brute-force <> elegance :-)
+	*/
+		} /*"H"*/
+		
+		} /*"D"*/
+		
+		if ((mass >= limit_lo) && (el[2].save == el[2].cnt-1)) break;
+		} /* "C"*/
+		
+		} /*"13C"*/
+
+		if ((mass >= limit_lo) && (el[0].save == el[0].cnt-1)) break;
+		} /*"N"*/
+		
+		} /*"15N"*/
+
+        if ((mass >= limit_lo) && (el[4].save == el[4].cnt-1)) break;
+		} /*"O"*/
+		
+	    if ((mass >= limit_lo) && (el[6].save == el[6].cnt-1)) break;
+		} /*"F"*/
+		
+		} /*"Na"*/
+		
+	    if ((mass >= limit_lo) && (el[7].save == el[7].cnt-1)) break;
+		}  /*"Si"*/
+		
+		if ((mass >= limit_lo) && (el[9].save == el[9].cnt-1)) break;
+		} /*"P"*/
+		
+		if ((mass >= limit_lo) && (el[10].save == el[10].cnt-1)) break;
+		} /*"S"*/
+		
+		if ((mass >= limit_lo) && (el[11].save == el[11].cnt-1)) break;
+		} /*"Cl"*/
+		
+		if ((mass >= limit_lo) && (el[12].save == el[12].cnt-1)) break;
+		} /*"Br" ends*/
+/* close that giant loop thing started above */
+
+// denovofile.close(); //RW
+//return 0; //RW
+	
+
+t_loop = clock_ns() - t_loop;
+if (stats != NULL)
+	{
+	memset(stats, 0, sizeof(*stats));
+	stats->ns_enumerate = t_loop - t_filter - t_output;
+	stats->ns_filter = t_filter;
+	}
+
+if (niso_meas > 0)
+	{
+	t0 = clock_ns();
+	if (iso_keep > 0)
+		preselect_candidates(cands);
+	for (i = 0; i < (long)cands.size(); i++)
+		{
+		calc_isotopes(&cands[i]);
+		cands[i].score = score_isotopes(&cands[i]);
+		}
+	t1 = clock_ns();
+	print_candidates(cands);
+	fflush(stdout);
+	t_output += clock_ns() - t1;
+	if (stats != NULL)
+		stats->ns_score = t1 - t0;
+	}
+
+if (stats != NULL)
+	{
+	stats->evaluated = counter;
+	stats->hits = hit;
+	memcpy(stats->rejected, rejected, sizeof(rejected));
+	stats->rejected[RULE_MASS] = counter - inwindow;
+	stats->ns_output = t_output;
+	}
+
+
+
+return hit;
+}
+
+
+/************************************************************************
+* CLOCK_NS:	Monotonic clock in ns, for SearchStats.			*
+*************************************************************************/
+long long clock_ns(void)
+{
+struct timespec ts;
+
+clock_gettime(CLOCK_MONOTONIC, &ts);
+return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+
+/************************************************************************
+* PRINT_STATS:	Writes the stats of one query as one line of JSON.	*
+* Input: 	stream, stats, the query's mass and tolerance (mmu);	*
+*		charge, comment and engine are taken from the globals.	*
+*************************************************************************/
+void print_stats(FILE *f, const SearchStats *st, double mass, double tolerance)
+{
+const char *p;
+int i;
+
+fprintf(f, "{\"comment\": \"");
+for (p = comment; *p; p++)		/* JSON string */
+	if ((*p == '"') || (*p == '\\'))
+		fprintf(f, "\\%c", *p);
+	else if ((unsigned char)*p >= ' ')
+		fputc(*p, f);
+fprintf(f, "\", \"engine\": \"%s\", \"mass\": %.6f, \"tol_mmu\": %.6f, \"charge\": %.0f, "
+	"\"evaluated\": %lld, \"hits\": %lld, ",
+	engine == ENGINE_FAST ? "fast" : "legacy", mass, tolerance, charge, st->evaluated, st->hits);
+fprintf(f, "\"ns\": {\"enumerate\": %lld, \"filter\": %lld, \"score\": %lld, \"output\": %lld}, ",
+	st->ns_enumerate, st->ns_filter, st->ns_score, st->ns_output);
+fprintf(f, "\"rejected\": {");
+for (i = RULE_MASS; i < NRULES; i++)
+	fprintf(f, "%s\"%s\": %lld", i == RULE_MASS ? "" : ", ", rule_names[i], st->rejected[i]);
+fprintf(f, "}, \"pruned\": {");
+for (i = 0; i < nr_el; i++)
+	fprintf(f, "%s\"%s\": %lld", i ? ", " : "", el[i].sym, st->pruned[i]);
+fprintf(f, "}");
+if (st->ntiers > 0)		/* -T: hits within each tolerance = prefix length */
+	{
+	fprintf(f, ", \"tiers\": {");
+	for (i = 0; i < st->ntiers; i++)
+		fprintf(f, "%s\"%g\": %lld", i ? ", " : "", tiers_ppm[i], st->tier_hits[i]);
+	fprintf(f, "}");
+	}
+if (st->cache_lookups > 0)
+	fprintf(f, ", \"cache\": {\"hit\": %s, \"lookups\": %lld, \"hits\": %lld, \"hit_rate\": %.4f}",
+		st->cached ? "true" : "false", st->cache_lookups, st->cache_hits,
+		st->cache_hits / (double)st->cache_lookups);
+if (st->partial)		/* stopped by its budget */
+	fprintf(f, ", \"partial\": true, \"covered\": %.4f", st->covered);
+fprintf(f, "}\n");
+fflush(f);
+}
+
+
+/* --- adducts ---------------------------------------------------------- */
+
+#define A_H	1.0078250321
+#define A_NA	22.9897692809
+#define A_K	38.9637064864
+#define A_CL	34.96885268
+#define A_NH3	(14.0030740048 + 3 * A_H)
+#define A_H2O	(15.9949146196 + 2 * A_H)
+
+const Adduct adducts[] =	/* the list of formulae/data.py */
+{
+{ "[M+H]+",        1,  1, A_H },
+{ "[M+2H]2+",      1,  2, 2 * A_H },
+{ "[M+H+Na]2+",    1,  2, A_H + A_NA },
+{ "[M+H+K]2+",     1,  2, A_H + A_K },
+{ "[M+Na]+",       1,  1, A_NA },
+{ "[M+K]+",        1,  1, A_K },
+{ "[M+2Na-H]+",    1,  1, 2 * A_NA - A_H },
+{ "[M+2K-H]+",     1,  1, 2 * A_K - A_H },
+{ "[2M+H]+",       2,  1, A_H },
+{ "[2M+2H]2+",     2,  2, 2 * A_H },
+{ "[2M+H+Na]2+",   2,  2, A_H + A_NA },
+{ "[2M+H+K]2+",    2,  2, A_H + A_K },
+{ "[2M+Na]+",      2,  1, A_NA },
+{ "[2M+K]+",       2,  1, A_K },
+{ "[2M+2Na-H]+",   2,  1, 2 * A_NA - A_H },
+{ "[2M+2K-H]+",    2,  1, 2 * A_K - A_H },
+{ "[M+H-NH3]+",    1,  1, A_H - A_NH3 },
+{ "[M+2H-NH3]2+",  1,  2, 2 * A_H - A_NH3 },
+{ "[M+H-H2O]+",    1,  1, A_H - A_H2O },
+{ "[M+2H-H2O]2+",  1,  2, 2 * A_H - A_H2O },
+{ "[M-H]-",        1, -1, -A_H },
+{ "[M-2H]2-",      1, -2, -2 * A_H },
+{ "[M-2H+Na]-",    1, -1, A_NA - 2 * A_H },
+{ "[M-H+Cl]2-",    1, -2, A_CL - A_H },
+{ "[M-2H+K]-",     1, -1, A_K - 2 * A_H },
+{ "[M+Cl]-",       1, -1, A_CL },
+{ "[2M-H]-",       2, -1, -A_H },
+{ "[2M-2H]2-",     2, -2, -2 * A_H },
+{ "[2M-2H+Na]-",   2, -1, A_NA - 2 * A_H },
+{ "[2M-H+Cl]2-",   2, -2, A_CL - A_H },
+{ "[2M-2H+K]-",    2, -1, A_K - 2 * A_H },
+{ "[2M+Cl]-",      2, -1, A_CL },
+{ "[M-H-H2O]-",    1, -1, -A_H - A_H2O },
+};
+const int nr_adducts = sizeof(adducts) / sizeof(adducts[0]);
+
+
+/************************************************************************
+* FIND_ADDUCT:	Looks up an adduct by name ("[M+Na]+").			*
+* Returns. 	pointer into adducts[], NULL if unknown.			*
+*************************************************************************/
+const Adduct *find_adduct(const char *name)
+{
+int i;
+
+for (i = 0; i < nr_adducts; i++)
+	if (!strcmp(adducts[i].name, name))
+		return &adducts[i];
+return NULL;
+}
+
+
+/* m/z of the adduct ion of a molecule of (neutral) mass M, and back */
+double adduct_mz(const Adduct *a, double mass)
+{
+return (a->nmol * mass + a->delta - a->z * electron) / abs(a->z);
+}
+
+double adduct_neutral(const Adduct *a, double mz)
+{
+return (mz * abs(a->z) + a->z * electron - a->delta) / a->nmol;
+}
+
+
+/* --- adaptive element ranges (-b) ----------------------------------- */
+
+int     auto_bounds;		/* adapt_bounds() in calculate(), 0 = off */
+
+/* max. atom counts of known compounds up to these masses (Kind & Fiehn,
+   "Seven Golden Rules", 2007; element_restrictions in formulae/data.py):
+   each holds for all masses up to its knot; the caps use the running max.
+   over the knots (a count allowed at 1999 Da is allowed at 2001 Da) and
+   are a smooth upper envelope of these steps; labels count like their element */
+#define NKNOTS	4
+static const double knot_mass[NKNOTS] = { 500, 1000, 2000, 3000 };
+
+static const struct	{
+			const char *sym;
+			short	max[NKNOTS];
+			} knot_max[] =
+{
+{ "C",  { 39,  78, 156, 162 } },
+{ "X",  { 39,  78, 156, 162 } },	/* 13C */
+{ "H",  { 72, 126, 236, 208 } },
+{ "D",  { 72, 126, 236, 208 } },	/* 2H */
+{ "N",  { 20,  25,  32,  48 } },
+{ "M",  { 20,  25,  32,  48 } },	/* 15N */
+{ "O",  { 20,  27,  63,  78 } },
+{ "F",  { 16,  34,  48,  16 } },
+{ "Si", {  8,  14,  15,  15 } },
+{ "P",  {  9,   9,   9,   9 } },
+{ "S",  { 10,  14,  14,   9 } },
+{ "Cl", { 10,  12,  12,  11 } },
+{ "Br", {  5,   8,  10,   4 } },
+};
+#define NKNOWN	(int)(sizeof(knot_max) / sizeof(knot_max[0]))
+
+
+/* max. of knots 0...k of entry i: does not decrease along the mass */
+static int step_max(int i, int k)
+{
+int j, m = 0;
+
+for (j = 0; j <= k; j++)
+	if (knot_max[i].max[j] > m)
+		m = knot_max[i].max[j];
+return m;
+}
+
+
+/* table maximum of element 'sym' at 'mass', -1 if not in the table: within
+   (knot k-1, knot k] from the step max. of knot k towards that of knot k+1 */
+static int known_max(const char *sym, double mass)
+{
+double lo, f;
+int i, k, a, b;
+
+for (i = 0; (i < NKNOWN) && strcmp(knot_max[i].sym, sym); i++)
+	;
+if (i == NKNOWN)
+	return -1;
+for (k = 0; (k < NKNOTS - 1) && (mass > knot_mass[k]); k++)
+	;
+a = step_max(i, k);
+if (k == NKNOTS - 1)		/* the last step, and above */
+	return a;
+b = step_max(i, k + 1);
+lo = (k > 0) ? knot_mass[k - 1] : 0.0;
+f = (mass - lo) / (knot_mass[k] - lo);
+return (int)ceil(a + f * (b - a));
+}
+
+
+/************************************************************************
+* ADAPT_BOUNDS:	Lowers the max. atom counts of a query to what its mass	*
+*		allows:							*
+*		- the table of known compounds above (a heuristic),	*
+*		- the mass: count * mass of the element plus the mins	*
+*		  of the others must stay within the window,		*
+*		- the valences: atoms with negative dbe (H, halogens,	*
+*		  Na) are limited by the positive ones, as RDB >= 0.	*
+*		The last two never lose a hit. A max. is not lowered	*
+*		below the min. of the query.				*
+*************************************************************************/
+void adapt_bounds(Query *q)
+{
+double hi, rest, pos;
+int i, cap;
+
+hi = q->mass + (q->tol / 1000.0) + (q->charge * electron) + 1e-6;	/* rounding */
+rest = 0.0;
+for (i = 0; i < nr_el; i++)
+	rest += q->min[i] * el[i].mass;
+
+for (i = 0; i < nr_el; i++)
+	{
+	cap = known_max(el[i].sym, q->mass);
+	if ((cap >= 0) && (cap < q->max[i]))
+		q->max[i] = cap;
+	cap = (int)floor((hi - rest + q->min[i] * el[i].mass) / el[i].mass);
+	if (cap < q->max[i])
+		q->max[i] = cap;
+	}
+
+pos = 2.0;			/* RDB = (2 + sum dbe * count) / 2 */
+for (i = 0; i < nr_el; i++)
+	if (el[i].val > 0)
+		pos += el[i].val * q->max[i];
+for (i = 0; i < nr_el; i++)
+	if (el[i].val < 0)
+		{
+		cap = (int)floor(pos / -el[i].val);
+		if (cap < q->max[i])
+			q->max[i] = cap;
+		}
+
+for (i = 0; i < nr_el; i++)
+	if (q->max[i] < q->min[i])
+		q->max[i] = q->min[i];
+}
+
+
+/************************************************************************
+* ISOTOPE_BOUNDS:	With -k, narrows the atom count ranges of a query	*
+*		to the counts whose closed-form M+1/M+2 can still be	*
+*		within iso_keep % of the measured ones, i.e. what	*
+*		preselect_candidates() would keep: M+1 = sum n*a1	*
+*		bounds each count by the least and most the others	*
+*		add (the carbon count), and as				*
+*		sum n*a2 <= M+2 <= sum n*a2 + (M+1)^2 / 2,		*
+*		M+2 bounds Cl, Br, S, ... alike; repeated until no	*
+*		range changes. The hits are the same, the outer levels	*
+*		of the search get shorter. A range may become empty	*
+*		(min > max): no formula fits the pattern.		*
+*************************************************************************/
+void isotope_bounds(Query *q)
+{
+double d, lo1, hi1, lo2, hi2, min1, max1, min2, max2, lo, hi;
+int i, changed, pass;
+
+if ((niso_meas < 2) || (iso_keep <= 0))
+	return;
+d = iso_keep / 100.0 + 1e-5;		/* + float rounding of iso_approx() */
+lo1 = iso_meas[1] - d;
+hi1 = iso_meas[1] + d;
+lo2 = (niso_meas > 2) ? iso_meas[2] - d - 0.5 * hi1 * hi1 : -1e30;
+hi2 = (niso_meas > 2) ? iso_meas[2] + d : 1e30;
+
+for (pass = 0, changed = 1; changed && (pass < 4 * nr_el); pass++)
+	{
+	min1 = max1 = min2 = max2 = 0.0;
+	for (i = 0; i < nr_el; i++)
+		{
+		min1 += q->min[i] * iso_apx.a1[i];
+		max1 += q->max[i] * iso_apx.a1[i];
+		min2 += q->min[i] * iso_apx.a2[i];
+		max2 += q->max[i] * iso_apx.a2[i];
+		}
+	changed = 0;			/* sums of a pass are wider than the ranges: still safe */
+	for (i = 0; i < nr_el; i++)
+		{
+		lo = q->min[i];
+		hi = q->max[i];
+		if (iso_apx.a1[i] > 0)
+			{
+			hi = min(hi, floor((hi1 - min1 + q->min[i] * iso_apx.a1[i]) / iso_apx.a1[i]));
+			lo = max(lo, ceil((lo1 - max1 + q->max[i] * iso_apx.a1[i]) / iso_apx.a1[i]));
+			}
+		if (iso_apx.a2[i] > 0)
+			{
+			hi = min(hi, floor((hi2 - min2 + q->min[i] * iso_apx.a2[i]) / iso_apx.a2[i]));
+			lo = max(lo, ceil((lo2 - max2 + q->max[i] * iso_apx.a2[i]) / iso_apx.a2[i]));
+			}
+		if ((lo > q->min[i]) || (hi < q->max[i]))
+			{
+			q->min[i] = (int)lo;
+			q->max[i] = (int)hi;
+			changed = 1;
+			}
+		if (q->min[i] > q->max[i])
+			return;
+		}
+	}
+}
+
+
+/* --- fast engine ------------------------------------------------------ */
+
+int     engine = ENGINE_LEGACY;	/* used by calculate() */
+SearchBudget *search_budget;		/* Query.budget of make_query(), NULL = none */
+
+#define SEARCH_SLACK 1e-6	/* Da; pruning is done on partial sums, the hit test on calc_mass() */
+#define MAXUNROLL 9		/* levels of the unrolled kernels: CHNOPS + F, Cl, Br */
+#define BUDGET_NODES 1024	/* nodes between two looks at the budget, a power of 2 */
+#define PROGRESS_NS 100000000LL	/* ns between two progress calls */
+
+typedef struct	{
+		const Query *q;
+		double	lo, hi;			/* mass window of the ion */
+		double	slo, shi;		/* same for the sum of the atom masses, widened */
+		int	nlev;			/* levels: the elements with a range, */
+		int	order[NEL];		/* in the order of search_order[] */
+		double	restmin[NEL+1],		/* mass of levels k...nlev-1 at their min. counts */
+			restmax[NEL+1];		/* ... and at their max. counts */
+		int	cnt[NEL];		/* composition, indexed like el[] */
+		vector<Candidate> *hits;
+		long long evaluated;
+		long long rejected[NRULES];	/* by RULE_... */
+		long long pruned[NEL];		/* counts skipped, by element */
+		bool	timing;			/* measure ns_filter */
+		long long ns_filter;
+		long long nodes;		/* level_range() calls, for the budget */
+		long long deadline;		/* clock_ns() to stop at, 0 = none */
+		long long max_evaluated;	/* 0 = no limit */
+		long long next_progress;	/* clock_ns() of the next progress call */
+		int	stop;			/* budget used up or cancelled */
+		double	covered;		/* part of the space done when stopped */
+		} SearchState;
+
+
+/************************************************************************
+* MAKE_QUERY:	Fills a query from el[].min/max and the global charge.	*
+*************************************************************************/
+void make_query(Query *q, double measured_mass, double tolerance)
+{
+int i;
+
+q->mass = measured_mass;
+q->tol = tolerance;
+q->charge = charge;
+q->rules = 1;
+q->budget = search_budget;
+q->share = 1.0;
+memset(q->min, 0, sizeof(q->min));	/* the cache compares all NEL */
+memset(q->max, 0, sizeof(q->max));
+for (i = 0; i < nr_el; i++)
+	{
+	q->min[i] = el[i].min;
+	q->max[i] = el[i].max;
+	}
+}
+
+
+/* tests one composition the same way as the loop in do_calculations() */
+static void check_formula(SearchState *s)
+{
+Candidate cand;
+double mass;
+float rdb, lewis;
+
+long long t0 = 0;
+int rule;
+
+s->evaluated++;
+mass = calc_mass(s->cnt, s->q->charge);
+if ((mass < s->lo) || (mass > s->hi))
+	{
+	s->rejected[RULE_MASS]++;
+	return;
+	}
+if (s->timing)
+	t0 = clock_ns();
+rule = s->q->rules ? ratio_rule(s->cnt, true) : RULE_OK;
+if (rule == RULE_OK)
+	{
+	rdb = calc_rdb(s->cnt);
+	lewis = (float)(fmod(rdb, 1));
+	if (rdb < 0)
+		rule = RULE_RDB;
+	else if ((lewis == 0.5) || (lewis == -0.5))
+		rule = RULE_LEWIS;
+	}
+if (s->timing)
+	s->ns_filter += clock_ns() - t0;
+if (rule != RULE_OK)
+	{
+	s->rejected[rule]++;
+	return;
+	}
+
+memcpy(cand.cnt, s->cnt, sizeof(cand.cnt));
+cand.rdb = rdb;
+cand.lewis = lewis;
+cand.mass = mass;
+cand.error = 1000.0 * (s->q->mass - mass);
+s->hits->push_back(cand);
+}
+
+
+/* the part of the search space done, in the nesting: levels 0...k-1 at their current counts */
+static double covered_space(const SearchState *s, int k)
+{
+double f = 0.0, w = 1.0;
+int j, e;
+
+for (j = 0; j < k; j++)
+	{
+	e = s->order[j];
+	w /= s->q->max[e] - s->q->min[e] + 1;
+	f += (s->cnt[e] - s->q->min[e]) * w;
+	}
+return f;
+}
+
+
+/* every BUDGET_NODES nodes: deadline, max. formulas, cancel; progress.
+   Returns 1 if the search has to stop. */
+static int poll_budget(SearchState *s, int k)
+{
+SearchBudget *b = s->q->budget;
+long long now = clock_ns();
+
+if (b->cancel.load(memory_order_relaxed) || ((s->deadline > 0) && (now >= s->deadline))
+		|| ((s->max_evaluated > 0) && (s->evaluated >= s->max_evaluated)))
+	{
+	s->stop = 1;
+	s->covered = covered_space(s, k);
+	return 1;
+	}
+if ((b->progress != NULL) && (now >= s->next_progress))
+	{
+	b->progress(covered_space(s, k), s->evaluated, b->arg);
+	s->next_progress = now + PROGRESS_NS;
+	}
+return 0;
+}
+
+
+/* the counts of level k which can still reach the window with the remaining
+   levels at their min./max. counts; for the last level (H) this is the
+   closed form (lo - sum) / m(H) ... (hi - sum) / m(H). Returns 0 if none. */
+static inline int level_range(SearchState *s, int k, double sum, int *lo, int *hi)
+{
+const Query *q = s->q;
+int e = s->order[k];
+double m = el[e].mass;
+double c;
+
+if ((q->budget != NULL) && ((s->stop) || !(++s->nodes & (BUDGET_NODES - 1))))
+	if (s->stop || poll_budget(s, k))
+		return 0;
+c = ceil((s->slo - sum - s->restmax[k+1]) / m);
+*lo = (c > q->min[e]) ? (int)c : q->min[e];
+c = floor((s->shi - sum - s->restmin[k+1]) / m);
+*hi = (c < q->max[e]) ? (int)c : q->max[e];
+if (*hi < *lo)
+	{
+	s->pruned[e] += q->max[e] - q->min[e] + 1;
+	return 0;
+	}
+s->pruned[e] += (*lo - q->min[e]) + (q->max[e] - *hi);
+return 1;
+}
+
+
+/* one level of the search, any no. of levels */
+static void search_level(SearchState *s, int k, double sum)
+{
+int e = s->order[k];
+double m = el[e].mass;
+int n, lo, hi;
+
+if (!level_range(s, k, sum, &lo, &hi))
+	return;
+for (n = lo; n <= hi; n++)
+	{
+	s->cnt[e] = n;
+	if (k == s->nlev - 1)
+		check_formula(s);
+	else
+		search_level(s, k + 1, sum + n * m);
+	}
+s->cnt[e] = 0;
+}
+
+
+/* the same with the no. of levels L left known at compile time: the
+   compiler unrolls the nesting into one function (CHNO: 4 levels, CHNOPS: 6,
+   with F, Cl, Br: 9) */
+template <int L> static void search_unrolled(SearchState *s, int k, double sum)
+{
+int e = s->order[k];
+double m = el[e].mass;
+int n, lo, hi;
+
+if (!level_range(s, k, sum, &lo, &hi))
+	return;
+for (n = lo; n <= hi; n++)
+	{
+	s->cnt[e] = n;
+	search_unrolled<L - 1>(s, k + 1, sum + n * m);
+	}
+s->cnt[e] = 0;
+}
+
+template <> void search_unrolled<0>(SearchState *s, int k, double sum)
+{
+check_formula(s);
+}
+
+typedef void (*SearchKernel)(SearchState *s, int k, double sum);
+
+static const SearchKernel kernels[MAXUNROLL + 1] =	/* by no. of levels */
+{
+search_unrolled<0>, search_unrolled<1>, search_unrolled<2>, search_unrolled<3>,
+search_unrolled<4>, search_unrolled<5>, search_unrolled<6>, search_unrolled<7>,
+search_unrolled<8>, search_unrolled<9>,
+};
+
+
+/* --- labelled search ------------------------------------------------ */
+
+/* lexicographic in the nesting of do_calculations(), i.e. the order it finds them */
+static bool loop_order(const Candidate &a, const Candidate &b)
+{
+int i, e;
+
+for (i = 0; i < nr_el; i++)
+	{
+	e = search_order[i];
+	if (a.cnt[e] != b.cnt[e])
+		return a.cnt[e] < b.cnt[e];
+	}
+return false;
+}
+
+
+typedef struct	{
+		const Query *q;
+		double	lo, hi;			/* mass window of the ion */
+		double	shift[NLABELS];		/* label - natural element, ~1 Da */
+		double	restmin[NLABELS+1],	/* shift of labels k... at their min. counts */
+			restmax[NLABELS+1];	/* ... and at their max. counts */
+		vector<Candidate> *hits;
+		long long evaluated;
+		} LabelState;
+
+
+/* label counts k... of base formula c (labels 0, natural element = total);
+   'mass' is the base mass plus the shifts of the labels before k */
+static void expand_labels(LabelState *s, Candidate *c, int k, double mass)
+{
+const Query *q = s->q;
+int lab, nat, tot, n, from, to;
+double m;
+
+if (k == NLABELS)
+	{
+	s->evaluated++;
+	m = calc_mass(c->cnt, q->charge);	/* the same test as check_formula() */
+	if ((m < s->lo) || (m > s->hi))
+		return;
+	s->hits->push_back(*c);
+	s->hits->back().mass = m;
+	s->hits->back().error = 1000.0 * (q->mass - m);
+	return;
+	}
+lab = lab_el[k];
+nat = lab_nat[k];
+if (lab < 0)
+	{
+	expand_labels(s, c, k + 1, mass);
+	return;
+	}
+
+/* counts that keep the natural element in its range and can reach the window */
+tot = c->cnt[nat];
+from = max(q->min[lab], tot - q->max[nat]);
+to = min(q->max[lab], tot - q->min[nat]);
+m = ceil((s->lo - SEARCH_SLACK - mass - s->restmax[k+1]) / s->shift[k]);
+if (m > from)
+	from = (int)m;
+m = floor((s->hi + SEARCH_SLACK - mass - s->restmin[k+1]) / s->shift[k]);
+if (m < to)
+	to = (int)m;
+
+for (n = from; n <= to; n++)
+	{
+	c->cnt[lab] = n;
+	c->cnt[nat] = tot - n;
+	expand_labels(s, c, k + 1, mass + n * s->shift[k]);
+	}
+c->cnt[lab] = 0;
+c->cnt[nat] = tot;
+}
+
+
+/************************************************************************
+* SEARCH_LABELLED:	search_formulas() for queries with a range of 13C,	*
+*		15N or 2H (X, M, D): the formulas are searched once with	*
+*		each label counted as its element (the ratio rules and	*
+*		the RDB only see the sums), in a window widened by the	*
+*		label shifts; the label counts of each such base formula	*
+*		are then the few that are in the window and leave the	*
+*		natural element in its range. Instead of one search	*
+*		level per label, with the rules for every labelled	*
+*		formula. Same hits as do_calculations(), in its order.	*
+*************************************************************************/
+static long search_labelled(const Query *q, vector<Candidate> &hits, SearchStats *stats)
+{
+LabelState s;
+SearchStats bst;
+vector<Candidate> base;
+Query qb = *q;
+double blo, bhi;
+size_t j, first = hits.size();
+long long t0;
+int k, lab, nat;
+
+s.q = q;
+s.hits = &hits;
+s.evaluated = 0;
+s.lo = q->mass - (q->tol / 1000.0);
+s.hi = q->mass + (q->tol / 1000.0);
+blo = s.lo - SEARCH_SLACK;
+bhi = s.hi + SEARCH_SLACK;
+s.restmin[NLABELS] = s.restmax[NLABELS] = 0.0;
+for (k = NLABELS - 1; k >= 0; k--)
+	{
+	s.restmin[k] = s.restmin[k+1];
+	s.restmax[k] = s.restmax[k+1];
+	if ((lab = lab_el[k]) < 0)
+		continue;
+	nat = lab_nat[k];
+	s.shift[k] = el[lab].mass - el[nat].mass;
+	s.restmin[k] += q->min[lab] * s.shift[k];
+	s.restmax[k] += q->max[lab] * s.shift[k];
+	qb.min[nat] += q->min[lab];		/* base: natural + label */
+	qb.max[nat] += q->max[lab];
+	qb.min[lab] = qb.max[lab] = 0;
+	}
+blo -= s.restmax[0];
+bhi -= s.restmin[0];
+qb.mass = (blo + bhi) / 2.0;
+qb.tol = (bhi - blo) / 2.0 * 1000.0;
+
+search_formulas(&qb, base, (stats != NULL) ? &bst : NULL);
+t0 = clock_ns();
+for (j = 0; j < base.size(); j++)
+	expand_labels(&s, &base[j], 0, base[j].mass);
+stable_sort(hits.begin() + first, hits.end(), loop_order);
+
+if (stats != NULL)
+	{
+	*stats = bst;
+	stats->evaluated += s.evaluated;
+	stats->rejected[RULE_MASS] += s.evaluated - (hits.size() - first);
+	stats->hits = hits.size() - first;
+	stats->ns_enumerate += clock_ns() - t0;
+	}
+return hits.size() - first;
+}
+
+
+/************************************************************************
+* SEARCH_FORMULAS:	Same hits as do_calculations(), but the element	*
+*		ranges are cut down to what can still reach the mass	*
+*		window, level by level, so only compositions near the	*
+*		window are evaluated. Elements with a fixed count (0-0	*
+*		mostly) are no level of the search; up to MAXUNROLL	*
+*		levels, an unrolled kernel is used. With a range of a	*
+*		label, see search_labelled(). Uses only q and the	*
+*		constant part of el[], i.e. several queries can run in	*
+*		parallel.						*
+* Input: 	query, vector the hits are appended to, optional stats.	*
+* Returns. 	number of hits.	       				*
+*************************************************************************/
+long search_formulas(const Query *q, vector<Candidate> &hits, SearchStats *stats)
+{
+SearchState s;
+size_t first = hits.size();
+long long t0;
+double base;
+int i, k, e;
+
+for (k = 0; k < NLABELS; k++)
+	if ((lab_el[k] >= 0) && (q->min[lab_el[k]] < q->max[lab_el[k]]))
+		return search_labelled(q, hits, stats);
+
+memset(&s, 0, sizeof(s));
+s.q = q;
+s.hits = &hits;
+s.timing = (stats != NULL);
+t0 = clock_ns();
+if (q->budget != NULL)			/* this search's share of the limits */
+	{
+	if (q->budget->max_ns > 0)
+		s.deadline = t0 + (long long)(q->share * q->budget->max_ns) + 1;
+	if (q->budget->max_evaluated > 0)
+		s.max_evaluated = (long long)(q->share * q->budget->max_evaluated) + 1;
+	if (q->budget->cancel.load())
+		s.stop = 1;		/* cancelled before */
+	}
+s.next_progress = t0 + PROGRESS_NS;
+s.lo = q->mass - (q->tol / 1000.0);
+s.hi = q->mass + (q->tol / 1000.0);
+s.slo = s.lo + q->charge * electron - SEARCH_SLACK;
+s.shi = s.hi + q->charge * electron + SEARCH_SLACK;
+base = 0.0;
+for (i = 0; i < nr_el; i++)
+	{
+	e = search_order[i];
+	if (q->min[e] < q->max[e])
+		s.order[s.nlev++] = e;
+	else
+		{
+		s.cnt[e] = q->min[e];
+		base += q->min[e] * el[e].mass;
+		}
+	}
+s.restmin[s.nlev] = s.restmax[s.nlev] = 0.0;
+for (k = s.nlev - 1; k >= 0; k--)
+	{
+	e = s.order[k];
+	s.restmin[k] = s.restmin[k+1] + q->min[e] * el[e].mass;
+	s.restmax[k] = s.restmax[k+1] + q->max[e] * el[e].mass;
+	}
+
+for (e = 0; e < nr_el; e++)
+	if (q->min[e] > q->max[e])	/* empty range */
+		break;
+if ((e == nr_el) && (s.nlev <= MAXUNROLL))
+	kernels[s.nlev](&s, 0, base);
+else if (e == nr_el)
+	search_level(&s, 0, base);
+
+if (stats != NULL)
+	{
+	memset(stats, 0, sizeof(*stats));
+	stats->evaluated = s.evaluated;
+	stats->hits = hits.size() - first;
+	memcpy(stats->rejected, s.rejected, sizeof(s.rejected));
+	memcpy(stats->pruned, s.pruned, sizeof(s.pruned));
+	stats->ns_filter = s.ns_filter;
+	stats->ns_enumerate = clock_ns() - t0 - s.ns_filter;
+	stats->partial = s.stop;
+	stats->covered = s.stop ? s.covered : 1.0;
+	}
+if ((q->budget != NULL) && (q->budget->progress != NULL) && !s.stop)
+	q->budget->progress(1.0, s.evaluated, q->budget->arg);
+return hits.size() - first;
+}
+
+
+/************************************************************************
+* INIT_BUDGET:	Sets up the limits of each search of a budget: at most	*
+*		'ns' and 'evaluated' formulas (0 = no limit), not	*
+*		cancelled, no progress calls; set b->progress and	*
+*		b->arg for them (called about every 0.1 s with the part	*
+*		of the space done, from the searching thread).		*
+*************************************************************************/
+void init_budget(SearchBudget *b, long long ns, long long evaluated)
+{
+b->max_ns = ns;
+b->max_evaluated = evaluated;
+b->cancel = 0;
+b->progress = NULL;
+b->arg = NULL;
+}
+
+
+/************************************************************************
+* CANCEL_SEARCH:	Stops the searches of a budget, from any thread	*
+*		(or a signal handler); they return the hits found so	*
+*		far, stats->partial set.				*
+*************************************************************************/
+void cancel_search(SearchBudget *b)
+{
+b->cancel.store(1);
+}
+
+
+/* --- cost of a search, for scheduling (smbatch.cpp) --------------------- */
+
+#define COST_BINS	20000	/* Da, nominal: heavier windows are not counted */
+
+/************************************************************************
+* SEARCH_COST:	Estimated size of the search of a query: the no. of	*
+*		compositions of all levels but the innermost whose	*
+*		nominal mass lets the innermost one reach the window,	*
+*		i.e. about the formulas search_formulas() evaluates.	*
+*		Counted by a DP over nominal masses, each level a	*
+*		sliding sum over its range: O(levels * mass).		*
+* Input: 	query.							*
+* Returns. 	estimate, >= 1.						*
+*************************************************************************/
+double search_cost(const Query *q)
+{
+vector<double> cnt, next;
+double lo, hi, base, sum;
+int order[NEL], nlev, i, k, e, w, m, n, top, inner;
+
+lo = q->mass - (q->tol / 1000.0) + q->charge * electron;
+hi = q->mass + (q->tol / 1000.0) + q->charge * electron;
+base = 0.0;
+nlev = 0;
+for (i = 0; i < nr_el; i++)
+	{
+	e = search_order[i];
+	if (q->min[e] > q->max[e])
+		return 1.0;
+	if (q->min[e] < q->max[e])
+		order[nlev++] = e;
+	else
+		base += q->min[e] * el[e].mass;
+	}
+if (nlev < 2)
+	return 1.0 + ((nlev == 1) ? 1.0 : 0.0);
+inner = order[nlev - 1];
+top = (int)ceil(hi - base) + 1;		/* bins of the outer levels */
+if (top < 0)
+	return 1.0;
+top = min(top, COST_BINS);
+
+cnt.assign(top + 1, 0.0);
+next.resize(top + 1);
+cnt[0] = 1.0;
+for (k = 0; k < nlev - 1; k++)		/* next[m] = sum over c of cnt[m - c*w] */
+	{
+	e = order[k];
+	w = max(1, (int)floor(el[e].mass + 0.5));
+	n = q->max[e] - q->min[e] + 1;
+	for (m = 0; m <= top; m++)
+		{
+		next[m] = cnt[m] + ((m >= w) ? next[m - w] : 0.0);
+		if (m >= n * w)
+			next[m] -= cnt[m - n * w];
+		}
+	for (m = top; m >= 0; m--)	/* shift by the min. counts */
+		cnt[m] = (m >= q->min[e] * w) ? next[m - q->min[e] * w] : 0.0;
+	}
+
+sum = 0.0;
+w = max(1, (int)floor(el[inner].mass + 0.5));
+for (m = max(0, (int)floor(lo - base - q->max[inner] * el[inner].mass) - 1);
+		m <= min(top, (int)ceil(hi - base - q->min[inner] * el[inner].mass) + 1); m++)
+	sum += cnt[m];
+return 1.0 + max(sum, 0.0);
+}
+
+
+/************************************************************************
+* SPLIT_QUERY:	Splits the range of the outermost level of a search in	*
+*		halves; the hits of a, then b, are those of q, in the	*
+*		same order (all of a come first in search order).	*
+* Input: 	query, the halves are returned in a and b.		*
+* Returns. 	1 if split, 0 if there is one level or none.		*
+*************************************************************************/
+int split_query(const Query *q, Query *a, Query *b)
+{
+int i, e, mid, nlev;
+
+for (i = 0, nlev = 0, e = -1; i < nr_el; i++)
+	if (q->min[search_order[i]] < q->max[search_order[i]])
+		{
+		if (e < 0)
+			e = search_order[i];
+		nlev++;
+		}
+if (nlev < 2)
+	return 0;
+mid = q->min[e] + (q->max[e] - q->min[e]) / 2;
+*a = *q;
+*b = *q;
+a->max[e] = mid;
+b->min[e] = mid + 1;
+return 1;
+}
+
+
+/* --- fragments of a precursor (-f) -------------------------------------- */
+
+#define FRAGBYTES	(256.0 * 1048576)	/* default of frag_max_bytes */
+
+int     frag_mode;		/* -f: fragments are subformulas of frag_prec[] */
+int     frag_prec[NEL];		/* counts of the precursor ion */
+double  frag_max_bytes = FRAGBYTES;	/* max. size of the table of frag_open() */
+
+typedef struct	{
+		double	sum;		/* neutral mass, as calc_mass(cnt, 0) */
+		unsigned int at;	/* counts of the active elements at frag_cnt[at] */
+		int	ratio;		/* RULE_... of ratio_rule() */
+		} FragEntry;
+
+static vector<FragEntry> frag_tab;	/* sorted by sum */
+static vector<unsigned short> frag_cnt;
+static int frag_act[NEL], frag_nact;	/* elements of the precursor */
+
+static bool lighter(const FragEntry &a, const FragEntry &b)
+{
+return a.sum < b.sum;
+}
+
+
+/************************************************************************
+* PARSE_FORMULA:	"C6H13O6", "CH3COOH" (symbols of el[], repeats	*
+*		add up) into counts indexed like el[].			*
+* Returns. 	1 if OK, 0 if not a formula of el[].			*
+*************************************************************************/
+int parse_formula(const char *text, int *cnt)
+{
+char sym[4];
+int e, n, k;
+
+memset(cnt, 0, NEL * sizeof(int));
+if (*text == 0)
+	return 0;
+while (*text)
+	{
+	if (!isupper((unsigned char)*text))
+		return 0;
+	k = 0;
+	sym[k++] = *text++;
+	while (islower((unsigned char)*text) && (k < 3))
+		sym[k++] = *text++;
+	sym[k] = 0;
+	if ((e = el_index(sym)) < 0)
+		return 0;
+	for (n = 0; isdigit((unsigned char)*text); text++)
+		n = 10 * n + (*text - '0');
+	cnt[e] += (n > 0) ? n : 1;
+	}
+return 1;
+}
+
+
+/************************************************************************
+* FRAG_OPEN:	Fragment mode: the subformulas of a precursor that can	*
+*		be hits (RDB >= 0, no x.5) are put into one table,	*
+*		sorted by mass, which all fragment searches use; a	*
+*		fragment is then a binary search and a scan of its	*
+*		window.							*
+* Input: 	counts of the precursor ion, indexed like el[].		*
+* Returns. 	no. of table entries; 0 if the table could take more	*
+*		than frag_max_bytes (a FragEntry and a count of each	*
+*		element of the precursor per subformula), the		*
+*		fragments are then searched with search_formulas().	*
+*************************************************************************/
+long frag_open(const int *prec)
+{
+FragEntry f;
+int cnt[NEL];
+double box = 1.0;
+float rdb, lewis;
+int i, k;
+
+memcpy(frag_prec, prec, sizeof(frag_prec));
+frag_mode = 1;
+frag_tab.clear();
+frag_cnt.clear();
+frag_nact = 0;
+for (i = 0; i < nr_el; i++)
+	if (prec[i] > 0)
+		{
+		frag_act[frag_nact++] = i;
+		box *= prec[i] + 1;
+		}
+if ((box * (sizeof(FragEntry) + frag_nact * sizeof(unsigned short)) > frag_max_bytes)
+		|| (frag_nact == 0))
+	return 0;
+
+memset(cnt, 0, sizeof(cnt));
+for (;;)			/* all counts 0...prec[] */
+	{
+	rdb = calc_rdb(cnt);
+	lewis = (float)(fmod(rdb, 1));		/* as check_formula() */
+	if ((rdb >= 0) && (lewis != 0.5) && (lewis != -0.5))
+		{
+		f.sum = calc_mass(cnt, 0.0);
+		f.at = frag_cnt.size();
+		f.ratio = ratio_rule(cnt, true);
+		frag_tab.push_back(f);
+		for (k = 0; k < frag_nact; k++)
+			frag_cnt.push_back(cnt[frag_act[k]]);
+		}
+	for (k = 0; (k < frag_nact) && (cnt[frag_act[k]] == prec[frag_act[k]]); k++)
+		cnt[frag_act[k]] = 0;
+	if (k == frag_nact)
+		break;
+	cnt[frag_act[k]]++;
+	}
+stable_sort(frag_tab.begin(), frag_tab.end(), lighter);
+return frag_tab.size();
+}
+
+
+/************************************************************************
+* FRAG_SEARCH:	search_formulas() for a fragment: the same hits, in	*
+*		the same order, but only subformulas of the precursor	*
+*		(within the ranges of q, too) from the table of		*
+*		frag_open().						*
+* Input: 	query, vector the hits are appended to, optional stats.	*
+* Returns. 	number of hits.	       				*
+*************************************************************************/
+long frag_search(const Query *q, vector<Candidate> &hits, SearchStats *stats)
+{
+vector<FragEntry>::const_iterator it;
+FragEntry key;
+Candidate c;
+double lo, hi, mass;
+size_t first = hits.size();
+long long t0, evaluated = 0, rejected[NRULES];
+int i, e;
+
+if (frag_tab.empty())		/* too many subformulas, or none */
+	{
+	Query qf = *q;
+
+	for (i = 0; i < nr_el; i++)
+		qf.max[i] = min(qf.max[i], frag_prec[i]);
+	return search_formulas(&qf, hits, stats);
+	}
+
+t0 = clock_ns();
+memset(rejected, 0, sizeof(rejected));
+memset(&c, 0, sizeof(c));
+lo = q->mass - (q->tol / 1000.0);	/* as search_formulas() */
+hi = q->mass + (q->tol / 1000.0);
+key.sum = lo + q->charge * electron - SEARCH_SLACK;
+it = lower_bound(frag_tab.begin(), frag_tab.end(), key, lighter);
+for (e = 0; e < nr_el; e++)	/* not in the precursor: 0 in every entry */
+	if ((frag_prec[e] <= 0) && (q->min[e] > 0))
+		it = frag_tab.end();	/* below the range, no hits */
+for (; (it != frag_tab.end()) && (it->sum <= hi + q->charge * electron + SEARCH_SLACK); ++it)
+	{
+	for (i = 0; i < frag_nact; i++)
+		{
+		e = frag_act[i];
+		c.cnt[e] = frag_cnt[it->at + i];
+		if ((c.cnt[e] < q->min[e]) || (c.cnt[e] > q->max[e]))
+			break;
+		}
+	if (i < frag_nact)
+		continue;
+	evaluated++;
+	mass = calc_mass(c.cnt, q->charge);
+	if ((mass < lo) || (mass > hi))
+		{
+		rejected[RULE_MASS]++;
+		continue;
+		}
+	if (q->rules && (it->ratio != RULE_OK))
+		{
+		rejected[it->ratio]++;
+		continue;
+		}
+	c.rdb = calc_rdb(c.cnt);
+	c.lewis = (float)(fmod(c.rdb, 1));
+	c.mass = mass;
+	c.error = 1000.0 * (q->mass - mass);
+	hits.push_back(c);
+	}
+stable_sort(hits.begin() + first, hits.end(), loop_order);
+
+if (stats != NULL)
+	{
+	memset(stats, 0, sizeof(*stats));
+	stats->evaluated = evaluated;
+	stats->hits = hits.size() - first;
+	memcpy(stats->rejected, rejected, sizeof(rejected));
+	stats->ns_enumerate = clock_ns() - t0;
+	}
+return hits.size() - first;
+}
+
+
+/* the precursor minus a fragment, "-" if nothing is lost */
+string neutral_loss(const Candidate &c)
+{
+ostringstream loss;
+int i;
+
+for (i = 0; i < nr_el; i++)
+	if (frag_prec[i] > c.cnt[i])
+		loss << el[i].sym << frag_prec[i] - c.cnt[i];
+return loss.str().empty() ? "-" : loss.str();
+}
+
+
+/* --- homologous series (-s) ------------------------------------------ */
+
+typedef struct	{			/* a query of series_search(), for grouping */
+		size_t	j;		/* index in qs[] */
+		long	nominal;	/* Kendrick mass, rounded */
+		double	kmd;		/* Kendrick mass defect */
+		} SeriesMember;
+
+/* by charge and rules, residue of the nominal Kendrick mass, defect;
+   the queries and the nominal mass of the unit are passed along, not kept in statics */
+struct SeriesOrder	{
+		const vector<Query> *qs;
+		long	nominal;	/* of the repeat unit */
+
+		SeriesOrder(const vector<Query> *q, long n) : qs(q), nominal(n) {}
+		bool operator()(const SeriesMember &a, const SeriesMember &b) const
+		{
+		const Query &qa = (*qs)[a.j], &qb = (*qs)[b.j];
+
+		if (qa.charge != qb.charge)
+			return qa.charge < qb.charge;
+		if (qa.rules != qb.rules)
+			return qa.rules < qb.rules;
+		if (a.nominal % nominal != b.nominal % nominal)
+			return a.nominal % nominal < b.nominal % nominal;
+		if (a.kmd != b.kmd)
+			return a.kmd < b.kmd;
+		return a.nominal < b.nominal;
+		}
+		};
+
+
+static bool lighter_member(const SeriesMember &a, const SeriesMember &b)
+{
+return a.nominal < b.nominal;
+}
+
+
+/* one series: members[0...n-1], the lightest first; nominal: of the unit */
+static void search_series(const vector<Query> &qs, const int *unit, long nominal,
+		const SeriesMember *members, int n, vector< vector<Candidate> > &hits, SearchStats *stats)
+{
+vector<Candidate> base;
+vector<long> k(n);
+Query a;
+Candidate c;
+double umass, lo, hi, mass;
+size_t b;
+int j, e, rule;
+long long evaluated;
+
+umass = calc_mass(unit, 0.0);
+a = qs[members[0].j];
+lo = 1e300;
+hi = -1e300;
+for (j = 0; j < n; j++)		/* the ranges and windows of all, shifted to the lightest */
+	{
+	const Query &q = qs[members[j].j];
+
+	k[j] = (members[j].nominal - members[0].nominal) / nominal;
+	for (e = 0; e < nr_el; e++)
+		{
+		a.min[e] = min(a.min[e], (int)(q.min[e] - k[j] * unit[e]));
+		a.max[e] = max(a.max[e], (int)(q.max[e] - k[j] * unit[e]));
+		}
+	lo = min(lo, q.mass - (q.tol / 1000.0) - k[j] * umass);
+	hi = max(hi, q.mass + (q.tol / 1000.0) - k[j] * umass);
+	}
+lo -= SEARCH_SLACK;
+hi += SEARCH_SLACK;
+a.mass = (lo + hi) / 2.0;
+a.tol = (hi - lo) / 2.0 * 1000.0;
+a.rules = 0;			/* checked on the member formulas */
+search_formulas(&a, base, (stats != NULL) ? &stats[members[0].j] : NULL);
+
+for (j = 0; j < n; j++)		/* each member: base + k units, checked like check_formula() */
+	{
+	const Query &q = qs[members[j].j];
+	vector<Candidate> &h = hits[members[j].j];
+
+	evaluated = 0;
+	lo = q.mass - (q.tol / 1000.0);
+	hi = q.mass + (q.tol / 1000.0);
+	for (b = 0; b < base.size(); b++)
+		{
+		c = base[b];
+		for (e = 0; e < nr_el; e++)
+			{
+			c.cnt[e] += k[j] * unit[e];
+			if ((c.cnt[e] < q.min[e]) || (c.cnt[e] > q.max[e]))
+				break;
+			}
+		if (e < nr_el)
+			continue;
+		evaluated++;
+		mass = calc_mass(c.cnt, q.charge);
+		if ((mass < lo) || (mass > hi))
+			continue;
+		rule = q.rules ? ratio_rule(c.cnt, true) : RULE_OK;
+		if (rule != RULE_OK)
+			{
+			if (stats != NULL)
+				stats[members[j].j].rejected[rule]++;
+			continue;
+			}
+		c.rdb = calc_rdb(c.cnt);	/* the unit doesn't change it */
+		c.lewis = (float)(fmod(c.rdb, 1));
+		c.mass = mass;
+		c.error = 1000.0 * (q.mass - mass);
+		h.push_back(c);
+		}
+	stable_sort(h.begin(), h.end(), loop_order);
+	if (stats != NULL)
+		{
+		if (j > 0)
+			memset(&stats[members[j].j], 0, sizeof(SearchStats));
+		stats[members[j].j].hits = h.size();
+		if (j > 0)
+			stats[members[j].j].evaluated = evaluated;
+		}
+	}
+}
+
+
+/************************************************************************
+* SERIES_SEARCH:	search_formulas() for a batch of queries, the	*
+*		members of homologous series searched together: the	*
+*		queries are grouped by Kendrick mass defect for the	*
+*		repeat unit (and the nominal Kendrick mass modulo that	*
+*		of the unit); one search covers the windows and ranges	*
+*		of all members of a series, shifted by k units to the	*
+*		lightest (counts may get negative there), and each	*
+*		member gets the formulas + k units that are within its	*
+*		ranges, window and ratio rules. The unit must not	*
+*		change the RDB (CH2, C2H4O, CF2, ...), then these are	*
+*		exactly the hits of search_formulas(), in its order.	*
+* Input: 	queries, counts of the unit, hits[j] for qs[j] (in-	*
+*		and output, hits are appended), optional stats[j].	*
+* Returns. 	no. of searches done, 0 if the unit changes the RDB.	*
+*************************************************************************/
+long series_search(const vector<Query> &qs, const int *unit, vector< vector<Candidate> > &hits,
+		SearchStats *stats)
+{
+vector<SeriesMember> m(qs.size());
+double umass;
+size_t j, first;
+int e, dbe = 0;
+long nominal, searches = 0;
+
+for (e = 0; e < nr_el; e++)
+	dbe += (int)el[e].val * unit[e];
+umass = calc_mass(unit, 0.0);
+nominal = (long)floor(umass + 0.5);
+if ((dbe != 0) || (nominal < 1))
+	return 0;
+hits.resize(qs.size());
+
+for (j = 0; j < qs.size(); j++)	/* Kendrick mass: the unit weighs its nominal mass */
+	{
+	double km = qs[j].mass * nominal / umass;
+
+	m[j].j = j;
+	m[j].nominal = (long)floor(km + 0.5);
+	m[j].kmd = m[j].nominal - km;
+	}
+sort(m.begin(), m.end(), SeriesOrder(&qs, nominal));
+
+/* a series: same charge, rules, residue; defects within the tolerance */
+for (first = 0; first < m.size(); first = j)
+	{
+	for (j = first + 1; j < m.size(); j++)
+		if ((qs[m[j].j].charge != qs[m[first].j].charge) || (qs[m[j].j].rules != qs[m[first].j].rules)
+				|| (m[j].nominal % nominal != m[first].nominal % nominal)
+				|| (m[j].kmd - m[first].kmd > qs[m[first].j].tol / 1000.0))
+			break;
+	sort(m.begin() + first, m.begin() + j, lighter_member);
+	search_series(qs, unit, nominal, &m[first], j - first, hits, stats);
+	searches++;
+	}
+return searches;
+}
+
+
+/************************************************************************
+* SPLIT_TIERS:	Superset tolerances (-T): the search was done once at	*
+*		the widest tolerance; the hits are sorted by absolute	*
+*		error, so the hits within any tighter tolerance are a	*
+*		prefix of the list, and each gets the index of the	*
+*		smallest tolerance it is within.			*
+* Input: 	hits, measured mass, optional stats for the prefix	*
+*		lengths.						*
+*************************************************************************/
+void split_tiers(vector<Candidate> &hits, double measured_mass, SearchStats *stats)
+{
+size_t j;
+int t;
+
+stable_sort(hits.begin(), hits.end(), smaller_error);
+for (j = 0, t = 0; j < hits.size(); j++)
+	{
+	while ((t < ntiers - 1) && (fabs(hits[j].error) > tiers_ppm[t] * 1e-3 * measured_mass))
+		{
+		if (stats != NULL)
+			stats->tier_hits[t] = j;
+		t++;
+		}
+	hits[j].tier = t;
+	}
+if (stats != NULL)
+	{
+	for (; t < ntiers; t++)
+		stats->tier_hits[t] = hits.size();
+	stats->ntiers = ntiers;
+	}
+}
+
+
+/************************************************************************
+* FILTER_RATIOS:	The element ratio checks on hits searched with	*
+*		rules = 0, as a separate step: drops the hits that	*
+*		search_formulas() with rules = 1 would not have found.	*
+* Input: 	hits, optional stats (rejected[], ns_filter are added to).	*
+* Returns. 	number of hits kept.	       				*
+*************************************************************************/
+long filter_ratios(vector<Candidate> &hits, SearchStats *stats)
+{
+size_t j, kept = 0;
+long long t0;
+int rule;
+
+t0 = clock_ns();
+for (j = 0; j < hits.size(); j++)
+	{
+	rule = ratio_rule(hits[j].cnt, true);
+	if (rule == RULE_OK)
+		hits[kept++] = hits[j];
+	else if (stats != NULL)
+		stats->rejected[rule]++;
+	}
+hits.resize(kept);
+if (stats != NULL)
+	{
+	stats->hits = kept;
+	stats->ns_filter += clock_ns() - t0;
+	}
+return kept;
+}
+
+
+/************************************************************************
+* RANK_HITS:	Puts the hits in the order calculate() prints them:	*
+*		isotope scoring (-i, best first) or the tolerances (-T,	*
+*		by error; it takes precedence, main() rejects both),	*
+*		else as found.						*
+* Input: 	query, hits, optional stats.				*
+*************************************************************************/
+void rank_hits(const Query *q, vector<Candidate> &hits, SearchStats *stats)
+{
+size_t j;
+long long t0;
+
+t0 = clock_ns();
+if (niso_meas > 0)
+	{
+	if (iso_keep > 0)
+		preselect_candidates(hits);
+	for (j = 0; j < hits.size(); j++)
+		{
+		calc_isotopes(&hits[j]);
+		hits[j].score = score_isotopes(&hits[j]);
+		}
+	}
+if (ntiers > 0)
+	split_tiers(hits, q->mass, stats);
+else if (niso_meas > 0)
+	sort(hits.begin(), hits.end(), better_candidate);
+if (stats != NULL)
+	stats->ns_score = clock_ns() - t0;
+}
+
+
+/************************************************************************
+* SEARCH_HITS:	The hits of a query before ranking: cached_search(),	*
+*		frag_search() with -f, suspect_search() with --suspects.	*
+* Input: 	query, vector the hits are appended to, optional stats.	*
+* Returns. 	number of hits.	       				*
+*************************************************************************/
+long search_hits(const Query *q, vector<Candidate> &hits, SearchStats *stats)
+{
+if (suspect_mode)
+	return suspect_search(q, hits, stats);
+return frag_mode ? frag_search(q, hits, stats) : cached_search(q, hits, stats);
+}
+
+
+/************************************************************************
+* SEARCH_RANKED:	The hits of a query in the order calculate() prints	*
+*		them: search_hits(), then rank_hits(). Uses only q and	*
+*		the settings, so it can run in several threads.		*
+* Input: 	query, vector the hits are appended to, optional stats.	*
+* Returns. 	number of hits.	       				*
+*************************************************************************/
+long search_ranked(const Query *q, vector<Candidate> &hits, SearchStats *stats)
+{
+long n;
+
+n = search_hits(q, hits, stats);
+rank_hits(q, hits, stats);
+return n;
+}
+
+
+/************************************************************************
+* CALCULATE:	Runs a query from el[] and the globals with the engine	*
+*		selected in 'engine' and prints the hits like		*
+*		do_calculations().					*
+* Input: 	measured mass (in amu), tolerance (in mmu), optional stats.	*
+* Returns. 	number of hits.	       				*
+*************************************************************************/
+long calculate(double measured_mass, double tolerance, SearchStats *stats)
+{
+vector<Candidate> hits;
+Query q;
+long n;
+int i;
+long long t1;
+
+make_query(&q, measured_mass, tolerance);
+if (auto_bounds)
+	adapt_bounds(&q);
+isotope_bounds(&q);
+
+if ((engine == ENGINE_LEGACY) && !suspect_mode)
+	{
+	if (!auto_bounds && (iso_keep <= 0))
+		return do_calculations(measured_mass, tolerance, stats);
+	for (i = 0; i < nr_el; i++)		/* the loop takes el[].min/max */
+		{
+		swap(el[i].min, q.min[i]);
+		swap(el[i].max, q.max[i]);
+		}
+	n = do_calculations(measured_mass, tolerance, stats);
+	for (i = 0; i < nr_el; i++)
+		{
+		swap(el[i].min, q.min[i]);
+		swap(el[i].max, q.max[i]);
+		}
+	return n;
+	}
+
+printf("\n");
+print_header();
+n = search_ranked(&q, hits, stats);
+t1 = clock_ns();
+print_hits(hits);
+fflush(stdout);
+if (stats != NULL)
+	stats->ns_output = clock_ns() - t1;
+return n;
+}
@@ -0,0 +1,251 @@
+/*
+
+SMFORMULA.H
+
+ Calculation engine of smformula_stdout.cpp (element table, mass, RDB,
+ element ratio checks, the calculation loop and the isotope scoring),
+ so that other programs such as the benchmark (smbench.cpp) can run
+ queries in-process; the result cache is in smcache.cpp, the peak list
+ readers in smpeaks.cpp, the mass-difference network in smnetwork.cpp,
+ the suspect screening in smsuspect.cpp, the batch scheduler in
+ smbatch.cpp, its worker processes in smworkers.cpp.
+ See smformula_stdout.cpp for history and license.
+
+*/
+
+#ifndef SMFORMULA_H
+#define SMFORMULA_H
+
+#include <stdio.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include "smisotope.h"
+
+#define MAXLEN  181          /* max. length of input string */
+#define NEL	24		/* max. no. of elements in el[], nr_el are used */
+#define MAXISO	4		/* M0, M+1, M+2, M+3 */
+#define MAXTIERS 8		/* tolerances of one superset search (-T) */
+
+typedef struct 	{
+		const char *sym;	/* symbol */
+		double	mass;		/* accurate mass */
+		float	val;		/* to calculate unsaturations */
+		int	key;		/* used for decoding cmd line */
+		int min,		/* atom count min */
+		    max,		/* atom count max */
+		    cnt,		/* atom count actual */
+		    save;		/* atom count old  - for loop exiting*/
+		} Element;
+
+typedef struct	{
+		int	cnt[NEL];	/* composition */
+		float	rdb, lewis;
+		double	mass;
+		double	error;		/* mass error in mmu */
+		float	iso[MAXISO];	/* calculated M0...M+3, relative to M0 = 1 */
+		double	score;		/* deviation from iso_meas[] */
+		int	tier;		/* -T: index of the smallest tolerance holding it */
+		long	ref;		/* suspect_search(): its adduct ion, see suspect_label() */
+		} Candidate;
+
+/* rules a formula can fail, for SearchStats.rejected[] */
+#define RULE_OK		0
+#define RULE_MASS	1	/* outside the mass window */
+#define RULE_HC		2	/* H/C ratio */
+#define RULE_NC		3	/* N/C ratio */
+#define RULE_OC		4	/* O/C ratio */
+#define RULE_PC		5	/* P/C ratio */
+#define RULE_SC		6	/* S/C ratio */
+#define RULE_NOPS	7	/* N, O, P, S counts together */
+#define RULE_NOP	8	/* N, O, P counts together */
+#define RULE_OPS	9	/* O, P, S counts together */
+#define RULE_PSN	10	/* P, S, N counts together */
+#define RULE_NOS	11	/* N, O, S counts together */
+#define RULE_RDB	12	/* RDB < 0 */
+#define RULE_LEWIS	13	/* odd electron ion (RDB x.5) */
+#define NRULES		14
+
+typedef struct	{			/* filled in by do_calculations() / search_formulas() */
+		long long evaluated;	/* formulas evaluated */
+		long long hits;		/* formulas printed */
+		long long rejected[NRULES];	/* evaluated formulas rejected, by RULE_... */
+		long long pruned[NEL];	/* counts of el[i] skipped with their subtree (fast engine) */
+		long long ns_enumerate;	/* wall time in ns: enumeration, */
+		long long ns_filter;	/* rules on the formulas within the mass window, */
+		long long ns_score;	/* isotope scoring (-i), */
+		long long ns_output;	/* printing the hits */
+		int	ntiers;		/* -T: no. of tolerances, */
+		long long tier_hits[MAXTIERS];	/* hits within each, i.e. prefix lengths */
+		int	cached;		/* 1 = answered from the result cache */
+		long long cache_lookups;	/* result cache so far, 0 = no cache */
+		long long cache_hits;
+		int	partial;	/* 1 = stopped by its budget, the hits found so far */
+		double	covered;	/* part of the search space done, 1 = all */
+		} SearchStats;
+
+typedef struct	{			/* limits of each search, Query.budget */
+		long long max_ns;	/* time, 0 = no limit */
+		long long max_evaluated;	/* formulas, 0 = no limit */
+		std::atomic<int> cancel;	/* set from any thread: stop (cancel_search()) */
+		void	(*progress)(double covered, long long evaluated, void *arg);	/* NULL = none */
+		void	*arg;
+		} SearchBudget;
+
+typedef struct	{			/* one search, for search_formulas() */
+		double	mass;		/* measured mass */
+		double	tol;		/* tolerance in mmu */
+		double	charge;
+		int	min[NEL],	/* atom count ranges, indexed like el[] */
+			max[NEL];
+		int	rules;		/* 1 = element ratio checks (as do_calculations()), 0 = off */
+		SearchBudget *budget;	/* search_formulas() stops at its limits, NULL = none */
+		double	share;		/* of the budget: 1, less for the parts of a split query */
+		} Query;
+
+typedef struct	{			/* a query of a batch or a part of one, smbatch.cpp */
+		size_t	query;		/* index in the batch */
+		double	cost;		/* search_cost() */
+		Query	q;
+		std::vector<Candidate> hits;
+		SearchStats st;
+		} QueryPart;
+
+typedef struct	{			/* adduct ion of nmol molecules M */
+		const char *name;	/* "[M+H]+", as in formulae/data.py */
+		int	nmol;		/* no. of M */
+		int	z;		/* charge */
+		double	delta;		/* mass of the atoms added (negative: removed), w/o electrons */
+		} Adduct;
+
+typedef struct	{			/* one peak of a peak list, see smpeaks.cpp */
+		long	scan;		/* scan no. of the spectrum, else its no. from 1 */
+		int	peak;		/* no. of the peak in the spectrum, from 1 */
+		int	level;		/* MS level, 0 = unknown */
+		double	rt;		/* retention time in s, -1 = unknown */
+		double	mz, intensity;
+		char	title[MAXLEN];	/* of the spectrum (MGF TITLE, mzML id), may be "" */
+		} Peak;
+
+#define PEAKS_TEXT	0	/* "comment mass" lines, readfile() of smformula_stdout.cpp */
+#define PEAKS_MGF	1	/* Mascot generic format */
+#define PEAKS_MZML	2	/* mzML, centroided */
+#define PEAKS_CSV	3	/* columns mz, intensity, rt ... (also ';' or tab) */
+
+typedef struct PeakReader PeakReader;	/* open peak list, smpeaks.cpp */
+
+typedef struct	{			/* an edge of the mass-difference network, smnetwork.cpp */
+		size_t	a, b;		/* peaks, mass a < mass b */
+		size_t	entry;		/* formula of the difference, see net_formula() */
+		double	error;		/* measured - formula, mmu */
+		} NetEdge;
+
+#define ENGINE_LEGACY	0	/* do_calculations(), the reference */
+#define ENGINE_FAST	1	/* search_formulas() */
+
+#define CACHE_ENTRIES	1024	/* default size of the result cache (smcache.cpp) */
+#define CACHE_QUANTUM	1.0	/* default grid of its mass windows, mmu */
+
+extern Element el[NEL];
+extern const double electron;
+
+extern double  charge,		/* charge on the molecule */
+               tol;		/* mass tolerance in mmu */
+extern char    comment[MAXLEN];	/* some text ;-) */
+extern int     nr_el;		/* number of elements in array el[] */
+extern int     el_builtin;	/* 1 = el[] compiled in, 0 = load_elements() */
+
+extern int     niso_meas;	/* no. of measured isotope peaks, 0 = no scoring */
+extern double  iso_meas[MAXISO];	/* measured intensities, relative to M0 = 1 */
+extern double  iso_keep;	/* -k: max. deviation of the closed-form M+1/M+2, 0 = off */
+extern int     ntiers;		/* -T: no. of tolerances, 0 = off */
+extern double  tiers_ppm[MAXTIERS];	/* ascending, in ppm */
+extern int     frag_mode;	/* -f: fragments of frag_prec[], frag_search() */
+extern int     frag_prec[NEL];
+extern double  frag_max_bytes;	/* frag_open(): max. size of the table, else no table */
+extern int     suspect_mode;	/* --suspects: suspect_search() */
+extern int     auto_bounds;	/* -b: adapt_bounds() in calculate() */
+extern int     engine;		/* ENGINE_..., used by calculate() */
+extern double  batch_min_share;	/* split_batch(): cost of the smallest parts */
+extern SearchBudget *search_budget;	/* budget of the queries of make_query(), NULL = none */
+extern const char *rule_names[NRULES];
+extern const Adduct adducts[];
+extern const int nr_adducts;
+
+void    init_elements(void);
+int     load_elements(const char *file);
+int     el_index(const char *sym);
+double  calc_mass(void);
+double  calc_mass(const int *cnt, double z);
+float   calc_rdb(void);
+float   calc_rdb(const int *cnt);
+long    do_calculations(double mass, double tolerance, SearchStats *stats = NULL,
+		std::vector<Candidate> *hits = NULL);
+void    adapt_bounds(Query *q);
+void    isotope_bounds(Query *q);
+void    make_query(Query *q, double mass, double tolerance);
+long    search_formulas(const Query *q, std::vector<Candidate> &hits, SearchStats *stats = NULL);
+void    init_budget(SearchBudget *b, long long ns, long long evaluated);
+void    cancel_search(SearchBudget *b);
+long    series_search(const std::vector<Query> &qs, const int *unit,
+		std::vector< std::vector<Candidate> > &hits, SearchStats *stats = NULL);
+double  search_cost(const Query *q);
+int     split_query(const Query *q, Query *a, Query *b);
+void    split_batch(const std::vector<Query> &qs, int nparallel, std::vector<QueryPart> &parts,
+		std::vector<size_t> &first);
+void    join_parts(const Query *q, std::vector<QueryPart> &parts, size_t from, size_t to,
+		std::vector<Candidate> &hits, SearchStats *stats);
+long    batch_search(const std::vector<Query> &qs, std::vector< std::vector<Candidate> > &hits,
+		SearchStats *stats, int nthreads, long *tasks = NULL);
+long    fork_search(const std::vector<Query> &qs, std::vector< std::vector<Candidate> > &hits,
+		SearchStats *stats, int nworkers, int pin, long *nparts = NULL);
+int     parse_formula(const char *text, int *cnt);
+long    frag_open(const int *prec);
+long    frag_search(const Query *q, std::vector<Candidate> &hits, SearchStats *stats = NULL);
+std::string neutral_loss(const Candidate &c);
+long    filter_ratios(std::vector<Candidate> &hits, SearchStats *stats = NULL);
+void    rank_hits(const Query *q, std::vector<Candidate> &hits, SearchStats *stats = NULL);
+long    search_hits(const Query *q, std::vector<Candidate> &hits, SearchStats *stats = NULL);
+long    search_ranked(const Query *q, std::vector<Candidate> &hits, SearchStats *stats = NULL);
+long    calculate(double mass, double tolerance, SearchStats *stats = NULL);
+long    cache_open(size_t entries, double quantum, const char *file);
+int     cache_close(void);
+long    cached_search(const Query *q, std::vector<Candidate> &hits, SearchStats *stats = NULL);
+int     peak_format(const char *file);
+PeakReader *open_peaks(const char *file, int format);
+int     next_peak(PeakReader *r, Peak *p);
+const char *peaks_error(const PeakReader *r);
+void    close_peaks(PeakReader *r);
+long    net_open(double maxdiff, double maxdecomp);
+long    net_edges(const std::vector<double> &mass, double tolerance, std::vector<NetEdge> &edges);
+std::string net_formula(const NetEdge &e);
+const char *net_name(const NetEdge &e);
+double  net_mass(const NetEdge &e);
+long    suspect_open(const char *list, const char *store, const Adduct *adduct, long *skipped);
+void    suspect_close(void);
+long    suspect_search(const Query *q, std::vector<Candidate> &hits, SearchStats *stats = NULL);
+std::string suspect_label(const Candidate &c);
+const Adduct *find_adduct(const char *name);
+double  adduct_mz(const Adduct *a, double mass);
+double  adduct_neutral(const Adduct *a, double mz);
+//you have to compile with C++ or define yourself this bool type (C99 compiler definition)
+bool    calc_element_ratios(bool element_probability);
+bool    calc_element_ratios(const int *cnt, bool element_probability);
+int     ratio_rule(bool element_probability);
+int     ratio_rule(const int *cnt, bool element_probability);
+long long clock_ns(void);
+void    print_stats(FILE *f, const SearchStats *st, double mass, double tolerance);
+int     parse_isotopes(char *text);
+int     parse_tiers(char *text);
+int     calc_isotopes(Candidate *cand);
+double  score_isotopes(const Candidate *cand);
+bool    better_candidate(const Candidate &a, const Candidate &b);
+void    preselect_candidates(std::vector<Candidate> &cands);
+void    split_tiers(std::vector<Candidate> &hits, double measured_mass, SearchStats *stats);
+std::string hit_header(void);
+std::string hit_line(const Candidate &c);
+void    print_header(void);
+void    print_hits(const std::vector<Candidate> &cands);
+void    print_candidates(std::vector<Candidate> &cands);
+
+#endif
@@ -52,10 +52,40 @@ SMFORMULA.CPP, based on
 			2013-10-17, accurate masses for elements revised (NIST,2013), as well as CNOPS/ element ratios (RW)
 			2014-02-21, heavy isotope names changed to 1-letter code: 13C->X, 15N->M
 			2017-09-04, revision of formula generation with 2H
+			2026-10-19, in-process isotope scoring and ranking of the hits (-i)
+			2026-10-19, closed-form M+1/M+2 preselection before the exact pattern (-k)
+			2026-10-19, pruned search engine (-e fast), checked against the loop by smdiff
+			2026-10-19, --stats: JSON record per query (timings, rejections, pruning)
+			2026-10-19, adduct ions (-a), the neutral molecule is searched
+			2026-10-19, result cache (--cache, --cache-file) for repeated masses
+			2026-10-19, superset tolerances (-T), one search for several ppm
+			2026-10-19, element maxima adapted to the mass (-b)
+			2026-10-19, element table from a file (-E), unrolled search kernels
+			2026-10-19, 13C/15N/2H ranges expanded from the unlabelled hits
+			2026-10-19, MGF, mzML and CSV peak lists on a pool of threads (-j)
+			2026-10-19, peak lists in a pipeline of stages with lock-free rings
+			2026-10-19, MS/MS fragments as subformulas of a precursor (-f)
+			2026-10-19, mass-difference network of a peak list (-d)
+			2026-10-19, homologous series of a peak list searched together (-s)
+			2026-10-19, suspect screening against a formula list (--suspects)
+			2026-10-19, element ranges narrowed by the isotope pattern (-k)
+			2026-10-19, text files on a pool of threads, longest searches first (-j)
+			2026-10-19, worker processes for a batch or one large query (-w)
+			2026-10-19, time/formula budget per search, progress, Ctrl-C (--budget)
  This is ANSI C and should compile with any C compiler; use
  something along the lines of "gcc -Wall -O3 -o hr hr.c".
  Optimize for speed, you may gain factor 3!
  NOW compiled under Visual C++ Express (faster than GCC) in C++ mode for boolean type.
+ The calculation itself is in smformula.cpp, the isotope scoring (-i)
+ links the isotope library of smisotope; "make" builds everything:
+   gcc -O3 -c smisotope_lib.c
+   g++ -O3 -o hr smformula_stdout.cpp smformula.cpp smisotope_lib.o -lpthread
+ A file named *.mgf, *.mzML or *.csv is a peak list (smpeaks.cpp): its
+ peaks are read as a stream and searched by a pipeline of threads (-j,
+ with -e fast), the hits tagged with scan, peak, MS level, retention
+ time, m/z and intensity, in the order of the file.
+ "make bench" runs the benchmark (smbench.cpp) of the queries below,
+ "make check" compares the engines (smdiff.cpp) on random queries.
 
 
  ---------------------------------------------------------------------
@@ -66,6 +96,8 @@ SMFORMULA.CPP, based on
 	945 formulas found in    253 seconds. (now 4 seconds, before eternal)
  4) hr2 -m 459.982882 -t 1.37995 -C 10-39 -H 28-98 -N 4-34 -O 0-30 -P 1-12 -S 1-12 -F 0-12 -L 1-14 -B 2-6 -I 0-0
 	1 formula in 0 seconds (former eternal time)
+ 5) hr -m 180.0634 -t 5 -C 0-20 -H 0-40 -N 0-5 -O 0-10 -i 100,6.9,1.4,0.1
+	hits ranked by their isotope pattern, glucose (C6H12O6) first
  */
 
 #include <stdio.h>
@@ -77,73 +109,74 @@ SMFORMULA.CPP, based on
 #include <math.h>
 #include <fstream>
 #include <unistd.h>
+#include <signal.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <atomic>
 #include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "smformula.h"
 using namespace std; //RW
 
 #define VERSION "20170904"	/* String ! */
 #define TRUE 	1
 #define FALSE 	0
-#define MAXLEN  181          /* max. length of input string */
 
 #define _CRT_SECURE_NO_DEPRECATE 1
 
-typedef struct 	{
-		const char *sym;	/* symbol */
-		const double mass;	/* accurate mass */
-		const float val;	/* to calculate unsaturations */
-		const int key;		/* used for decoding cmd line */
-		int min,		/* atom count min */
-		    max,		/* atom count max */
-		    cnt,		/* atom count actual */
-		    save;		/* atom count old  - for loop exiting*/
-		} Element;
-
-
-/* --- atomic masses as published by IUPAC, 2002-10-02 ---------- */
-
-Element el[]=
-/* array of the elements used here:
-   Symbol, exact mass, dbe, keycode, number, default-min, default-max
-   RW: Actualization of exact masses, values from NIST, 2013
-*/
-// ele |    mass   |  dbe | key| min | max | cnt | save
-{
-{ "C",  12.000000000,   +2.0, 'C', 0, 41, 0,0 },
-{ "X", 13.0033548378, +2.0, '1', 0, 0, 0 ,0 }, //13C
-{ "H",   1.0078250321,  -1.0, 'H', 0, 72, 0 ,0},
-{ "D",   2.0141017778,  -1.0, 'D', 0, 0, 0 ,0}, //2H
-{ "N",  14.0030740048,  +1.0, 'N', 0, 34, 0,0 },		//org +1 = valence = 3: now +3 for valence = 5
-{ "M", 15.0001088982,   +1.0, 'M', 0, 0, 0,0 }, //15N
-{ "O",  15.9949146196,   0.0, 'O', 0, 30, 0 ,0},
-{ "F",  18.99840322,    -1.0, 'F', 0, 0, 0 ,0},
-{ "Na", 22.9897692809,    -1.0, 'A', 0, 0, 0 ,0},
-{ "Si", 27.9769265325,  +2.0, 'I', 0, 0, 0 ,0},	
-{ "P",  30.97376163,    +3.0, 'P', 0, 0, 0 ,0},		//org +1 valence = 3: now +3 for valence = 5
-{ "S",  31.972071,    +4.0, 'S', 0, 0, 0 ,0},		//org 0 = valence = 2; now +4 for valence = 6
-{ "Cl", 34.96885268,    -1.0, 'L', 0, 0, 0 ,0},
-{ "Br", 78.9183371,     -1.0, 'B', 0, 0, 0 ,0},
-};
-
-const double electron = 0.000549;	/* mass of the electron in amu */
-
 
 /* --- global variables --- */
 
-double  charge,		/* charge on the molecule */
-        tol;		/* mass tolerance in mmu */
-char    comment[MAXLEN]="";	/* some text ;-) */
 int     single;		/* flag to indicate if we calculate only once and exit */
-int     nr_el;		/* number of elements in array (above) */
+FILE    *statsfile;	/* --stats: JSON per query, NULL = off */
+const Adduct *adduct;	/* -a: adduct of the measured ion, NULL = none */
+int     threads[3];	/* -j: threads of enumerate, filter, score for a peak list */
+int     workers, pin_workers;	/* -w: worker processes, 1 = pinned to CPUs */
+double  net_diff, net_decomp;	/* -d: mass-difference network, max. differences, 0 = off */
+int     series_unit[NEL];	/* -s: repeat unit of homologous series */
+int     series_mode;		/* -s given */
+SearchBudget budget;		/* --budget, --progress: search_budget */
+atomic<long> partial_queries;	/* stopped by the budget or Ctrl-C */
+
+#define OPTIONS	"hvpnbt:T:m:c:a:i:k:e:E:j:f:d:s:w:"	/* without the element keys */
+
+#define OPT_STATS	256	/* long options only */
+#define OPT_CACHE	257
+#define OPT_CACHEFILE	258
+#define OPT_QUANTUM	259
+#define OPT_SUSPECTS	260
+#define OPT_STORE	261
+#define OPT_BUDGET	262
+#define OPT_PROGRESS	263
+
+static struct option longopts[] =
+{
+{ "stats", optional_argument, NULL, OPT_STATS },
+{ "cache", optional_argument, NULL, OPT_CACHE },
+{ "cache-file", required_argument, NULL, OPT_CACHEFILE },
+{ "cache-quantum", required_argument, NULL, OPT_QUANTUM },
+{ "suspects", required_argument, NULL, OPT_SUSPECTS },
+{ "suspect-store", required_argument, NULL, OPT_STORE },
+{ "budget", required_argument, NULL, OPT_BUDGET },
+{ "progress", no_argument, NULL, OPT_PROGRESS },
+{ NULL, 0, NULL, 0 }
+};
 
 
+long    query(double mz);
 int     input(char *text, double *zahl);
 int     readfile(char *whatfile);
-double  calc_mass(void);
-float   calc_rdb(void);
-long     do_calculations(double mass, double tolerance);
+int     batch_file(char *whatfile);
+int     annotate_peaks(char *whatfile, int format);
+int     network_peaks(char *whatfile, int format);
+int     series_peaks(char *whatfile, int format);
 int     clean (char *buf);
-//you have to compile with C++ or define yourself this bool type (C99 compiler definition)
-bool calc_element_ratios(bool element_probability);
+static void show_progress(double covered, long long evaluated, void *arg);
+static void stop_searches(int sig);
+static void note_partial(const SearchStats *st);
 
 /* --- threading ------------------- */
 /* mass and RDB calculation could be in several other threads
@@ -162,7 +195,18 @@ int main (int argc, char *argv[])  //RW: optionsS type changed for cross-compila
 {
 double mz;	/* mass */
 char buf[MAXLEN];
+char options[MAXLEN];		/* getopt(): OPTIONS and the element keys */
 int i, tmp;
+size_t cache_entries = 0;	/* 0 = no cache */
+double cache_quantum = CACHE_QUANTUM;
+const char *cache_file = NULL;
+const char *suspect_list = NULL, *suspect_store = NULL;	/* --suspects */
+long skipped;
+int prec[NEL];			/* -f: precursor ion */
+double dbe;			/* -s: RDB change of the unit, x2 */
+double budget_ms = 0.0;		/* --budget */
+long long budget_evals = 0;
+int progress = 0;		/* --progress */
 
 static const char *id =
 "hr version %s. Copyright (C) by Joerg Hau 2001...2005, Tobias Kind 2006 :-) & Robert Winkler 2013...2017 ;-).\n";
@@ -178,14 +222,74 @@ static const char *disclaimer =
 
 static const char *msg =
 "Calculates possible elemental compositions for a given mass.\n\n"
-"usage: hr [options] file\n\nValid command line options are:\n"
+"usage: hr [options] [file]\n\nValid command line options are:\n"
 "-h      This Help screen.\n"
 "-v      Display version information.\n"
 "-t tol  Set tolerance to 'tol' mmu (default 5).\n"
+"-T a,b  Search once at the widest of the tolerances a,b,... ppm (up to 8) and\n"
+"        sort the hits by error; column Tol_ppm is the smallest tolerance a hit\n"
+"        is within, so each tolerance is a prefix (needs -e fast, not with -i).\n"
 "-m mz   Set mass to 'mz'.\n"
 "-c txt  Set comment to 'txt' (only useful together with '-m').\n"
 "-p      Positive ions; electron mass is removed from the formula.\n"
 "-n      Negative ions; electron mass is added to the formula.\n"
+"-a add  The mass is the m/z of adduct 'add' (e.g. [M+Na]+, '-a list' lists\n"
+"        them); the neutral molecule M is calculated.\n"
+"-i a,b  Score the hits against the measured isotope pattern M0,M+1[,M+2[,M+3]]\n"
+"        (any intensity scale) and rank them, best first.\n"
+"-k dev  With -i, drop hits whose closed-form M+1/M+2 differ by more than\n"
+"        'dev' % of M0 from the measured ones before the exact calculation;\n"
+"        the element ranges (C from M+1, Cl, Br, S from M+2) are narrowed to\n"
+"        what can pass before the search.\n"
+"-e eng  Calculation engine: 'legacy' (default, the full loop) or 'fast'\n"
+"        (pruned search, same hits; label ranges -1, -M, -D are expanded from\n"
+"        the unlabelled formulas).\n"
+"--stats[=file]  Append one JSON record per query to 'file' (default stderr):\n"
+"        ns timings, formulas evaluated, rejections by rule, pruned subtrees.\n"
+"--cache[=n]  Keep the hits of the last n (default 1024) searches; a mass\n"
+"        within a cached window is answered from there (needs -e fast).\n"
+"--cache-file=file  Same, the cache is read from and saved to 'file'.\n"
+"--cache-quantum=q  Cached windows are widened to a grid of q mmu (default 1).\n"
+"-b      Lower the element maxima to what the mass allows: max. counts of\n"
+"        known compounds of that mass, mass and valence limits.\n"
+"-j n[,f,s]  Search the peaks of an MGF, mzML or CSV file (by its extension,\n"
+"        needs -e fast) in a pipeline of threads: read, n to enumerate (default\n"
+"        one per core), f for the ratio rules, s for isotopes (default 1), write;\n"
+"        the hit lines start with Scan;Peak;MS;RT_s;mz;Intensity. With --stats,\n"
+"        the last record shows the busy time and queue fill of each stage.\n"
+"        A text file of masses runs on n threads, the searches estimated and\n"
+"        taken longest first, large ones split; output as without -j.\n"
+"-w n[,pin]  Run a text file of masses, or the mass of -m, on n worker\n"
+"        processes (needs -e fast): the searches are split along their outer\n"
+"        elements and dealt out longest first, the hits sent back on pipes and\n"
+"        joined in order, output as without -w; 'pin' binds worker i to CPU i.\n"
+"-f frm  Fragment mode: the masses are MS/MS fragments of the precursor ion\n"
+"        'frm' (e.g. C6H13O6 for [M+H]+ of glucose); only its subformulas are\n"
+"        searched, all from one table, column Loss is the neutral loss (needs\n"
+"        -e fast; the element ranges are 0 to the counts of 'frm'). The table\n"
+"        takes 16 bytes plus 2 per element of 'frm' for each subformula, up\n"
+"        to 256 MB; beyond, each fragment is searched on its own.\n"
+"-d x[,y] Mass-difference network of a peak list: the peak pairs of each\n"
+"        spectrum (of the whole CSV file) whose difference is a transformation\n"
+"        up to x Da (or any formula of the element ranges up to y Da, default\n"
+"        50) within twice the tolerance, as edge list.\n"
+"-s frm  Homologous series of a peak list (e.g. CH2, C2H4O, CF2, must not change\n"
+"        the RDB): the peaks of each spectrum (of the whole CSV file) are grouped\n"
+"        by Kendrick mass defect for the repeat unit 'frm', one search per\n"
+"        series, same hits as -j (needs -e fast).\n"
+"--suspects=file  Suspect screening: the m/z is looked up in the formulas of\n"
+"        'file' ('formula<TAB>name', e.g. formulae/metabolites.tsv) as any adduct\n"
+"        of -a list (of -a only, of the polarity of -p/-n), instead of a search;\n"
+"        columns Adduct and Suspect are added, the error is that of the m/z.\n"
+"--suspect-store=file  Same, the sorted table is kept in 'file' and mapped\n"
+"        from there while the list is unchanged.\n"
+"--budget=ms[,n]  Stop each search after ms milliseconds or n formulas (0 = no\n"
+"        limit; needs -e fast) with the hits so far, \"partial\" and the part of\n"
+"        the space searched (\"covered\") in --stats; Ctrl-C stops the searches\n"
+"        the same way, a second one ends the program.\n"
+"--progress  Show the part of the search done on stderr (needs -e fast).\n"
+"-E file Read the elements from 'file' (see elements.txt) instead of the\n"
+"        built-in table (needs -e fast); their keys are the -X options.\n"
 "-X a-b  For element X, use atom range a to b. List of valid atoms:\n\n"
 "           X    key   mass (6 decimals shown)\n"
 "        -------------------------------------\n";
@@ -193,14 +297,44 @@ static const char *msg =
 /* initialise variables */
 
 single = FALSE;			/* run continuously */
+statsfile = NULL;
+adduct = NULL;
 charge = 0.0;	       	 	/* default charge is neutral */
 tol = 5.0;			/* default tolerance in mmu */
-nr_el = sizeof(el)/sizeof(el[0]);	/* calculate array size */
+init_elements();		/* array size, isotope tables */
+
+
+/* the element file first: its keys are options, too */
+
+for (i = 1; i < argc - 1; i++)
+	if (!strcmp(argv[i], "-E"))
+		{
+		tmp = load_elements(argv[i + 1]);
+		if (tmp <= 0)
+			{
+			if (tmp == 0)
+				fprintf (stderr, "Error: Cannot read elements from %s.\n", argv[i + 1]);
+			else
+				fprintf (stderr, "Error: %s, line %d: need 'symbol mass dbe key min-max'\n"
+					"       (symbols and keys once, max. %d elements).\n", argv[i + 1], -tmp, NEL);
+			return 1;
+			}
+		}
+strcpy(options, OPTIONS);
+for (i = 0; i < nr_el; i++)
+	{
+	if (strchr(OPTIONS "?", el[i].key) != NULL)
+		{
+		fprintf (stderr, "Error: key '%c' of %s is an option.\n", el[i].key, el[i].sym);
+		return 1;
+		}
+	sprintf(options + strlen(options), "%c:", el[i].key);
+	}
 
 
 /* decode and read the command line */
 
-while ((tmp = getopt(argc, argv, "hvpnt:m:c:C:H:N:M:O:D:1:S:F:L:B:P:I:A:")) != EOF)
+while ((tmp = getopt_long(argc, argv, options, longopts, NULL)) != EOF)
 	switch (tmp)
 		{
 		case 'h':     	  		/* help me */
@@ -220,10 +354,20 @@ while ((tmp = getopt(argc, argv, "hvpnt:m:c:C:H:N:M:O:D:1:S:F:L:B:P:I:A:")) != E
 		case 'n':			/* negative carge */
 			charge = -1.0;
 			continue;
+		case 'b':			/* adaptive element maxima */
+			auto_bounds = 1;
+			continue;
 		case 't':       		/* tolerance */
 			strcpy(buf, optarg);
 			sscanf(buf, "%lf", &tol);
 			continue;
+		case 'T':			/* superset tolerances */
+			if (!parse_tiers(optarg))
+				{
+				fprintf (stderr, "Error: need 1 to %d tolerances > 0 ppm for -T.\n", MAXTIERS);
+				return 1;
+				}
+			continue;
 		case 'm':			/* single mass */
 			strcpy(buf, optarg);
 		        sscanf(buf, "%lf", &mz);
@@ -232,6 +376,128 @@ while ((tmp = getopt(argc, argv, "hvpnt:m:c:C:H:N:M:O:D:1:S:F:L:B:P:I:A:")) != E
 		case 'c':			/* comment for single mass */
 	   		strcpy(comment, optarg);
 		        continue;
+		case 'a':			/* adduct */
+			if (!strcmp(optarg, "list"))
+				{
+				for (i = 0; i < nr_adducts; i++)
+					printf ("%s\n", adducts[i].name);
+				return 0;
+				}
+			adduct = find_adduct(optarg);
+			if (adduct == NULL)
+				{
+				fprintf (stderr, "Error: unknown adduct '%s', see '-a list'.\n", optarg);
+				return 1;
+				}
+			continue;
+		case 'i':			/* measured isotope pattern */
+			if (!parse_isotopes(optarg))
+				{
+				fprintf (stderr, "Error: need 2 to %d intensities for -i, M0 > 0.\n", MAXISO);
+				return 1;
+				}
+			continue;
+		case 'k':			/* isotope preselection */
+			iso_keep = atof(optarg);
+			continue;
+		case 'E':			/* element file, read above */
+			continue;
+		case 'f':			/* precursor of fragments */
+			if (!parse_formula(optarg, prec))
+				{
+				fprintf (stderr, "Error: '%s' is not a formula of the elements (see -h).\n", optarg);
+				return 1;
+				}
+			frag_mode = 1;
+			continue;
+		case 's':			/* repeat unit of homologous series */
+			if (!parse_formula(optarg, series_unit))
+				{
+				fprintf (stderr, "Error: '%s' is not a formula of the elements (see -h).\n", optarg);
+				return 1;
+				}
+			for (i = 0, dbe = 0.0; i < nr_el; i++)
+				dbe += el[i].val * series_unit[i];
+			if ((dbe != 0.0) || (calc_mass(series_unit, 0.0) < 0.5))
+				{
+				fprintf (stderr, "Error: the repeat unit of -s must not change the RDB.\n");
+				return 1;
+				}
+			series_mode = 1;
+			continue;
+		case 'd':			/* mass-difference network */
+			net_decomp = 50.0;
+			if ((sscanf(optarg, "%lf,%lf", &net_diff, &net_decomp) < 1) || (net_diff <= 0))
+				{
+				fprintf (stderr, "Error: need -d max[,decomp] Da, max > 0.\n");
+				return 1;
+				}
+			continue;
+		case 'w':			/* worker processes */
+			if ((sscanf(optarg, "%d", &workers) < 1) || (workers < 1))
+				{
+				fprintf (stderr, "Error: need -w n[,pin] worker processes, n > 0.\n");
+				return 1;
+				}
+			pin_workers = (strstr(optarg, ",pin") != NULL);
+			continue;
+		case 'j':			/* threads for a peak list */
+			if ((sscanf(optarg, "%d,%d,%d", &threads[0], &threads[1], &threads[2]) < 1)
+					|| (threads[0] < 1) || (threads[1] < 0) || (threads[2] < 0))
+				{
+				fprintf (stderr, "Error: need -j n[,filter[,score]] threads, n > 0.\n");
+				return 1;
+				}
+			continue;
+		case 'e':			/* engine */
+			if (!strcmp(optarg, "legacy"))
+				engine = ENGINE_LEGACY;
+			else if (!strcmp(optarg, "fast"))
+				engine = ENGINE_FAST;
+			else
+				{
+				fprintf (stderr, "Error: unknown engine '%s'.\n", optarg);
+				return 1;
+				}
+			continue;
+		case OPT_STATS:			/* per query stats */
+			statsfile = (optarg != NULL) ? fopen(optarg, "a") : stderr;
+			if (statsfile == NULL)
+				{
+				fprintf (stderr, "Error: Cannot open %s.\n", optarg);
+				return 1;
+				}
+			continue;
+		case OPT_CACHE:			/* result cache */
+			cache_entries = (optarg != NULL) ? atol(optarg) : CACHE_ENTRIES;
+			continue;
+		case OPT_CACHEFILE:
+			cache_file = optarg;
+			if (cache_entries == 0)
+				cache_entries = CACHE_ENTRIES;
+			continue;
+		case OPT_QUANTUM:
+			cache_quantum = atof(optarg);
+			continue;
+		case OPT_SUSPECTS:		/* suspect screening */
+			suspect_list = optarg;
+			continue;
+		case OPT_STORE:
+			suspect_store = optarg;
+			continue;
+		case OPT_BUDGET:		/* limits of each search */
+			if ((sscanf(optarg, "%lf,%lld", &budget_ms, &budget_evals) < 1)
+					|| (budget_ms < 0) || (budget_evals < 0))
+				{
+				fprintf (stderr, "Error: need --budget=ms[,formulas], 0 = no limit.\n");
+				return 1;
+				}
+			search_budget = &budget;
+			continue;
+		case OPT_PROGRESS:
+			search_budget = &budget;
+			progress = 1;
+			continue;
 		case 'C':      		/* C12 */
  		case 'H':      		/* 1H */
 		case 'N':      		/* 14N */
@@ -246,10 +512,16 @@ while ((tmp = getopt(argc, argv, "hvpnt:m:c:C:H:N:M:O:D:1:S:F:L:B:P:I:A:")) != E
 		case 'B':      		/* 79Br */
 		case 'P':      		/* 31P */
 		case 'I':      		/* 28Si ('S' is taken!) */
+		default:		/* the keys of an element file (-E), or invalid */
 			i = 0;
 			/* compare keys until found */
 			while ((i < nr_el) && (el[i].key != tmp))
 				i++;
+			if ((tmp == '?') || (i == nr_el))	/* invalid arg */
+				{
+				printf ("'%s -h' for help.\n", argv[0]);
+				return 1;
+				}
 			strcpy(buf, optarg);
 			sscanf(buf, "%d-%d", &el[i].min, &el[i].max);	/* copy over */
 			if (el[i].min > el[i].max)			/* swap them */
@@ -262,28 +534,239 @@ while ((tmp = getopt(argc, argv, "hvpnt:m:c:C:H:N:M:O:D:1:S:F:L:B:P:I:A:")) != E
 			// printf ("\n %c = %c ... %s (%d-%d)", tmp, el[i].key, el[i].sym, el[i].min, el[i].max);
 
 			continue;
-		case '~':    	  	/* invalid arg */
-		default:
-			printf ("'%s -h' for help.\n", argv[0]);
-			return 1;
 		}
 
-if (argv[optind] != NULL)	 /* remaining parameter on cmd line? */
-	/* must be a file -- treat it line by line */
-	return (readfile (argv[optind]));
+if (!el_builtin && (engine != ENGINE_FAST))
+	{
+	fprintf (stderr, "Error: -E needs -e fast.\n");
+	return 1;
+	}
+if ((ntiers > 0) && (engine != ENGINE_FAST))
+	{
+	fprintf (stderr, "Error: -T needs -e fast.\n");
+	return 1;
+	}
+if ((ntiers > 0) && (niso_meas > 0))	/* both decide the order of the hits */
+	{
+	fprintf (stderr, "Error: -T sorts the hits by error, it cannot be used with -i.\n");
+	return 1;
+	}
+if (frag_mode)
+	{
+	if ((engine != ENGINE_FAST) || (adduct != NULL) || series_mode)
+		{
+		fprintf (stderr, "Error: -f needs -e fast and no -a or -s.\n");
+		return 1;
+		}
+	for (i = 0; i < nr_el; i++)
+		{
+		el[i].min = 0;
+		el[i].max = prec[i];
+		}
+	frag_open(prec);
+	}
+if (suspect_list != NULL)
+	{
+	if (frag_mode || series_mode || (net_diff > 0) || (ntiers > 0))
+		{
+		fprintf (stderr, "Error: --suspects cannot be used with -f, -s, -d or -T.\n");
+		return 1;
+		}
+	if (suspect_open(suspect_list, suspect_store, adduct, &skipped) == 0)
+		{
+		fprintf (stderr, "Error: no formulas of the elements in %s.\n", suspect_list);
+		return 1;
+		}
+	if (skipped > 0)
+		fprintf (stderr, "Warning: %s: %ld formulas with other elements skipped.\n", suspect_list, skipped);
+	}
+if ((workers > 0) && (engine != ENGINE_FAST) && !suspect_mode)
+	{
+	fprintf (stderr, "Error: -w needs -e fast.\n");
+	return 1;
+	}
+if (search_budget != NULL)
+	{
+	if (engine != ENGINE_FAST)
+		{
+		fprintf (stderr, "Error: --budget and --progress need -e fast.\n");
+		return 1;
+		}
+	init_budget(&budget, (long long)(budget_ms * 1e6), budget_evals);
+	if (progress)
+		budget.progress = show_progress;
+	signal(SIGINT, stop_searches);	/* Ctrl-C: the hits so far */
+	}
+if (cache_entries > 0)
+	{
+	if (engine != ENGINE_FAST)
+		{
+		fprintf (stderr, "Error: the result cache needs -e fast.\n");
+		return 1;
+		}
+	cache_open(cache_entries, cache_quantum, cache_file);
+	}
 
-if (single == TRUE)  	   	 	/* only one calculation requested? */
-	do_calculations(mz, tol);       /* do it, then exit ... */
+tmp = 0;
+if (net_diff > 0)
+	{
+	if ((argv[optind] == NULL) || (peak_format(argv[optind]) == PEAKS_TEXT))
+		{
+		fprintf (stderr, "Error: -d needs a peak list (MGF, mzML, CSV).\n");
+		return 1;
+		}
+	net_open(net_diff, net_decomp);
+	tmp = network_peaks (argv[optind], peak_format(argv[optind]));
+	}
+else if ((argv[optind] != NULL) && (peak_format(argv[optind]) != PEAKS_TEXT))
+	{				/* a peak list */
+	if ((engine != ENGINE_FAST) && !suspect_mode)
+		{
+		fprintf (stderr, "Error: peak lists (MGF, mzML, CSV) need -e fast.\n");
+		return 1;
+		}
+	if (series_mode)
+		tmp = series_peaks (argv[optind], peak_format(argv[optind]));
+	else
+		tmp = annotate_peaks (argv[optind], peak_format(argv[optind]));
+	}
+else if (series_mode)
+	{
+	fprintf (stderr, "Error: -s needs a peak list (MGF, mzML, CSV).\n");
+	return 1;
+	}
+else if ((argv[optind] != NULL) && ((threads[0] > 0) || (workers > 0)))
+	{				/* a file of masses on threads or processes */
+	if ((engine != ENGINE_FAST) && !suspect_mode)
+		{
+		fprintf (stderr, "Error: -j needs -e fast.\n");
+		return 1;
+		}
+	tmp = batch_file (argv[optind]);
+	}
+else if (argv[optind] != NULL)	 /* remaining parameter on cmd line? */
+	/* must be a file -- treat it line by line */
+	tmp = readfile (argv[optind]);
+else if (single == TRUE)  	   	 	/* only one calculation requested? */
+	query(mz);       /* do it, then exit ... */
 else
 	{				/* otherwise run a loop */
 	while (input(comment, &mz))
 		{
-		tmp = do_calculations(mz, tol);
+		query(mz);
 		printf("\n");
 		}
 	}
 
-return 0;
+if (budget.progress != NULL)
+	fprintf(stderr, "\n");
+if (partial_queries > 0)
+	fprintf (stderr, "Warning: %ld searches stopped by --budget or Ctrl-C, their hits are\n"
+		"         incomplete (see \"covered\" of --stats).\n", partial_queries.load());
+if ((cache_entries > 0) && cache_close())
+	{
+	fprintf (stderr, "Error: Cannot write %s.\n", cache_file);
+	return 1;
+	}
+return tmp;
+}
+
+
+/* --- budget ------------------------------------------------------------ */
+
+/* --progress: the search running, on one line of stderr */
+static void show_progress(double covered, long long evaluated, void *arg)
+{
+fprintf(stderr, "\r%5.1f %% searched, %lld formulas   ", 100.0 * covered, evaluated);
+}
+
+
+/* SIGINT: the searches return what they have; a second one ends the program */
+static void stop_searches(int sig)
+{
+cancel_search(&budget);
+signal(sig, SIG_DFL);
+}
+
+
+static void note_partial(const SearchStats *st)
+{
+if (st->partial)
+	partial_queries++;
+}
+
+
+/***************************************************************************
+* ION_WINDOW:	mass, tolerance and charge searched for a measured m/z.	   *
+* Input: 	m/z (of the adduct with -a); mass, tolerance (mmu) and	   *
+*		charge are returned.					   *
+****************************************************************************/
+static void ion_window(double mz, double *m, double *t, double *z)
+{
+*m = mz;
+*t = tol;
+*z = charge;
+if ((adduct != NULL) && !suspect_mode)	/* search M, with the tolerance scaled alike */
+	{
+	*m = adduct_neutral(adduct, mz);
+	*t = tol * abs(adduct->z) / adduct->nmol;
+	*z = 0.0;
+	}
+if (ntiers > 0)			/* the widest, in ppm of the mass searched */
+	*t = tiers_ppm[ntiers - 1] * 1e-3 * *m;
+}
+
+
+/* the query of a mass as calculate() makes it */
+static void mass_query(double mz, Query *q)
+{
+double m, t, z;
+
+ion_window(mz, &m, &t, &z);
+make_query(q, m, t);
+q->charge = z;
+if (auto_bounds)
+	adapt_bounds(q);
+isotope_bounds(q);
+}
+
+
+static long run_batch(const vector<Query> &qs, const vector<string> &names);
+
+
+/***************************************************************************
+* QUERY:	calculates the formulas for one mass, with stats if wanted. *
+* Input: 	mass (m/z of the adduct with -a).			   *
+* Returns:	number of hits.						   *
+****************************************************************************/
+long query(double mz)
+{
+SearchStats st;
+double m, t, z;
+long n;
+
+if (workers > 0)			/* one query split among them (-e fast, see main()) */
+	{
+	vector<Query> qs(1);
+
+	mass_query(mz, &qs[0]);
+	return run_batch(qs, vector<string>(1, comment));
+	}
+z = charge;
+ion_window(mz, &m, &t, &charge);
+
+if ((statsfile == NULL) && (search_budget == NULL))
+	n = calculate(m, t);
+else
+	{
+	n = calculate(m, t, &st);
+	note_partial(&st);
+	fflush(stdout);
+	if (statsfile != NULL)
+		print_stats(statsfile, &st, m, t);
+	}
+charge = z;
+return n;
 }
 
 
@@ -301,23 +784,19 @@ char buf[MAXLEN];				/* input line */
 
 printf("\n\nComment             : ");	/* display prompt */
 
-char* checkreadline = fgets(buf, MAXLEN-1, stdin);	/* read line */
-if(checkreadline == ""){
-  // Reading the line failed
-}
+if (fgets(buf, MAXLEN-1, stdin) == NULL)	/* read line, end of input --> quit */
+	return 0;
 
-buf[MAXLEN] = 0x0;				/* terminate string */
+buf[MAXLEN-1] = 0x0;				/* terminate string */
 clean (buf);				    /* remove linefeed */
 strcpy(txt, buf);			    /* copy text over */
 
 printf("Mass (ENTER to quit): ");	/* display prompt */
 
-char* checkreadline2 = fgets(buf, MAXLEN-1, stdin);	/* read line */
-if(checkreadline2 == ""){
-  // Reading the line failed
-}
+if (fgets(buf, MAXLEN-1, stdin) == NULL)	/* read line, end of input --> quit */
+	return 0;
 
-buf[MAXLEN] = 0x0;			    /* terminate string */
+buf[MAXLEN-1] = 0x0;			    /* terminate string */
 if (!clean (buf))			    /* only a CR ? --> quit */
 	return 0;
 sscanf(buf,"%lf", zahl);		/* scan string */
@@ -345,464 +824,601 @@ if (NULL == infile)
 
 while (fgets(buf, MAXLEN-1, infile))
 	{
-	buf[MAXLEN] = 0x0;			/* terminate string */
+	buf[MAXLEN-1] = 0x0;			/* terminate string */
 	if (*buf == ';')		/* comment line */
 		continue;
 	if (!clean (buf))		/* only a CR ? --> quit */
 		return 0;
 	sscanf(buf,"%s %lf", comment, &mz);	/* scan string */
-	do_calculations(mz, tol);
+	query(mz);
 	mz = 0.0;				/* reset */
 	}
 return 0;
 }
 
 
-/************************************************************************
-* CALC_MASS:	Calculates mass of an ion from its composition.	  	*
-* Input: 	nothing (uses global variables) 	      		*
-* Returns. 	mass of the ion.	  				*
-* Note:		Takes care of charge and electron mass!   		*
-* 		(Positive charge means removal of electrons).	 	*
-*************************************************************************/
-double calc_mass(void)
+/***************************************************************************
+* RUN_BATCH:	searches all queries at once, with fork_search() on	   *
+*		'workers' processes (-w) or batch_search() on threads[0]   *
+*		threads (-j), and prints the hits of each as query().	   *
+* Input: 	queries, their comments.				   *
+* Returns:	total no. of hits, -1 if error.				   *
+****************************************************************************/
+static long run_batch(const vector<Query> &qs, const vector<string> &names)
 {
-int i;
-double sum = 0.0;
+vector< vector<Candidate> > hits;
+vector<SearchStats> st(qs.size() + 1);
+double z = charge;
+long long t0;
+long tasks, n;
+size_t j;
+
+t0 = clock_ns();
+if (workers > 0)
+	n = fork_search(qs, hits, &st[0], workers, pin_workers, &tasks);
+else
+	n = batch_search(qs, hits, &st[0], threads[0], &tasks);
+t0 = clock_ns() - t0;
+if (n < 0)
+	{
+	fprintf (stderr, "Error: a worker process failed.\n");
+	return -1;
+	}
 
-for (i=0; i < nr_el; i++)
-	sum += el[i].mass * el[i].cnt;
+if (adduct != NULL)		/* as ion_window(), for print_stats() */
+	charge = 0.0;
+for (j = 0; j < qs.size(); j++)
+	{
+	printf("\n");
+	print_header();
+	print_hits(hits[j]);
+	note_partial(&st[j]);
+	if (statsfile != NULL)
+		{
+		fflush(stdout);
+		strcpy(comment, names[j].c_str());
+		print_stats(statsfile, &st[j], qs[j].mass, qs[j].tol);
+		}
+	}
+fflush(stdout);
+charge = z;
+if (statsfile != NULL)
+	{
+	fprintf(statsfile, "{\"batch\": {\"queries\": %zu, \"tasks\": %ld, \"%s\": %d, \"ns\": %lld}}\n",
+		qs.size(), tasks, (workers > 0) ? "workers" : "threads", (workers > 0) ? workers : threads[0], t0);
+	fflush(statsfile);
+	}
+return n;
+}
 
-return (sum - (charge * electron));
+
+/***************************************************************************
+* BATCH_FILE:	reads a file like readfile(), then searches all masses	   *
+*		at once, see run_batch().				   *
+* Input: 	file name.						   *
+* Returns:	0 if OK, 1 if error.					   *
+****************************************************************************/
+int batch_file(char *whatfile)
+{
+vector<Query> qs;
+vector<string> names;
+Query q;
+double mz;
+char buf[MAXLEN], name[MAXLEN];
+FILE *infile;
+
+infile = fopen(whatfile, "r");
+if (NULL == infile)
+	{
+	fprintf (stderr, "Error: Cannot open %s.", whatfile);
+	return 1;
+	}
+while (fgets(buf, MAXLEN-1, infile))
+	{
+	if (*buf == ';')		/* comment line */
+		continue;
+	if (!clean (buf))		/* only a CR ? --> end */
+		break;
+	mz = 0.0;
+	sscanf(buf,"%s %lf", name, &mz);
+	mass_query(mz, &q);
+	qs.push_back(q);
+	names.push_back(name);
+	}
+fclose(infile);
+return (run_batch(qs, names) < 0) ? 1 : 0;
 }
 
 
 /************************************************************************
-* CALC_RDB:	Calculates rings & double bond equivalents.    		*
-* Input: 	nothing (uses global variables)			   	*
-* Returns. 	RDB.				       			*
+* CLEAN:	"cleans" a buffer obtained by fgets() 			*
+* Input: 	Pointer to text buffer					*
+* Returns:	strlen of buffer.   					*
 *************************************************************************/
-float calc_rdb(void)
+int clean (char *buf)
 {
 int i;
-float sum = 2.0;
 
-for (i=0; i < nr_el; i++)
-	sum += el[i].val * el[i].cnt;
+for(i = 0;  i < (int)strlen(buf);  i++)		/* search for CR/LF */
+	{
+	if(buf[i] == '\n' || buf[i] == '\r')
+		{
+		buf[i] = 0;			/* stop at CR or LF */
+		break;
+		}
+	}
+return (strlen(buf));
+}
+
+
 
-return (sum/2.0);
+
+/* --- peak lists: a pipeline of threads (-j) ---
+
+ parse -> enumerate -> filter -> score -> write, each stage with its
+ own threads (parse and write: one). Between two stages every pair of
+ threads has its own single-producer/single-consumer ring, lock-free;
+ peak no. s is done by thread s % n of each stage, so each consumer
+ knows which ring its next peak comes from, and the writer gets them
+ in the order of the file. A full ring stops its producer, an empty
+ one its consumer (backpressure). At the end, the parser sends NSTOP
+ end markers with the no. after the last peak, so that every thread
+ of every stage gets one.
+*/
+
+#define RINGSIZE	64	/* peaks per ring, a power of 2 */
+#define NSTAGES		5
+#define ST_PARSE	0
+#define ST_ENUM		1
+#define ST_FILTER	2
+#define ST_SCORE	3
+#define ST_WRITE	4
+
+static const char *stage_names[NSTAGES] = { "parse", "enumerate", "filter", "score", "write" };
+
+typedef struct	{			/* a peak on its way through the stages */
+		long	seq;		/* no. in the file, from 0; end marker: the no. after the last */
+		int	end;		/* 1 = end marker */
+		Peak	peak;
+		Query	q;
+		vector<Candidate> hits;
+		SearchStats st;
+		string	text;		/* hit lines */
+		} PipeItem;
+
+struct Ring	{			/* written by one thread, read by one */
+		PipeItem *slot[RINGSIZE];
+		atomic<long> head, tail;	/* pushed, popped */
+		long long pushes, fill, peak;	/* by the producer: sum, max. of the fill level */
+		};
+
+typedef struct	{			/* per stage, summed over its threads */
+		int	n;		/* threads */
+		Ring	*in;		/* n[stage-1] x n rings, ring of a -> b at a * n + b */
+		atomic<long long> ns_busy, ns_wait_in, ns_wait_out;
+		} Stage;
+
+static Stage stages[NSTAGES];
+static int nstop;			/* end markers: the most threads of a stage */
+
+typedef struct	{
+		int	stage, id;
+		} StageThread;
+
+
+static void wait_ring(int *spins)	/* nothing to do: yield, then sleep */
+{
+if (++*spins < 100)
+	sched_yield();
+else
+	usleep(50);
 }
-/************************************************************************
-* Calculates element ratios , CH2 (more than 8 electrons needed is not handled)  		
-* Calculations element probabilities if element_probability = true 
-* Input: 	nothing (uses global variables)			   	
-* Returns. true/false.				       			
-*************************************************************************/
-bool calc_element_ratios(bool element_probability)
+
+
+static void push_ring(Ring *r, PipeItem *item, long long *ns_wait)
 {
-bool CHNOPS_ok;	
-float HC_ratio;
-float NC_ratio;
-float OC_ratio;
-float PC_ratio;
-float SC_ratio;
-
-float C_count = (float)el[0].cnt+(float)el[1].cnt; //RW added isotopes
-float H_count = (float)el[2].cnt+(float)el[3].cnt; //RW added isotopes
-float N_count = (float)el[4].cnt+(float)el[5].cnt; //RW added isotopes
-float O_count = (float)el[6].cnt;
-float P_count = (float)el[10].cnt;
-float S_count = (float)el[11].cnt;
-
-
-//RW ELEMENT RATIOS and CNOPS adjusted, according to Kind & Fiehn, 2007
-
-		/* ELEMENT RATIOS allowed
-			MIN		MAX (99.99%)
-		H/C	0.1		6.00
-		N/C	0.00	4.00
-		O/C	0.00	3.00
-		P/C	0.00	2.00
-		S/C	0.00	3.00
-		*/	
-
-//RW Probability check for common range (covering 99.7%)
-
-	// set CHNOPS_ok = true and assume all ratios are ok
-	CHNOPS_ok = true;	
-	
-	
-	if (C_count && H_count >0)					// C and H  must have one count anyway (remove for non-organics//
-	{	
-		HC_ratio = H_count/C_count;
-		if (element_probability)
-		{
-			if ((HC_ratio <  0.2) || (HC_ratio >  3.1)) // this is the H/C probability check ;
-			CHNOPS_ok = false;
-		}
-		else if (HC_ratio >  6.0) // this is the normal H/C ratio check - type cast from int to float is important
-			CHNOPS_ok = false;
+long h = r->head.load(memory_order_relaxed);
+long long n, t0 = 0;
+int spins = 0;
+
+while (h - r->tail.load(memory_order_acquire) >= RINGSIZE)
+	{
+	if (spins == 0)
+		t0 = clock_ns();
+	wait_ring(&spins);
+	}
+if (spins > 0)
+	*ns_wait += clock_ns() - t0;
+r->slot[h & (RINGSIZE - 1)] = item;
+r->head.store(h + 1, memory_order_release);
+n = h + 1 - r->tail.load(memory_order_relaxed);
+r->pushes++;
+r->fill += n;
+r->peak = max(r->peak, n);
+}
+
+
+static PipeItem *pop_ring(Ring *r, long long *ns_wait)
+{
+long t = r->tail.load(memory_order_relaxed);
+long long t0 = 0;
+int spins = 0;
+PipeItem *item;
+
+while (r->head.load(memory_order_acquire) == t)
+	{
+	if (spins == 0)
+		t0 = clock_ns();
+	wait_ring(&spins);
 	}
+if (spins > 0)
+	*ns_wait += clock_ns() - t0;
+item = r->slot[t & (RINGSIZE - 1)];
+r->tail.store(t + 1, memory_order_release);
+return item;
+}
+
 
-	if (N_count >0)	// if positive number of nitrogens then thes N/C ratio else just calc normal
+/* the query of a peak, without the ratio rules (see ST_FILTER) */
+static void peak_query(const Peak *p, Query *q)
+{
+double m, t, z;
+
+ion_window(p->mz, &m, &t, &z);
+make_query(q, m, t);
+q->charge = z;
+q->rules = 0;
+if (auto_bounds)
+	adapt_bounds(q);
+isotope_bounds(q);
+}
+
+
+/* the hit lines of a peak, tagged with it */
+static string peak_lines(const Peak *p, const vector<Candidate> &hits)
+{
+string text;
+char tag[200];
+size_t j;
+
+snprintf(tag, sizeof(tag), "%ld;%d;%d;%.2f;%.6f;%g;", p->scan, p->peak,
+	p->level, p->rt, p->mz, p->intensity);
+for (j = 0; j < hits.size(); j++)
+	text += tag + hit_line(hits[j]) + " \n";
+return text;
+}
+
+
+/* the work of a stage on one peak */
+static void run_stage(int stage, PipeItem *it)
+{
+switch (stage)
 	{
-		NC_ratio = N_count/C_count;
-		if (element_probability)
-		{
-			if (NC_ratio >  1.3) // this is the N/C probability check ;
-			CHNOPS_ok = false;
-		}
-		else if (NC_ratio >  4.0)
-			CHNOPS_ok = false;
-	}	
-	
-	if (O_count >0)	// if positive number of O then thes O/C ratio else just calc normal
-	{	
-		OC_ratio = O_count/C_count;
-		if (element_probability)
+	case ST_ENUM:			/* the formulas in the window, RDB */
+		peak_query(&it->peak, &it->q);
+		search_hits(&it->q, it->hits, &it->st);
+		break;
+	case ST_FILTER:			/* element ratios, not for known formulas */
+		if (!suspect_mode)
+			filter_ratios(it->hits, &it->st);
+		break;
+	case ST_SCORE:			/* isotopes, -T; the lines */
+		rank_hits(&it->q, it->hits, &it->st);
+		it->text = peak_lines(&it->peak, it->hits);
+		break;
+	case ST_WRITE:
+		fputs(it->text.c_str(), stdout);
+		note_partial(&it->st);
+		if (statsfile != NULL)
+			{
+			strcpy(comment, it->peak.title);
+			print_stats(statsfile, &it->st, it->q.mass, it->q.tol);
+			}
+		break;
+	}
+}
+
+
+static void *stage_thread(void *arg)
+{
+const StageThread *me = (const StageThread *)arg;
+Stage *in = &stages[me->stage];
+Stage *out = &stages[me->stage + 1];
+PipeItem *it;
+long long t0, wait_in = 0, wait_out = 0, busy = 0;
+long s, end;
+
+for (s = me->id; ; s += in->n)
+	{
+	it = pop_ring(&in->in[(s % stages[me->stage - 1].n) * in->n + me->id], &wait_in);
+	end = it->end ? it->seq : 0;
+	if (!it->end)
 		{
-			if (OC_ratio >  1.2) // this is the O/C  probability check ;
-			CHNOPS_ok = false;		
+		t0 = clock_ns();
+		run_stage(me->stage, it);
+		busy += clock_ns() - t0;
 		}
-		else if (OC_ratio >  3.0)
-				CHNOPS_ok = false;
-	}	
+	if (me->stage == ST_WRITE)
+		delete it;
+	else
+		push_ring(&out->in[me->id * out->n + (s % out->n)], it, &wait_out);
+	if (end && (s + in->n >= end))	/* the last marker for this thread */
+		break;
+	}
+in->ns_busy += busy;
+in->ns_wait_in += wait_in;
+in->ns_wait_out += wait_out;
+return NULL;
+}
 
 
-	if (P_count >0)	// if positive number of P then thes P/C ratio else just calc normal
-	{	
-		PC_ratio = 	P_count/C_count;
-		if (element_probability)
+/* one JSON record of the stages: time busy and blocked, ring fill */
+static void print_pipeline(FILE *f)
+{
+long long pushes, fill, peak;
+int k, i;
+
+fprintf(f, "{\"pipeline\": [");
+for (k = 0; k < NSTAGES; k++)
+	{
+	pushes = fill = peak = 0;
+	for (i = 0; k && (i < stages[k - 1].n * stages[k].n); i++)
 		{
-			if (PC_ratio >  0.3) // this is the P/C  probability check ;
-			CHNOPS_ok = false;	
-		
+		pushes += stages[k].in[i].pushes;
+		fill += stages[k].in[i].fill;
+		peak = max(peak, stages[k].in[i].peak);
 		}
-		else if (PC_ratio >  2.0)
-			CHNOPS_ok = false;
-	}	
-
-	if (S_count >0)	// if positive number of S then thes S/C ratio else just calc normal
-	{	
-		SC_ratio = 	S_count/C_count;
-		if (element_probability)
+	fprintf(f, "%s{\"stage\": \"%s\", \"threads\": %d, \"ns_busy\": %lld, \"ns_wait_in\": %lld, "
+		"\"ns_wait_out\": %lld", k ? ", " : "", stage_names[k], stages[k].n,
+		stages[k].ns_busy.load(), stages[k].ns_wait_in.load(), stages[k].ns_wait_out.load());
+	if (k > 0)			/* the rings in front of it */
+		fprintf(f, ", \"queue_mean\": %.2f, \"queue_max\": %lld, \"queue_size\": %d",
+			pushes ? (double)fill / pushes : 0.0, peak, stages[k - 1].n * RINGSIZE);
+	fprintf(f, "}");
+	}
+fprintf(f, "]}\n");
+fflush(f);
+}
+
+
+/***************************************************************************
+* ANNOTATE_PEAKS:	searches every peak of an MGF, mzML or CSV file,   *
+*		read as a stream, in the pipeline above (threads[] of	   *
+*		enumerate, filter, score); the hits are written in the	   *
+*		order of the file, each line tagged with its peak.	   *
+* Input: 	file name, PEAKS_... format.				   *
+* Returns:	0 if OK, 1 if error.					   *
+****************************************************************************/
+int annotate_peaks(char *whatfile, int format)
+{
+PeakReader *reader;
+PipeItem *it;
+vector<pthread_t> tid;
+vector<StageThread> who;
+long long t0, busy = 0, wait_out = 0;
+long s, last;
+int i, k, ok;
+
+reader = open_peaks(whatfile, format);
+if (reader == NULL)
+	{
+	fprintf (stderr, "Error: Cannot open %s.\n", whatfile);
+	return 1;
+	}
+if ((adduct != NULL) && !suspect_mode)/* as ion_window(), for print_stats() */
+	charge = 0.0;
+
+stages[ST_PARSE].n = stages[ST_WRITE].n = 1;
+stages[ST_ENUM].n = (threads[0] > 0) ? threads[0] : sysconf(_SC_NPROCESSORS_ONLN);
+stages[ST_FILTER].n = threads[1];
+stages[ST_SCORE].n = threads[2];
+nstop = 1;
+for (k = 0; k < NSTAGES; k++)
+	{
+	if (stages[k].n < 1)
+		stages[k].n = 1;
+	nstop = max(nstop, stages[k].n);
+	stages[k].ns_busy = stages[k].ns_wait_in = stages[k].ns_wait_out = 0;
+	stages[k].in = NULL;
+	if (k > 0)
 		{
-			if (SC_ratio >  0.8) // this is the S/C  probability check ;
-			CHNOPS_ok = false;	
+		stages[k].in = new Ring[stages[k - 1].n * stages[k].n];
+		for (i = 0; i < stages[k - 1].n * stages[k].n; i++)
+			{
+			stages[k].in[i].head = stages[k].in[i].tail = 0;
+			stages[k].in[i].pushes = stages[k].in[i].fill = stages[k].in[i].peak = 0;
+			}
 		}
-		else if (SC_ratio >  3.0)
-			CHNOPS_ok = false;
-	}	
-
-//-----------------------------------------------------------------------------	
-		
-	// check for multiple element ratios together with probability check 
-	//if N<10, O<20, P<4, S<3 then true
-	if (element_probability && (N_count > 10) && (O_count > 20) && (P_count > 4) && (S_count > 3))
-		CHNOPS_ok = false;	
-	
-	// NOP check for multiple element ratios together with probability check
-	// NOP all > 3 and (N<11, O <22, P<6 then true)
-	if (element_probability && (N_count > 3) && (O_count > 3) && (P_count > 3))
+	for (i = 0; (k > 0) && (i < stages[k].n); i++)
 		{
-		if (element_probability && (N_count > 11) && (O_count > 22) && (P_count > 6))
-			CHNOPS_ok = false;	
+		StageThread st = { k, i };
+		who.push_back(st);
 		}
-	
-	// OPS check for multiple element ratios together with probability check
-	// O<14, P<3, S<3 then true
-	if (element_probability && (O_count > 14) && (P_count > 3) && (S_count > 3))
-		CHNOPS_ok = false;	
-
-	// PSN check for multiple element ratios together with probability check
-	// P<3, S<3, N<4 then true
-	if (element_probability && (P_count > 3) && (S_count > 3) && (N_count >4))
-		CHNOPS_ok = false;	
-
-	
-	// NOS check for multiple element ratios together with probability check
-	// NOS all > 6 and (N<19 O<14 S<8 then true)
-	if (element_probability && (N_count >6) && (O_count >6) && (S_count >6))
-	{
-		if (element_probability && (N_count >19) && (O_count >14) && (S_count >8))
-			CHNOPS_ok = false;	
-	}	
-
-
-	// function return value;
-	if (CHNOPS_ok == true)
-		return true;
-	else 
-		return false;
-}
-
-/************************************************************************
-* DO_CALCULATIONS: Does the actual calculation loop.			*
-* Input: 	   measured mass (in amu), tolerance (in mmu)	    	*
-* Returns. 	   number of hits.	       				*
-*************************************************************************/
-long do_calculations (double measured_mass, double tolerance)
-{
-time_t start, finish;
-double elapsed_time;
-
-double mass;			/* calc'd mass */
-double limit_lo, limit_hi;	/* mass limits */
-float rdb, lewis;			/* Rings & double bonds */
-long i;
-long long hit;		/* counts the hits, with long declaration, overflow after 25h with all formulas < 2000 Da
-							    long = FFFFFFFFh = 4,294,967,295d*/
-long long counter;
-bool elementcheck;
-bool set_break;
+	}
 
+printf("Scan;Peak;MS;RT_s;mz;Intensity;%s \n", hit_header().c_str());
+tid.resize(who.size());
+for (i = 0; i < (int)who.size(); i++)
+	pthread_create(&tid[i], NULL, stage_thread, &who[i]);
 
-time( &start );		// start time
-printf("\n");		/* linefeed */
+/* the parser: this thread */
+for (s = 0; ; s++)
+	{
+	t0 = clock_ns();
+	it = new PipeItem();
+	it->seq = s;
+	ok = next_peak(reader, &it->peak);
+	busy += clock_ns() - t0;
+	if (ok <= 0)
+		break;
+	push_ring(&stages[ST_ENUM].in[s % stages[ST_ENUM].n], it, &wait_out);
+	}
+delete it;
+last = s;
+for (i = 0; i < nstop; i++)		/* the end markers, no. last ... last + nstop - 1 */
+	{
+	it = new PipeItem();
+	it->end = 1;
+	it->seq = last + nstop;
+	push_ring(&stages[ST_ENUM].in[(last + i) % stages[ST_ENUM].n], it, &wait_out);
+	}
+stages[ST_PARSE].ns_busy = busy;
+stages[ST_PARSE].ns_wait_out = wait_out;
+for (i = 0; i < (int)tid.size(); i++)
+	pthread_join(tid[i], NULL);
+fflush(stdout);
+
+if (statsfile != NULL)
+	print_pipeline(statsfile);
+for (k = 1; k < NSTAGES; k++)
+	delete[] stages[k].in;
+if (ok < 0)
+	fprintf (stderr, "Error: %s: %s\n", whatfile, peaks_error(reader));
+close_peaks(reader);
+return (ok < 0);
+}
 
-/* calculate limits */
 
-limit_lo = measured_mass - (tolerance / 1000.0);
-limit_hi = measured_mass + (tolerance / 1000.0);
+/* --- mass-difference network (-d) --- */
 
-// if (strlen(comment))	/* print only if there is some text to print */
-// 	printf ("Text      \t%s\n", comment);
+/* the edges of one group of peaks */
+static long write_edges(const vector<Peak> &peaks)
+{
+vector<double> mass(peaks.size());
+vector<NetEdge> edges;
+size_t j;
+double t;
 
-// printf ("Composition\t");
-// for (i=0; i < nr_el; i++)
-// 	if (el[i].max > 0)
-// 		printf("%s:%d-%d ", el[i].sym, el[i].min, el[i].max);
-// printf ("\n");
+for (j = 0; j < peaks.size(); j++)
+	mass[j] = (adduct != NULL) ? adduct_neutral(adduct, peaks[j].mz) : peaks[j].mz;
+t = (adduct != NULL) ? tol * abs(adduct->z) / adduct->nmol : tol;	/* as ion_window() */
+net_edges(mass, t, edges);
 
-// printf ("Tol (mmu)\t%.1f\n",tolerance);
-// printf ("Measured\t%.4lf\n", measured_mass);
-// printf ("Charge  \t%+.1lf\n", charge);
+for (j = 0; j < edges.size(); j++)
+	{
+	const Peak &a = peaks[edges[j].a], &b = peaks[edges[j].b];
 
+	printf("%ld;%d;%.6f;%ld;%d;%.6f;%.6f;%s;%.6f;%.4f;%s \n", a.scan, a.peak, a.mz,
+		b.scan, b.peak, b.mz, mass[edges[j].b] - mass[edges[j].a],
+		net_formula(edges[j]).c_str(), net_mass(edges[j]), edges[j].error, net_name(edges[j]));
+	}
+return edges.size();
+}
 
 
-/*
-RW defining the csv file name and writing the header
-*/
+/***************************************************************************
+* NETWORK_PEAKS:	the mass-difference network of each spectrum of an  *
+*		MGF or mzML file, or of all rows of a CSV file (feature	   *
+*		table): one line per edge, see net_edges().		   *
+* Input: 	file name, PEAKS_... format.				   *
+* Returns:	0 if OK, 1 if error.					   *
+****************************************************************************/
+int network_peaks(char *whatfile, int format)
+{
+PeakReader *reader;
+vector<Peak> peaks;
+Peak p;
+int ok;
 
+reader = open_peaks(whatfile, format);
+if (reader == NULL)
+	{
+	fprintf (stderr, "Error: Cannot open %s.\n", whatfile);
+	return 1;
+	}
 
-// ofstream denovofile; //RW define output file variable
-// denovofile.open ("HR3.csv"); //RW define output file name
-stringstream hroutstream;   //RW string stream used for the conversion to string and file output
-hroutstream << "Formula" << ";" << "RDB" << ";" << "LEWIS"  << ";"  << "Mass_Da" << ";" << "Mass_Error_mDa" << " \n"; //RW
-string stringResult;          //RW resulting string variable
-stringResult = hroutstream.str(); //RW conversion of the stream to a string
-cout << stringResult; //RW writing the string to the file
+printf("Scan_a;Peak_a;mz_a;Scan_b;Peak_b;mz_b;Diff_Da;Formula;Formula_Da;Error_mDa;Transformation \n");
+while ((ok = next_peak(reader, &p)) > 0)
+	{
+	if ((format != PEAKS_CSV) && (p.peak == 1) && !peaks.empty())	/* next spectrum */
+		{
+		write_edges(peaks);
+		peaks.clear();
+		}
+	peaks.push_back(p);
+	}
+write_edges(peaks);
+fflush(stdout);
 
-hit = 0;			/* Reset counter */
-counter = 0;
-set_break = false;	/* set breaker for element counts to false */
+if (ok < 0)
+	fprintf (stderr, "Error: %s: %s\n", whatfile, peaks_error(reader));
+close_peaks(reader);
+return (ok < 0);
+}
 
-/* Now let's run the big big loop ... I'd like to do that
-   recursively but did not yet figure out how ;-) 
-   TK Adds: the loop is just fine.
-*/
 
-/* now comes the "COOL trick" for calculating all formulae:
-sorting the high mass elements to the outer loops, the small weights (H)
-to the inner loops;
+/* --- homologous series (-s) --- */
 
-This will reduce the computational time by factor ~10-60-1000
-OLD HR: Cangrelor at 1ppm  4465 formulas found in   5866 seconds.
-NEW HR2: Cangrelor at 1ppm 4465 formulas found in     96 seconds.
-NEW2 HR2: Cangrelor at 1ppm 4465 formulas found in     60 seconds.
-NEW3 HR2: Cangrelor at 1ppm 4465 formulas found in     59 seconds.
-HR2 Fast: Cangrelor at 1ppm 4465 formulas found in     41 seconds by evaluating 2,003,436,894 formulae.
-hr2 -c "Cangrelor" -m  774.948 -t 0.77 -C 1-64 -H 1-112 -N 0-30 -O 0-80 -P 0-12 -S 0-9 -F 0-10 -L 0-10
+/* the hits of one group of peaks, searched by series */
+static long write_series(const vector<Peak> &peaks)
+{
+vector<Query> qs(peaks.size());
+vector< vector<Candidate> > hits;
+vector<SearchStats> st(peaks.size());
+size_t j;
+long n;
 
-Another additional trick is to end the 2nd.. 3rd.. 4th.. xth innermost loop
-to prevent loops which are just higher and higher in mass.
-*/
+if (peaks.empty())
+	return 0;
+for (j = 0; j < peaks.size(); j++)
+	peak_query(&peaks[j], &qs[j]);
+n = series_search(qs, series_unit, hits, &st[0]);
 
-el[13].cnt = el[13].min - 1;  el[13].save = el[13].cnt; 
-while (el[13].cnt++ < el[13].max) /* "Br"*/ { 
-
-el[12].cnt = el[12].min - 1;  el[12].save = el[12].cnt; 
-while (el[12].cnt++ < el[12].max) /*"Cl"*/ { 
-	 
-el[11].cnt = el[11].min - 1;  el[11].save = el[11].cnt; 
-while (el[11].cnt++ < el[11].max) /*"S"*/ { 
-	 
-el[10].cnt = el[10].min - 1;  el[10].save = el[10].cnt; 
-while (el[10].cnt++ < el[10].max) /*"P"*/ { 
-	 
-el[9].cnt = el[9].min - 1;  el[9].save = el[9].cnt; 
-while (el[9].cnt++ < el[9].max) /*"Si"*/ { 
-
-el[8].cnt = el[8].min - 1;  el[8].save = el[8].cnt; 
-while (el[8].cnt++ < el[8].max) /*"Na"*/{ 
-
-el[7].cnt = el[7].min - 1;  el[7].save = el[7].cnt; 
-while (el[7].cnt++ < el[7].max) /*"F"*/ { 
- 
-el[6].cnt = el[6].min - 1;  el[6].save = el[6].cnt; 
-while (el[6].cnt++ < el[6].max) /*"O"*/ { 
-	 
-el[5].cnt = el[5].min - 1;  el[5].save = el[5].cnt; 
-while (el[5].cnt++ < el[5].max) /*"15N"*/{ 
-
-el[4].cnt = el[4].min - 1; el[4].save = el[4].cnt; 
-while (el[4].cnt++ < el[4].max) /*"N"*/{ 
-	 
-el[1].cnt = el[1].min - 1; el[1].save = el[1].cnt; 
-while (el[1].cnt++ < el[1].max) /*"13C"*/ { 
-
-el[0].cnt = el[0].min - 1; el[0].save = el[0].cnt; 
-while (el[0].cnt++ < el[0].max) /* "C"*/ { 
-
-el[3].cnt = el[3].min - 1; 	el[3].save = el[3].cnt; 
-while (el[3].cnt++ < el[3].max) /*"D"*/{ 
-
-el[2].cnt = el[2].min - 1; el[2].save = el[2].cnt; 
-while (el[2].cnt++ < el[2].max) /*"H"*/{ 
-
-	mass = calc_mass();
-	counter++;
-
-	//just for debug purposes
-	//if (mass > limit_hi)  
-	//printf("mass: %f\tC: %d  H: %d  N: %d O: %d P: %d S: %d Cl: %d Br: %d\n",mass,el[0].cnt,el[2].cnt,el[4].cnt,el[6].cnt,el[10].cnt,el[11].cnt,el[12].cnt,el[13].cnt);
-    	
-	/* if we exceed the upper limit, we can stop the calculation
-       for this particular element (JHa 20050227). <-- comment TK that will only bust the innermost while loop, which is "H"*/
-
-	// break H loop 	if (mass > limit_hi)  break;
-
-    //************************************************************************************************************/	
-	//Calculus loop with print out
-	//************************************************************************************************************/	
-	
-
-
-	if ((mass >= limit_lo) && (mass <= limit_hi)) /* within limits? */
-	{	
-		// element check will be performed always, if variable bool element_probability is true also probabilities will be calculated
-		// not an elegant implementation, but fast.
-		 elementcheck = calc_element_ratios(true);
-		 if (elementcheck)
-	{ 
-	rdb = calc_rdb();	/* get RDB */
-	lewis = (float)(fmod(rdb, 1)); /*calc remainder*/
-	if ((rdb >= 0) && (lewis != 0.5) && (lewis !=-0.5))/* less than -0.5 RDB does not make sense */
-
-		{													/* NO(!) CH3F10NS2 exists , RDB =  -4.0   M= 282.9547*/
-
-		
-		hit ++;
-		for (i = 0; i < nr_el; i++)	 /* print composition */
-		    if (el[i].cnt > 0)	/* but only if useful */
-		 
-			  {
-			  // printf("%s%d.", el[i].sym, el[i].cnt);	//print formula to screen
-			  ostringstream hroutstream;   //RW string stream used for the conversion to string and file output
-			  hroutstream << el[i].sym << el[i].cnt; //RW generation of formula string
-			  string stringResult;          //RW resulting string variable
-			  stringResult = hroutstream.str(); //RW conversion of the stream to a string
-			  cout << stringResult; //RW writing the string to the stdout
-		      }
-			  // printf("\t\t%.1f\t%.4lf\t%+.1lf mmu \n", rdb, mass, 1000.0 * (measured_mass - mass));
-			  
-			  double mass_out = mass;
-  		
-	  		  float rdb_out = rdb;
-	  		  
-	  		  float lewis_out = lewis;
-	  		  
-	  		  ostringstream hroutstream;   //RW stream used for the conversion to string and file output
-	  		  hroutstream << ";" << rdb_out << ";" << lewis_out  << ";"  << mass_out << ";" << 1000.0 * (measured_mass - mass) << " \n"; //RW
-			  
-			  string stringResult;          //RW resulting string variable
-			  stringResult = hroutstream.str(); //RW conversion of the stream to a string
-			  cout << stringResult; //RW writing the string to the file
-			  
-  
-		}	/* end of 'rdb' loop */
-
-	}	// end of elementcheck loop
-	
-	}	/* end of 'limit' loop */
-	//************************************************************************************************************/
-		
-
-	/*
-	TK: if the current mass is larger than the limit the loop can be exited.
-	Each element must point to the element which is in use and before.
-	This is a static implementation which can be enhanced with a pointer chain to the lower element.
-	Actually now its only allowed for CHNSOP-Fl-Cl-Br-Si !!! Brute-force <> elegance :-)
-	*/
-		} /*"H"*/
-		
-		} /*"D"*/
-		
-		if ((mass >= limit_lo) && (el[2].save == el[2].cnt-1)) break;
-		} /* "C"*/
-		
-		} /*"13C"*/
-
-		if ((mass >= limit_lo) && (el[0].save == el[0].cnt-1)) break;
-		} /*"N"*/
-		
-		} /*"15N"*/
-
-        if ((mass >= limit_lo) && (el[4].save == el[4].cnt-1)) break;
-		} /*"O"*/
-		
-	    if ((mass >= limit_lo) && (el[6].save == el[6].cnt-1)) break;
-		} /*"F"*/
-		
-		} /*"Na"*/
-		
-	    if ((mass >= limit_lo) && (el[7].save == el[7].cnt-1)) break;
-		}  /*"Si"*/
-		
-		if ((mass >= limit_lo) && (el[9].save == el[9].cnt-1)) break;
-		} /*"P"*/
-		
-		if ((mass >= limit_lo) && (el[10].save == el[10].cnt-1)) break;
-		} /*"S"*/
-		
-		if ((mass >= limit_lo) && (el[11].save == el[11].cnt-1)) break;
-		} /*"Cl"*/
-		
-		if ((mass >= limit_lo) && (el[12].save == el[12].cnt-1)) break;
-		} /*"Br" ends*/
-/* close that giant loop thing started above */
-
-// denovofile.close(); //RW
-//return 0; //RW
-	
-
-time(&finish);		// stop timer
-elapsed_time = difftime(finish , start);	// calulate time difference
-
-
-
-return hit;
+for (j = 0; j < peaks.size(); j++)	/* as the pipeline, ST_FILTER on */
+	{
+	filter_ratios(hits[j], &st[j]);
+	rank_hits(&qs[j], hits[j], &st[j]);
+	fputs(peak_lines(&peaks[j], hits[j]).c_str(), stdout);
+	note_partial(&st[j]);
+	if (statsfile != NULL)
+		{
+		strcpy(comment, peaks[j].title);
+		print_stats(statsfile, &st[j], qs[j].mass, qs[j].tol);
+		}
+	}
+return n;
 }
 
 
-/************************************************************************
-* CLEAN:	"cleans" a buffer obtained by fgets() 			*
-* Input: 	Pointer to text buffer					*
-* Returns:	strlen of buffer.   					*
-*************************************************************************/
-int clean (char *buf)
+/***************************************************************************
+* SERIES_PEAKS:	searches the peaks of each spectrum of an MGF or mzML	   *
+*		file, or all rows of a CSV file, by homologous series of   *
+*		the repeat unit (-s), see series_search(); the lines are   *
+*		those of annotate_peaks().				   *
+* Input: 	file name, PEAKS_... format.				   *
+* Returns:	0 if OK, 1 if error.					   *
+****************************************************************************/
+int series_peaks(char *whatfile, int format)
 {
-int i;
+PeakReader *reader;
+vector<Peak> peaks;
+Peak p;
+int ok;
 
-for(i = 0;  i < strlen(buf);  i++)		/* search for CR/LF */
+reader = open_peaks(whatfile, format);
+if (reader == NULL)
 	{
-	if(buf[i] == '\n' || buf[i] == '\r')
+	fprintf (stderr, "Error: Cannot open %s.\n", whatfile);
+	return 1;
+	}
+if (adduct != NULL)		/* as ion_window(), for print_stats() */
+	charge = 0.0;
+
+printf("Scan;Peak;MS;RT_s;mz;Intensity;%s \n", hit_header().c_str());
+while ((ok = next_peak(reader, &p)) > 0)
+	{
+	if ((format != PEAKS_CSV) && (p.peak == 1) && !peaks.empty())	/* next spectrum */
 		{
-		buf[i] = 0;			/* stop at CR or LF */
-		break;
+		write_series(peaks);
+		peaks.clear();
 		}
+	peaks.push_back(p);
 	}
-return (strlen(buf));
-}
-
+write_series(peaks);
+fflush(stdout);
 
+if (ok < 0)
+	fprintf (stderr, "Error: %s: %s\n", whatfile, peaks_error(reader));
+close_peaks(reader);
+return (ok < 0);
+}
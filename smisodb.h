@@ -0,0 +1,503 @@
+/*
+
+SMISODB.H
+
+ Element and isotope database of the formula engine (el[] in
+ smformula.cpp) and the isotope pattern library (smisotope_lib.c).
+ GENERATED by formulae/isotopes.py ("make isodb"), edit that instead.
+
+ ISODB_ELEMENTS(E): E(symbol, 1st letter, 2nd letter or 0, atom #,
+ no. of isotopes, index of the first one in ISODB_ISOTOPES) in the order
+ of the atom numbers of smisotope_lib.c; the labels D (2H), X (13C) and
+ M (15N) are elements with one isotope.
+ ISODB_ISOTOPES(I): I(nominal mass, exact mass in Da or 0 if not in the
+ database, natural abundance).
+
+ In C++, the same as constexpr tables with isodb_mass(), and the
+ consistency of the data is checked at compile time.
+
+*/
+
+#ifndef SMISODB_H
+#define SMISODB_H
+
+#define ISODB_ELEMENTS(E) \
+E("H",  'H', 0  ,  1,  2,   0) \
+E("D",  'D', 0  ,  2,  1,   2) \
+E("He", 'H', 'e',  3,  2,   3) \
+E("Li", 'L', 'i',  4,  2,   5) \
+E("Be", 'B', 'e',  5,  1,   7) \
+E("B",  'B', 0  ,  6,  2,   8) \
+E("C",  'C', 0  ,  7,  2,  10) \
+E("X",  'X', 0  ,  8,  1,  12) \
+E("N",  'N', 0  ,  9,  2,  13) \
+E("M",  'M', 0  , 10,  1,  15) \
+E("O",  'O', 0  , 11,  3,  16) \
+E("F",  'F', 0  , 12,  1,  19) \
+E("Ne", 'N', 'e', 13,  3,  20) \
+E("Na", 'N', 'a', 14,  1,  23) \
+E("Mg", 'M', 'g', 15,  3,  24) \
+E("Al", 'A', 'l', 16,  1,  27) \
+E("Si", 'S', 'i', 17,  3,  28) \
+E("P",  'P', 0  , 18,  1,  31) \
+E("S",  'S', 0  , 19,  4,  32) \
+E("Cl", 'C', 'l', 20,  2,  36) \
+E("Ar", 'A', 'r', 21,  3,  38) \
+E("K",  'K', 0  , 22,  3,  41) \
+E("Ca", 'C', 'a', 23,  6,  44) \
+E("Sc", 'S', 'c', 24,  1,  50) \
+E("Ti", 'T', 'i', 25,  5,  51) \
+E("V",  'V', 0  , 26,  2,  56) \
+E("Cr", 'C', 'r', 27,  4,  58) \
+E("Mn", 'M', 'n', 28,  1,  62) \
+E("Fe", 'F', 'e', 29,  4,  63) \
+E("Co", 'C', 'o', 30,  1,  67) \
+E("Ni", 'N', 'i', 31,  5,  68) \
+E("Cu", 'C', 'u', 32,  2,  73) \
+E("Zn", 'Z', 'n', 33,  5,  75) \
+E("Ga", 'G', 'a', 34,  2,  80) \
+E("Ge", 'G', 'e', 35,  5,  82) \
+E("As", 'A', 's', 36,  1,  87) \
+E("Se", 'S', 'e', 37,  6,  88) \
+E("Br", 'B', 'r', 38,  2,  94) \
+E("Kr", 'K', 'r', 39,  6,  96) \
+E("Rb", 'R', 'b', 40,  2, 102) \
+E("Sr", 'S', 'r', 41,  4, 104) \
+E("Y",  'Y', 0  , 42,  1, 108) \
+E("Zr", 'Z', 'r', 43,  5, 109) \
+E("Nb", 'N', 'b', 44,  1, 114) \
+E("Mo", 'M', 'o', 45,  7, 115) \
+E("Tc", 'T', 'c', 46,  1, 122) \
+E("Ru", 'R', 'u', 47,  7, 123) \
+E("Rh", 'R', 'h', 48,  1, 130) \
+E("Pd", 'P', 'd', 49,  6, 131) \
+E("Ag", 'A', 'g', 50,  2, 137) \
+E("Cd", 'C', 'd', 51,  8, 139) \
+E("In", 'I', 'n', 52,  2, 147) \
+E("Sn", 'S', 'n', 53, 10, 149) \
+E("Sb", 'S', 'b', 54,  2, 159) \
+E("Te", 'T', 'e', 55,  8, 161) \
+E("I",  'I', 0  , 56,  1, 169) \
+E("Xe", 'X', 'e', 57,  9, 170) \
+E("Cs", 'C', 's', 58,  1, 179) \
+E("Ba", 'B', 'a', 59,  7, 180) \
+E("La", 'L', 'a', 60,  2, 187) \
+E("Ce", 'C', 'e', 61,  4, 189) \
+E("Pr", 'P', 'r', 62,  1, 193) \
+E("Nd", 'N', 'd', 63,  7, 194) \
+E("Pm", 'P', 'm', 64,  1, 201) \
+E("Sm", 'S', 'm', 65,  7, 202) \
+E("Eu", 'E', 'u', 66,  2, 209) \
+E("Gd", 'G', 'd', 67,  7, 211) \
+E("Tb", 'T', 'b', 68,  1, 218) \
+E("Dy", 'D', 'y', 69,  7, 219) \
+E("Ho", 'H', 'o', 70,  1, 226) \
+E("Er", 'E', 'r', 71,  6, 227) \
+E("Tm", 'T', 'm', 72,  1, 233) \
+E("Yb", 'Y', 'b', 73,  7, 234) \
+E("Lu", 'L', 'u', 74,  2, 241) \
+E("Hf", 'H', 'f', 75,  6, 243) \
+E("Ta", 'T', 'a', 76,  2, 249) \
+E("W",  'W', 0  , 77,  5, 251) \
+E("Re", 'R', 'e', 78,  2, 256) \
+E("Os", 'O', 's', 79,  7, 258) \
+E("Ir", 'I', 'r', 80,  2, 265) \
+E("Pt", 'P', 't', 81,  6, 267) \
+E("Au", 'A', 'u', 82,  1, 273) \
+E("Hg", 'H', 'g', 83,  7, 274) \
+E("Tl", 'T', 'l', 84,  2, 281) \
+E("Pb", 'P', 'b', 85,  4, 283) \
+E("Bi", 'B', 'i', 86,  1, 287) \
+E("Po", 'P', 'o', 87,  1, 288) \
+E("At", 'A', 't', 88,  1, 289) \
+E("Rn", 'R', 'n', 89,  1, 290) \
+E("Fr", 'F', 'r', 90,  1, 291) \
+E("Ra", 'R', 'a', 91,  1, 292) \
+E("Ac", 'A', 'c', 92,  1, 293) \
+E("Th", 'T', 'h', 93,  1, 294) \
+E("Pa", 'P', 'a', 94,  1, 295) \
+E("U",  'U', 0  , 95,  3, 296) \
+E("Np", 'N', 'p', 96,  1, 299) \
+E("Pu", 'P', 'u', 97,  1, 300) \
+
+#define ISODB_ISOTOPES(I) \
+I(  1, 1.0078250321  , 0.999885  ) /* H */ \
+I(  2, 2.0141017778  , 0.000115  ) \
+I(  2, 2.0141017778  , 1.0       ) /* D */ \
+I(  3, 3.0160293201  , 1.34e-06  ) /* He */ \
+I(  4, 4.00260325413 , 0.99999866) \
+I(  6, 6.0151228874  , 0.0759    ) /* Li */ \
+I(  7, 7.0160034366  , 0.9241    ) \
+I(  9, 9.012183065   , 1.0       ) /* Be */ \
+I( 10, 10.01293695   , 0.199     ) /* B */ \
+I( 11, 11.00930536   , 0.801     ) \
+I( 12, 12.0          , 0.9893    ) /* C */ \
+I( 13, 13.0033548378 , 0.0107    ) \
+I( 13, 13.0033548378 , 1.0       ) /* X */ \
+I( 14, 14.0030740048 , 0.99636   ) /* N */ \
+I( 15, 15.0001088982 , 0.00364   ) \
+I( 15, 15.0001088982 , 1.0       ) /* M */ \
+I( 16, 15.9949146196 , 0.99757   ) /* O */ \
+I( 17, 16.9991317565 , 0.00038   ) \
+I( 18, 17.9991596129 , 0.00205   ) \
+I( 19, 18.99840322   , 1.0       ) /* F */ \
+I( 20, 19.9924401762 , 0.9048    ) /* Ne */ \
+I( 21, 20.993846685  , 0.0027    ) \
+I( 22, 21.991385114  , 0.0925    ) \
+I( 23, 22.9897692809 , 1.0       ) /* Na */ \
+I( 24, 23.985041697  , 0.7899    ) /* Mg */ \
+I( 25, 24.985836976  , 0.1       ) \
+I( 26, 25.982592968  , 0.1101    ) \
+I( 27, 26.98153853   , 1.0       ) /* Al */ \
+I( 28, 27.9769265325 , 0.92223   ) /* Si */ \
+I( 29, 28.9764946649 , 0.04685   ) \
+I( 30, 29.973770136  , 0.03092   ) \
+I( 31, 30.97376163   , 1.0       ) /* P */ \
+I( 32, 31.972071     , 0.9499    ) /* S */ \
+I( 33, 32.9714589098 , 0.0075    ) \
+I( 34, 33.967867004  , 0.0425    ) \
+I( 36, 35.96708071   , 0.0001    ) \
+I( 35, 34.96885268   , 0.7576    ) /* Cl */ \
+I( 37, 36.965902602  , 0.2424    ) \
+I( 36, 35.967545105  , 0.003365  ) /* Ar */ \
+I( 38, 37.96273211   , 0.000632  ) \
+I( 40, 39.9623831237 , 0.996003  ) \
+I( 39, 38.9637064864 , 0.932581  ) /* K */ \
+I( 40, 39.963998166  , 0.000117  ) \
+I( 41, 40.9618252579 , 0.067302  ) \
+I( 40, 39.962590863  , 0.96941   ) /* Ca */ \
+I( 42, 41.95861783   , 0.00647   ) \
+I( 43, 42.95876644   , 0.00135   ) \
+I( 44, 43.95548156   , 0.02086   ) \
+I( 46, 45.953689     , 4e-05     ) \
+I( 48, 47.95252276   , 0.00187   ) \
+I( 45, 44.95590828   , 1.0       ) /* Sc */ \
+I( 46, 45.95262772   , 0.0825    ) /* Ti */ \
+I( 47, 46.95175879   , 0.0744    ) \
+I( 48, 47.94794198   , 0.7372    ) \
+I( 49, 48.94786568   , 0.0541    ) \
+I( 50, 49.94478689   , 0.0518    ) \
+I( 50, 49.94715601   , 0.0025    ) /* V */ \
+I( 51, 50.94395704   , 0.9975    ) \
+I( 50, 49.94604183   , 0.04345   ) /* Cr */ \
+I( 52, 51.94050623   , 0.83789   ) \
+I( 53, 52.94064815   , 0.09501   ) \
+I( 54, 53.93887916   , 0.02365   ) \
+I( 55, 54.93804391   , 1.0       ) /* Mn */ \
+I( 54, 53.93960899   , 0.05845   ) /* Fe */ \
+I( 56, 55.93493633   , 0.91754   ) \
+I( 57, 56.93539284   , 0.02119   ) \
+I( 58, 57.93327443   , 0.00282   ) \
+I( 59, 58.93319429   , 1.0       ) /* Co */ \
+I( 58, 57.93534241   , 0.680769  ) /* Ni */ \
+I( 60, 59.93078588   , 0.262231  ) \
+I( 61, 60.93105557   , 0.011399  ) \
+I( 62, 61.92834537   , 0.036345  ) \
+I( 64, 63.92796682   , 0.009256  ) \
+I( 63, 62.92959772   , 0.6915    ) /* Cu */ \
+I( 65, 64.9277897    , 0.3085    ) \
+I( 64, 63.92914201   , 0.48268   ) /* Zn */ \
+I( 66, 65.92603381   , 0.27975   ) \
+I( 67, 66.92712775   , 0.04102   ) \
+I( 68, 67.92484455   , 0.19024   ) \
+I( 70, 69.9253192    , 0.00631   ) \
+I( 69, 68.9255735    , 0.60108   ) /* Ga */ \
+I( 71, 70.92470258   , 0.39892   ) \
+I( 70, 69.92424875   , 0.2038    ) /* Ge */ \
+I( 72, 71.922075826  , 0.2731    ) \
+I( 73, 72.923458956  , 0.0776    ) \
+I( 74, 73.921177761  , 0.3672    ) \
+I( 76, 75.921402726  , 0.0783    ) \
+I( 75, 74.92159457   , 1.0       ) /* As */ \
+I( 74, 73.922475934  , 0.0089    ) /* Se */ \
+I( 76, 75.919213704  , 0.0937    ) \
+I( 77, 76.919914154  , 0.0763    ) \
+I( 78, 77.91730928   , 0.2377    ) \
+I( 80, 79.9165218    , 0.4961    ) \
+I( 82, 81.9166995    , 0.0873    ) \
+I( 79, 78.9183371    , 0.5069    ) /* Br */ \
+I( 81, 80.9162897    , 0.4931    ) \
+I( 78, 0             , 0.00355   ) /* Kr */ \
+I( 80, 0             , 0.02286   ) \
+I( 82, 0             , 0.11593   ) \
+I( 83, 0             , 0.115     ) \
+I( 84, 0             , 0.56987   ) \
+I( 86, 0             , 0.17279   ) \
+I( 85, 0             , 0.7217    ) /* Rb */ \
+I( 87, 0             , 0.2783    ) \
+I( 84, 0             , 0.0056    ) /* Sr */ \
+I( 86, 0             , 0.0986    ) \
+I( 87, 0             , 0.07      ) \
+I( 88, 0             , 0.8258    ) \
+I( 89, 0             , 1.0       ) /* Y */ \
+I( 90, 0             , 0.5145    ) /* Zr */ \
+I( 91, 0             , 0.1122    ) \
+I( 92, 0             , 0.1715    ) \
+I( 94, 0             , 0.1738    ) \
+I( 96, 0             , 0.028     ) \
+I( 93, 0             , 1.0       ) /* Nb */ \
+I( 92, 0             , 0.1477    ) /* Mo */ \
+I( 94, 0             , 0.0923    ) \
+I( 95, 0             , 0.159     ) \
+I( 96, 0             , 0.1668    ) \
+I( 97, 0             , 0.0956    ) \
+I( 98, 0             , 0.2419    ) \
+I(100, 0             , 0.0967    ) \
+I( 98, 0             , 1.0       ) /* Tc */ \
+I( 96, 0             , 0.0554    ) /* Ru */ \
+I( 98, 0             , 0.0187    ) \
+I( 99, 0             , 0.1276    ) \
+I(100, 0             , 0.126     ) \
+I(101, 0             , 0.1706    ) \
+I(102, 0             , 0.3155    ) \
+I(104, 0             , 0.1862    ) \
+I(103, 0             , 1.0       ) /* Rh */ \
+I(102, 0             , 0.0102    ) /* Pd */ \
+I(104, 0             , 0.1114    ) \
+I(105, 0             , 0.2233    ) \
+I(106, 0             , 0.2733    ) \
+I(108, 0             , 0.2646    ) \
+I(110, 0             , 0.1172    ) \
+I(107, 0             , 0.51839   ) /* Ag */ \
+I(109, 0             , 0.48161   ) \
+I(106, 0             , 0.0125    ) /* Cd */ \
+I(108, 0             , 0.0089    ) \
+I(110, 0             , 0.1249    ) \
+I(111, 0             , 0.128     ) \
+I(112, 0             , 0.2413    ) \
+I(113, 0             , 0.1222    ) \
+I(114, 0             , 0.2873    ) \
+I(116, 0             , 0.0749    ) \
+I(113, 0             , 0.0429    ) /* In */ \
+I(115, 0             , 0.9571    ) \
+I(112, 0             , 0.0097    ) /* Sn */ \
+I(114, 0             , 0.0066    ) \
+I(115, 0             , 0.0034    ) \
+I(116, 0             , 0.1454    ) \
+I(117, 0             , 0.0768    ) \
+I(118, 0             , 0.2422    ) \
+I(119, 0             , 0.0859    ) \
+I(120, 0             , 0.3258    ) \
+I(122, 0             , 0.0463    ) \
+I(124, 0             , 0.0579    ) \
+I(121, 0             , 0.5721    ) /* Sb */ \
+I(123, 0             , 0.4279    ) \
+I(120, 0             , 0.0009    ) /* Te */ \
+I(122, 0             , 0.0255    ) \
+I(123, 0             , 0.0089    ) \
+I(124, 0             , 0.0474    ) \
+I(125, 0             , 0.0707    ) \
+I(126, 0             , 0.1884    ) \
+I(128, 0             , 0.3174    ) \
+I(130, 0             , 0.3408    ) \
+I(127, 126.9044719   , 1.0       ) /* I */ \
+I(124, 0             , 0.000952  ) /* Xe */ \
+I(126, 0             , 0.00089   ) \
+I(128, 0             , 0.019102  ) \
+I(129, 0             , 0.264006  ) \
+I(130, 0             , 0.04071   ) \
+I(131, 0             , 0.212324  ) \
+I(132, 0             , 0.269086  ) \
+I(134, 0             , 0.104357  ) \
+I(136, 0             , 0.088573  ) \
+I(133, 0             , 1.0       ) /* Cs */ \
+I(130, 0             , 0.00106   ) /* Ba */ \
+I(132, 0             , 0.00101   ) \
+I(134, 0             , 0.02417   ) \
+I(135, 0             , 0.06592   ) \
+I(136, 0             , 0.07854   ) \
+I(137, 0             , 0.11232   ) \
+I(138, 0             , 0.71698   ) \
+I(138, 0             , 0.0009    ) /* La */ \
+I(139, 0             , 0.9991    ) \
+I(136, 0             , 0.00185   ) /* Ce */ \
+I(138, 0             , 0.00251   ) \
+I(140, 0             , 0.8845    ) \
+I(142, 0             , 0.11114   ) \
+I(141, 0             , 1.0       ) /* Pr */ \
+I(142, 0             , 0.272     ) /* Nd */ \
+I(143, 0             , 0.122     ) \
+I(144, 0             , 0.238     ) \
+I(145, 0             , 0.083     ) \
+I(146, 0             , 0.172     ) \
+I(148, 0             , 0.057     ) \
+I(150, 0             , 0.056     ) \
+I(145, 0             , 1.0       ) /* Pm */ \
+I(144, 0             , 0.0307    ) /* Sm */ \
+I(147, 0             , 0.1499    ) \
+I(148, 0             , 0.1124    ) \
+I(149, 0             , 0.1382    ) \
+I(150, 0             , 0.0738    ) \
+I(152, 0             , 0.2675    ) \
+I(154, 0             , 0.2275    ) \
+I(151, 0             , 0.4781    ) /* Eu */ \
+I(153, 0             , 0.5219    ) \
+I(152, 0             , 0.002     ) /* Gd */ \
+I(154, 0             , 0.0218    ) \
+I(155, 0             , 0.148     ) \
+I(156, 0             , 0.2047    ) \
+I(157, 0             , 0.1565    ) \
+I(158, 0             , 0.2484    ) \
+I(160, 0             , 0.2186    ) \
+I(159, 0             , 1.0       ) /* Tb */ \
+I(156, 0             , 0.00056   ) /* Dy */ \
+I(158, 0             , 0.00095   ) \
+I(160, 0             , 0.02329   ) \
+I(161, 0             , 0.18889   ) \
+I(162, 0             , 0.25475   ) \
+I(163, 0             , 0.24896   ) \
+I(164, 0             , 0.2826    ) \
+I(165, 0             , 1.0       ) /* Ho */ \
+I(162, 0             , 0.00139   ) /* Er */ \
+I(164, 0             , 0.01601   ) \
+I(166, 0             , 0.33503   ) \
+I(167, 0             , 0.22869   ) \
+I(168, 0             , 0.26978   ) \
+I(170, 0             , 0.1491    ) \
+I(169, 0             , 1.0       ) /* Tm */ \
+I(168, 0             , 0.0013    ) /* Yb */ \
+I(170, 0             , 0.0304    ) \
+I(171, 0             , 0.1428    ) \
+I(172, 0             , 0.2183    ) \
+I(173, 0             , 0.1613    ) \
+I(174, 0             , 0.3183    ) \
+I(176, 0             , 0.1276    ) \
+I(175, 0             , 0.9741    ) /* Lu */ \
+I(176, 0             , 0.0259    ) \
+I(174, 0             , 0.0016    ) /* Hf */ \
+I(176, 0             , 0.0526    ) \
+I(177, 0             , 0.186     ) \
+I(178, 0             , 0.2728    ) \
+I(179, 0             , 0.1362    ) \
+I(180, 0             , 0.3508    ) \
+I(180, 0             , 0.00012   ) /* Ta */ \
+I(181, 0             , 0.99988   ) \
+I(180, 0             , 0.0012    ) /* W */ \
+I(182, 0             , 0.265     ) \
+I(183, 0             , 0.1431    ) \
+I(184, 0             , 0.3064    ) \
+I(186, 0             , 0.2843    ) \
+I(185, 0             , 0.374     ) /* Re */ \
+I(187, 0             , 0.626     ) \
+I(184, 0             , 0.0002    ) /* Os */ \
+I(186, 0             , 0.0159    ) \
+I(187, 0             , 0.0196    ) \
+I(188, 0             , 0.1324    ) \
+I(189, 0             , 0.1615    ) \
+I(190, 0             , 0.2626    ) \
+I(192, 0             , 0.4078    ) \
+I(191, 0             , 0.373     ) /* Ir */ \
+I(193, 0             , 0.627     ) \
+I(190, 0             , 0.00014   ) /* Pt */ \
+I(192, 0             , 0.00782   ) \
+I(194, 0             , 0.32967   ) \
+I(195, 0             , 0.33832   ) \
+I(196, 0             , 0.25242   ) \
+I(198, 0             , 0.07163   ) \
+I(197, 0             , 1.0       ) /* Au */ \
+I(196, 0             , 0.0015    ) /* Hg */ \
+I(198, 0             , 0.0997    ) \
+I(199, 0             , 0.1687    ) \
+I(200, 0             , 0.231     ) \
+I(201, 0             , 0.1318    ) \
+I(202, 0             , 0.2986    ) \
+I(204, 0             , 0.0687    ) \
+I(203, 0             , 0.2952    ) /* Tl */ \
+I(205, 0             , 0.7048    ) \
+I(204, 0             , 0.014     ) /* Pb */ \
+I(206, 0             , 0.241     ) \
+I(207, 0             , 0.221     ) \
+I(208, 0             , 0.524     ) \
+I(209, 0             , 1.0       ) /* Bi */ \
+I(209, 0             , 1.0       ) /* Po */ \
+I(210, 0             , 1.0       ) /* At */ \
+I(222, 0             , 1.0       ) /* Rn */ \
+I(223, 0             , 1.0       ) /* Fr */ \
+I(226, 0             , 1.0       ) /* Ra */ \
+I(227, 0             , 1.0       ) /* Ac */ \
+I(232, 0             , 1.0       ) /* Th */ \
+I(231, 0             , 1.0       ) /* Pa */ \
+I(234, 0             , 5.4e-05   ) /* U */ \
+I(235, 0             , 0.007204  ) \
+I(238, 0             , 0.992742  ) \
+I(237, 0             , 1.0       ) /* Np */ \
+I(244, 0             , 1.0       ) /* Pu */ \
+
+#define ISODB_NEL	97
+#define ISODB_NISO	301
+
+#ifdef __cplusplus
+
+struct isodb_isotope	{ int m; double mass; double fr; };
+struct isodb_element	{ const char *sym; int atno, niso, first; };
+
+#define ISODB_E(sym, c1, c2, atno, niso, first)	{ sym, atno, niso, first },
+#define ISODB_I(m, mass, fr)			{ m, mass, fr },
+constexpr isodb_element isodb_el[ISODB_NEL] = { ISODB_ELEMENTS(ISODB_E) };
+constexpr isodb_isotope isodb_iso[ISODB_NISO] = { ISODB_ISOTOPES(ISODB_I) };
+#undef ISODB_E
+#undef ISODB_I
+
+constexpr bool isodb_same(const char *a, const char *b)
+{
+return (*a == *b) && ((*a == 0) || isodb_same(a + 1, b + 1));
+}
+
+/* index of element 'sym' in isodb_el[], -1 if none */
+constexpr int isodb_find(const char *sym)
+{
+for (int i = 0; i < ISODB_NEL; i++)
+	if (isodb_same(isodb_el[i].sym, sym))
+		return i;
+return -1;
+}
+
+/* exact mass of isotope m of 'sym', of the most abundant one if m = 0
+   (the "monoisotopic" mass of el[]: 56Fe, 80Se); 0 if not in the database */
+constexpr double isodb_mass(const char *sym, int m = 0)
+{
+int e = isodb_find(sym), top = 0;
+
+if (e < 0)
+	return 0.0;
+for (int k = 0; k < isodb_el[e].niso; k++)
+	{
+	const isodb_isotope &p = isodb_iso[isodb_el[e].first + k];
+	if (p.m == m)
+		return p.mass;
+	if (p.fr > isodb_iso[isodb_el[e].first + top].fr)
+		top = k;
+	}
+return (m == 0) ? isodb_iso[isodb_el[e].first + top].mass : 0.0;
+}
+
+/* abundances add up to 1, isotopes by mass, exact masses near the nominal ones */
+constexpr bool isodb_consistent(void)
+{
+for (int e = 0; e < ISODB_NEL; e++)
+	{
+	double sum = 0.0;
+	for (int k = 0; k < isodb_el[e].niso; k++)
+		{
+		const isodb_isotope &p = isodb_iso[isodb_el[e].first + k];
+		sum += p.fr;
+		if ((k > 0) && (p.m <= isodb_iso[isodb_el[e].first + k - 1].m))
+			return false;
+		if ((p.mass != 0.0) && ((p.mass < p.m - 0.5) || (p.mass > p.m + 0.5)))
+			return false;
+		}
+	if ((sum < 0.999) || (sum > 1.001))
+		return false;
+	}
+return true;
+}
+
+static_assert(isodb_consistent(), "isotope database: abundances, order or masses");
+static_assert(isodb_mass("D") == isodb_mass("H", 2), "label D is not 2H");
+static_assert(isodb_mass("X") == isodb_mass("C", 13), "label X is not 13C");
+static_assert(isodb_mass("M") == isodb_mass("N", 15), "label M is not 15N");
+static_assert(isodb_mass("C") == 12.0, "12C defines the mass scale");
+
+#endif /* __cplusplus */
+
+#endif /* SMISODB_H */
@@ -9,6 +9,10 @@ main changes:
 
 2013-10-21 Isotope tables revised, according to NIST
 2014-02-21 Heavy isotopes added as D (2H), X (13C) and N (15N) 
+2026-10-19 Multi-threaded batch mode (-b) with tagged CSV/binary records
+2026-10-19 Tables and calculation moved to a reentrant library (smisotope_lib.c)
+2026-10-19 Perfect-hash symbol lookup, formulas with brackets and hydrates,
+           parser benchmark (-p -b file)
 --------------------------------------------------------------------
 
 
@@ -53,8 +57,9 @@ main changes:
 
 To run the program interactively, enter formula when asked. Element symbols
 must be correctly typed, with upper and lower case as usual. Elements can be
-repeated in a formula, but brackets are not understood: CH3OH is ok, but
-Ni(CO)4 is not; this has to be typed as NiC4O4.
+repeated in a formula. Brackets (also nested) and hydrates are understood:
+CH3OH, Ni(CO)4, [Cu(NH3)4]SO4 and CuSO4.5H2O (or CuSO4*5H2O, CuSO4·5H2O)
+are all ok.
 
 If you run the program, the output is by defaut normalized to 100.00
 percent for the bigest peak. If you launch it with option '-f' instead, the
@@ -79,444 +84,42 @@ character of the last line. Then type
 
 (... but don't make any mistakes in the formulas, if you do it this way!).
 
+For large lists, use the batch mode instead (RW):
+
+    isotope -b infile -o outfile
+
+reads one formula per line ('-' reads stdin), computes the patterns in
+parallel on all cores (-j sets the number of threads) and writes one
+tagged record ID;Formula;Mass;TM0;TM1;TM2;TM3;Status per formula, in
+input order, to stdout or to the -o file. With -r the records are binary.
+Unlike the single formula mode, it never writes 'isotopes.csv'.
+
  This is ANSI C and should compile with any C compiler; use
- something along the lines of "gcc -Wall -O3 -o isotope isotope.c".
+ something along the lines of
+ "gcc -Wall -O3 -o isotope smisotope.c smisotope_lib.c -lpthread".
+ The tables and the calculation itself are in SMISOTOPE_LIB.C; its
+ reentrant interface (SMISOTOPE.H) can be linked into other programs.
  Optimize for speed!
 
 */
 
 #define VERSION "20140221"	/* string! */
-#define CUTOFF 1e-7
 
 #include <stdio.h>
 #include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#ifdef __linux__
+#include <sys/sysinfo.h>
+#endif
+#include "smisotope.h"
 
-typedef struct {int m; float fr; }                  isotope;    /* mass, abundance */
-typedef struct {char *sym; int niso;  isotope *p; } element;    /* symbol, no. of isotopes, ptr */
-typedef struct {int atno; int count; }              atom;
-typedef struct {int mass; float intens; }           peak;
-
-element el[] =
- {
- { "H",  2, NULL },
- { "D", 1, NULL}, //RW Deuterium, 2H
- { "He", 2, NULL },
- { "Li", 2, NULL },
- { "Be", 1, NULL },
- { "B",  2, NULL },
- { "C",  2, NULL },
- { "X", 1, NULL }, //RW 13C
- { "N",  2, NULL },
- { "M", 1, NULL }, //RW 15N
- { "O",  3, NULL },
- { "F",  1, NULL },
- { "Ne", 3, NULL },
- { "Na", 1, NULL },
- { "Mg", 3, NULL },
- { "Al", 1, NULL },
- { "Si", 3, NULL },
- { "P",  1, NULL },
- { "S",  4, NULL },
- { "Cl", 2, NULL },
- { "Ar", 3, NULL },
- { "K",  3, NULL },
- { "Ca", 6, NULL },
- { "Sc", 1, NULL },
- { "Ti", 5, NULL },
- { "V",  2, NULL },
- { "Cr", 4, NULL },
- { "Mn", 1, NULL },
- { "Fe", 4, NULL },
- { "Co", 1, NULL },
- { "Ni", 5, NULL },
- { "Cu", 2, NULL },
- { "Zn", 5, NULL },
- { "Ga", 2, NULL },
- { "Ge", 5, NULL },
- { "As", 1, NULL },
- { "Se", 6, NULL },
- { "Br", 2, NULL },
- { "Kr", 6, NULL },
- { "Rb", 2, NULL },
- { "Sr", 4, NULL },
- { "Y",  1, NULL },
- { "Zr", 5, NULL },
- { "Nb", 1, NULL,  },
- { "Mo", 7, NULL },
- { "Tc", 1, NULL },
- { "Ru", 7, NULL },
- { "Rh", 1, NULL },
- { "Pd", 6, NULL },
- { "Ag", 2, NULL },
- { "Cd", 8, NULL },
- { "In", 2, NULL },
- { "Sn", 10, NULL },
- { "Sb", 2, NULL },
- { "Te", 8, NULL },
- { "I" , 1, NULL },
- { "Xe", 9, NULL },
- { "Cs", 1, NULL },
- { "Ba", 7, NULL },
- { "La", 2, NULL },
- { "Ce", 4, NULL },
- { "Pr", 1, NULL },
- { "Nd", 7, NULL },
- { "Pm", 1, NULL },
- { "Sm", 7, NULL },
- { "Eu", 2, NULL },
- { "Gd", 7, NULL },
- { "Tb", 1, NULL },
- { "Dy", 7, NULL },
- { "Ho", 1, NULL },
- { "Er", 6, NULL },
- { "Tm", 1, NULL },
- { "Yb", 7, NULL },
- { "Lu", 2, NULL },
- { "Hf", 6, NULL },
- { "Ta", 2, NULL },
- { "W" , 5, NULL },
- { "Re", 2, NULL },
- { "Os", 7, NULL },
- { "Ir", 2, NULL },
- { "Pt", 5, NULL },
- { "Au", 1, NULL },
- { "Hg", 7, NULL },
- { "Tl", 2, NULL },
- { "Pb", 4, NULL },
- { "Bi", 1, NULL },
- { "Po", 1, NULL },
- { "At", 1, NULL },
- { "Rn", 1, NULL },
- { "Fr", 1, NULL },
- { "Ra", 1, NULL },
- { "Ac", 1, NULL },
- { "Th", 1, NULL },
- { "Pa", 1, NULL },
- { "U" , 3, NULL },
- { "Np", 1, NULL },
- { "Pu", 1, NULL },
-
-	};
-
-isotope iso[] =
-{
-{  1,  .999885   /* H */ },
-{  2,  .000115 },
-{  2, 1.0 /* D */ },
-{  3,  .00000134  /* He */ },
-{  4,  .99999866   },
-{  6,  .0759    /* Li */ },
-{  7,  .9241 },
-{  9,  1.00     /* Be */ },
-{ 10,  .199     /* B */ },
-{ 11,  .801 },
-{ 12,  .9893   /* C */ },
-{ 13,  .0107 },
-{ 13, 1.0 /* 13C */ },
-{ 14,  .99636   /* N */ },
-{ 15,  .00364 },
-{ 15, 1.0 /* 15N */},
-{ 16,  .99757   /* O */ },
-{ 17,  .00038 },
-{ 18,  .00205 },
-{ 19,  1.00     /* F */ },
-{ 20,  .9048    /* Ne */ },
-{ 21,  .0027 },
-{ 22,  .0925 },
-{ 23,  1.00     /* Na */ },
-{ 24,  .7899    /* Mg */ },
-{ 25,  .1000 },
-{ 26,  .1101 },
-{ 27,  1.00     /* Al */ },
-{ 28,  .92223    /* Si */ },
-{ 29,  .04685 },
-{ 30,  .03092 },
-{ 31,  1.00     /* P */ },
-{ 32,  .9499     /* S */ },
-{ 33,  .0075 },
-{ 34,  .0425 },
-{ 36,  .0001 },
-{ 35,  .7576   /* Cl */ },
-{ 37,  .2424 },
-{ 36,  .003365   /* Ar */ },
-{ 38,  .000632 },
-{ 40,  .996003 },
-{ 39,  .932581    /* K */ },
-{ 40,  .000117 },
-{ 41,  .067302 },
-{ 40,  .96941    /* Ca */ },
-{ 42,  .00647 },
-{ 43,  .00135 },
-{ 44,  .02086 },
-{ 46,  .00004 },
-{ 48,  .00187 },
-{ 45,  1.00     /* Sc */ },
-{ 46,  .0825    /* Ti */ },
-{ 47,  .0744 },
-{ 48,  .7372 },
-{ 49,  .0541 },
-{ 50,  .0518 },
-{ 50,  .00250    /* V */ },
-{ 51,  .99750 },
-{ 50,  .04345    /* Cr */ },
-{ 52,  .83789 },
-{ 53,  .09501 },
-{ 54,  .02365 },
-{ 55,  1.00     /* Mn */ },
-{ 54,  .05845    /* Fe */ },
-{ 56,  .91754 },
-{ 57,  .02119 },
-{ 58 , .00282 },
-{ 59,  1.00     /* Co */ },
-{ 58,  .680769    /* Ni */ },
-{ 60,  .262231 },
-{ 61,  .011399 },
-{ 62,  .036345 },
-{ 64,  .009256 },
-{ 63,  .6915,    /* Cu */ },
-{ 65,  .3085 },
-{ 64,  .48268    /* Zn */ },
-{ 66,  .27975 },
-{ 67,  .04102 },
-{ 68,  .19024 },
-{ 70,  .00631 },
-{ 69,  .60108     /* Ga */ },
-{ 71,  .39892 },
-{ 70,  .2038    /*Ge */ },
-{ 72,  .2731 },
-{ 73,  .0776 },
-{ 74,  .3672 },
-{ 76,  .0783 },
-{ 75,  1.00     /* As */ },
-{ 74,  .0089    /* Se */ },
-{ 76,  .0937 },
-{ 77,  .0763 },
-{ 78,  .2377 },
-{ 80,  .4961 },
-{ 82,  .0873 },
-{ 79,  .5069    /* Br */ },
-{ 81,  .4931 },
-{ 78,  .00355    /* Kr */ },
-{ 80,  .02286 },
-{ 82,  .11593 },
-{ 83,  .11500 },
-{ 84,  .56987 },
-{ 86,  .17279 },
-{ 85,  .7217    /* Rb */ },
-{ 87,  .2783  },
-{ 84,  .0056    /* Sr */ },
-{ 86,  .0986 },
-{ 87,  .0700 },
-{ 88,  .8258   },
-{ 89,  1.00     /* Y */ },
-{ 90,  .5145    /* Zr */ },
-{ 91,  .1122 },
-{ 92,  .1715 },
-{ 94,  .1738 },
-{ 96,  .0280 },
-{ 93,  1.00     /* Nb */ },
-{ 92,  .1477    /* Mo */ },
-{ 94,  .0923 },
-{ 95,  .1590 },
-{ 96,  .1668 },
-{ 97,  .0956 },
-{ 98,  .2419 },
-{100,  .0967 },
-{ 98,  1.00     /* Tc */ },
-{ 96,  .0554    /* Ru */ },
-{ 98,  .0187 },
-{ 99,  .1276 },
-{100,  .1260 },
-{101,  .1706 },
-{102,  .3155 },
-{104,  .1862 },
-{103,  1.00     /* Rh */ },
-{102,  .0102    /* Pd */ },
-{104,  .1114 },
-{105,  .2233 },
-{106,  .2733 },
-{108,  .2646 },
-{109,  .1172 },
-{107,  .51839    /* Ag */ },
-{109,  .48161 },
-{106,  .0125    /* Cd */ },
-{108,  .0089 },
-{110,  .1249 },
-{111,  .1280 },
-{112,  .2413 },
-{113,  .1222 },
-{114,  .2873 },
-{116,  .0749 },
-{113,  .0429    /* In */ },
-{115,  .9571 },
-{112,  .0097    /* Sn */ },
-{114,  .0066 },
-{115,  .0034 },
-{116,  .1454 },
-{117,  .0768 },
-{118,  .2422 },
-{119,  .0859 },
-{120,  .3258 },
-{122,  .0463               },
-{124,  .0579 },
-{121,  .5721    /* Sb */ },
-{123,  .4279 },
-{120,  .0009   /* Te */ },
-{122,  .0255 },
-{123,  .0089 },
-{124,  .0474 },
-{125,  .0707 },
-{126,  .1884 },
-{128,  .3174 },
-{130,  .3408 },
-{127,  1.00     /* I */ },
-{124,  .000952    /* Xe */ },
-{126,  .000890 },
-{128,  .019102 },
-{129,  .264006 },
-{130,  .040710 },
-{131,  .212324 },
-{132,  .269086 },
-{134,  .104357 },
-{136,  .088573 },
-{133,  1.00     /* Cs */ },
-{130,  .00106   /* Ba */ },
-{132,  .00101 },
-{134,  .02417 },
-{135,  .06592 },
-{136,  .07854 },
-{137,  .11232 },
-{138,  .71698 },
-{138,  .00090   /* La */ },
-{139,  .99910 },
-{136,  .00185   /* Ce */ },
-{138,  .00251 },
-{140,  .88450 },
-{142,  .11114 },
-{141,  1.00     /* Pr */ },
-{142,  .272    /* Nd */ },
-{143,  .122 },
-{144,  .238 },
-{145,  .083 },
-{146,  .172 },
-{148,  .057 },
-{150,  .056 },
-{145,  1.00     /* Pm */ },
-{144,  .0307    /* Sm */ },
-{147,  .1499 },
-{148,  .1124 },
-{149,  .1382 },
-{150,  .0738 },
-{152,  .2675 },
-{154,  .2275 },
-{151,  .4781    /* Eu */ },
-{153,  .5219 },
-{152,  .0020    /* Gd */ },
-{154,  .0218 },
-{155,  .1480 },
-{156,  .2047 },
-{157,  .1565 },
-{158,  .2484 },
-{160,  .2186 },
-{159,  1.00     /* Tb */ },
-{156,  .00056    /* Dy */ },
-{158,  .00095 },
-{160,  .02329 },
-{161,  .18889 },
-{162,  .25475 },
-{163,  .24896 },
-{164,  .28260 },
-{165,  1.00     /* Ho */ },
-{162,  .00139     /* Er */ },
-{164,  .01601 },
-{166,  .33503 },
-{167,  .22869 },
-{168,  .26978 },
-{170,  .14910 },
-{169,  1.00     /* Tm */ },
-{168,  .0013    /* Yb */ },
-{170,  .0304 },
-{171,  .1428 },
-{172,  .2183 },
-{173,  .1613 },
-{174,  .3183 },
-{176,  .1276 },
-{175,  .9741     /* Lu */ },
-{176,  .0259 },
-{174,  .0016    /* Hf */ },
-{176,  .0526 },
-{177,  .1860 },
-{178,  .2728 },
-{179,  .1362 },
-{180,  .3508 },
-{180,  .00012  /* Ta */ },
-{181,  .99988 },
-{180,  .0012    /* W */ },
-{182,  .2650 },
-{183,  .1431 },
-{184,  .3064 },
-{186,  .2843 },
-{185,  .3740    /* Re */ },
-{187,  .6260 },
-{184,  .0002   /* Os */ },
-{186,  .0159 },
-{187,  .0196 },
-{188,  .1324 },
-{189,  .1615 },
-{190,  .2626 },
-{192,  .4078 },
-{191,  .373     /* Ir */ },
-{193,  .627 },
-{190,  .00014,  /* Pt */ },
-{192,  .00782 },
-{194,  .32967 },
-{195,  .33832 },
-{196,  .25242 },
-{198,  .07163 },
-{197,  1.00     /* Au */ },
-{196,  .0015   /* Hg */ },
-{198,  .0997 },
-{199,  .1687 },
-{200,  .2310 },
-{201,  .1318 },
-{202,  .2986 },
-{204,  .0687 },
-{203,  .2952     /* Tl */ },
-{205,  .7048 },
-{204,  .014,    /* Pb */ },
-{206,  .241 },
-{207,  .221 },
-{208,  .524 },
-{209,  1.00     /* Bi */ },
-{209,  1.00     /* Po */ },
-{210,  1.00     /* At */ },
-{222,  1.00     /* Rn */ },
-{223,  1.00     /* Fr */ },
-{226,  1.00     /* Ra */ },
-{227,  1.00     /* Ac */ },
-{231,  1.00     /* Pa */ },
-{234,  .000054    /* U */ },
-{235,  .007204 },
-{238,  .992742 },
-{237,  1.00      /* Np */ },
-{244,  1.00      /* Pu */ },
-};
-
-#define ADDBASE 100        /* above the natural elements */
-#define MAXADD 10          /* space for user-defined 'elements' */
-#define MAXAT  50
-
-element	addel[MAXADD];      	/* e.g. isotope enriched ones, etc. */
-isotope	addiso[5 * MAXADD];
-atom	atoms[MAXAT];    	/* up to MAXAT different atoms in one formula */
-int 	natoms;                 /* number of atoms */
-int 	eadd=0, iadd=0;        	/* added elements & isotopes */
-
-int nel = sizeof(el) / sizeof(element);
-int niso = sizeof(iso) / sizeof(isotope);
+/* --- user-defined elements, only changed by addelement() --- */
+
+isotable usertab;
 
 /* --- some variables needed for reading the cmd line --- */
 
@@ -533,27 +136,21 @@ FILE *isotopefile;
 
 /* --- Function prototypes --- */
 
-void 	setpointers (void);
 void 	addelement(void);
 int 	squob(char *s);
-void 	foutput(int a, int n);
-isotope	imin(int atno);
-isotope	imax(int atno);
-int 	atno(char *s);
-int 	formula(char *in);
+int 	batch(char *inname, char *outname, int nthreads, int binary, int fraction);
+int 	parsebench(char *inname);
+int 	ncores(void);
 int     getopt(int argc, char *argv[], char *optionS);
 
-void setpointers (void)      /* set pointers in el entries to start of isotopes */
-{                            /* for that element in the iso table */
-int i;
-isotope *p;
 
-p = iso;
-for (i = 0;  i < nel;  i++)
-	{
-	el[i].p = p;
-	p += el[i].niso;
-	}
+int ncores(void)		/* no. of CPU cores, for the default no. of threads */
+{
+#ifdef __linux__
+return get_nprocs();
+#else
+return 1;
+#endif
 }
 
 
@@ -571,166 +168,18 @@ return(j);
 }
 
 
-void foutput(int oz, int nr)
-{
-atoms[natoms].atno = oz;		/* Ordnungszahl */
-atoms[natoms].count = nr;		/* No. of atoms of this element */
-natoms++;
-if (natoms >= MAXAT)
-	{
-	printf("Formula too long\n");
-	exit(1);
-	}
-}
-
-
-isotope imin(int atno)        /* isotope of lowest mass of element atno */
-{
-if (atno < ADDBASE)
-      return (*(el[atno-1].p));  /* element 1 is in table entry 0, etc. */
-else return(*(addel[atno-ADDBASE].p));
-}
-
-
-isotope imax(int atno)        /* isotope of highest mass of element atno */
-{
-if (atno < ADDBASE)
-      return( *(el[atno - 1].p + el[atno -1].niso - 1));
-else return(*(addel[atno-ADDBASE].p + addel[atno -ADDBASE].niso - 1));
-}
-
-
-int atno(char *str)  			/* return atom # or 0 if str not valid element symbol */
-{
-int i;
-
-for (i = 0;  i < nel;  i++)             /* try natural elements first */
-    if (0 == strcmp(el[i].sym, str))	/* if symbol is found in elem. table */
-	return(i + 1);			/* return correct atom number */
-
-for (i = 0;  i < eadd;  i++)		/* try 'user-def.' elements */
-    if (0 == strcmp(addel[i].sym, str))	/* if symbol is found in 'user-def.'elem. table */
-	return(i + ADDBASE);            /* return a high 'atomic #' on user-defined elements */
-
-return 0;				/* this is 'else' */
-}
-
-
-int formula(char *in)
-/* Determine if input is valid formula. Set composition in table *atoms.
-   return 1 if OK, 0 if not call foutput() */
+void addelement(void)            /* user-defined element */
 {
-int 	a, n,      /* to handle (element, count) pairs. a is El.No., n is the number */
-	state;     /* number of chars read */
-char 	ch, buf[3];
-
-state = a = n= 0;				/* here, no char was read */
-
-while(0 != (ch = *(in++)))		/* while not end of string */
-	{
-	if (ch == '\n' || ch == '\r')	/* junk at end from fgets ? */
-		continue;
-	switch(state)
-		{
-		case 0:
-		    if(isupper(ch))		/* uppercase letter ? */
-			    {
-			    buf[0] = ch;		/* take first char of element symbol */
-			    buf[1] = 0;			/* ASCII zero to terminate string */
-			    state = 1;			/* i.e. 1st char was read */
-			    }
-		    else
-			goto error;
-		    break;
-
-		case 1:
-		    if (isdigit(ch))			/* is it a number ? */
-			    {
-			    if(0 == (a = atno(buf)))	/* if NOT an element */
-				goto error;
-			    n = ch - '0';		/* just like 'atoi()' */
-			    state = 2;			/* 2nd char was read */
-			    }
-		    else if(islower(ch))
-			    {
-			    buf[1] = ch;       	 	/* take char as 2nd letter */
-			    buf[2] = 0;			/* terminate string */
-			    if(0 == (a = atno(buf)))	/* see above */
-				goto error;
-			    state = 3;
-			    }
-		    else if(isupper(ch))
-			    {
-			    if(0 == (a = atno(buf)))	/* see above */
-				goto error;
-			    n = 1;                      /* 1st char read */
-			    foutput(a, n);
-			    buf[0] = ch;		/* take first char of element symbol */
-			    buf[1] = 0;			/* ASCII zero to terminate string */
-			    state = 1;			/* i.e. 1st char was read */
-			    }
-		    else
-			goto error;
-		    break;
-
-		case 2:
-		    if (isdigit(ch))                    /* is it a number */
-			n = 10 * n + ch - '0';		/* YES -> get value (tens) */
-		    else if(isupper(ch))
-			    {
-			    foutput(a, n);
-			    buf[0] = ch;		/* take first char of element symbol */
-			    buf[1] = 0;			/* ASCII zero to terminate string */
-			    state = 1;			/* i.e. 1st char was read */
-			    }
-		    else
-			goto error;
-		    break;
-
-		case 3:
-		    if (isdigit(ch))      		/* is it a number */
-			{				/* YES */
-			n = ch - '0';			/* get value */
-			state = 2;
-			}
-		    else if (isupper(ch))
-			{
-			if(0 == (a = atno(buf)))
-				goto error;
-			n = 1;
-			foutput(a, n);
-			buf[0] = ch;			/* take first char of element symbol */
-			buf[1] = 0;			/* ASCII zero to terminate string */
-			state = 1;			/* i.e. 1st char was read */
-			}
-		    else
-			goto error;
-		    break;
-
-		}  /* end of case */
-	}          /* end of while */
+int i, j, k, niso, m[5 * MAXADD];
+float f, sumpc, fr[5 * MAXADD];
+char buf1[81], buf2[81], *p;
 
-if (state == 1 || state == 3) n = 1;
-if (state != 0)
+if (usertab.eadd >= MAXADD)
 	{
-	if(0 == (a = atno(buf))) goto error;
-	foutput(a, n);
-	return(1);
+	printf("%s\n\n", iso_strerror(ISO_EFULL));
+	return;
 	}
 
-error:
-	printf("Bad formula\n\n");
-	return(0);
-}
-
-
-
-void addelement(void)            /* user-defined element */
-{
-int i, j, k, first;
-float f, sumpc;
-char buf1[81], buf2[81], *p;
-
 while(1)
 	{
 	printf("Enter symbol for element: ");
@@ -745,20 +194,15 @@ while(1)
 		printf("Bad symbol\n\n");
 		continue;
 		}
-	if(0 == atno(buf1))     /* not already known symbol */
-		{
-		addel[eadd].sym = (char *)malloc(3);
-		strcpy(addel[eadd].sym, buf1);
+	if(0 == iso_atno(&usertab, buf1))     /* not already known symbol */
 		break;
-		}
 	printf("This symbol is already in use.\n\n");
 	}
 printf("\nEnter mass - percent abundance pairs, one pair per line, with space between.\n");
 printf("Enter an empty line to finish.\n");
 
 startiso:
-    addel[eadd].niso = 0;
-    first = 1;
+    niso = 0;
     sumpc = 0.0;
     while(1)
 	{
@@ -782,10 +226,15 @@ startiso:
 			else goto startiso;
 			}
 		}
+	if (usertab.iadd + niso >= 5 * MAXADD)
+		{
+		printf("%s\n", iso_strerror(ISO_EFULL));
+		break;
+		}
 	j = strtol(buf1, &p, 10);
 
 	if (j > 0 && j < 300)
-		addiso[iadd].m = j;
+		m[niso] = j;
 	else if(j <= 0)
 		{
 		printf("Negative or zero mass. Re-enter line.");
@@ -798,13 +247,13 @@ startiso:
 		k = buf2[0];
 		if (k != 'y' && k != 'Y')
 			continue;
-		addiso[iadd].m = j;
+		m[niso] = j;
 		}
 
 	f = atof(p);
 	if (f > 0 && f <= 100)
 		{
-		addiso[iadd].fr = f / 100;
+		fr[niso] = f / 100;
 		sumpc += f;
 		}
 	else
@@ -812,40 +261,309 @@ startiso:
 		printf("Impossible percentage. Re-enter line\n");
 		continue;
 		}
+	niso++;
+   }
+if (niso > 0)
+	iso_addelement(&usertab, buf1, m, fr, niso);
+}
+
+
+/* --- BATCH MODE --- (rw)
+   Formulas are read in chunks, parsed and computed by worker threads
+   (see SMISOTOPE.H), and the chunk is then written in input order, one
+   tagged record per formula. Nothing is written to a fixed path. A
+   line longer than 79 characters is one record with status
+   ISO_ETOOLONG ("Formula too long"), its start as formula.
+
+   Binary records ('-r'): the stream starts with the 4 bytes "SMI1", then
+   per formula: int32 id, int32 status, int32 nominal mass of TM0,
+   float TM0..TM3, int32 length of formula, formula (no terminating 0).
+   Host byte order. The status is the ISO_E* code of SMISOTOPE.H.
+*/
+
+#define BATCHSIZE  4096		/* formulas per chunk */
+#define MAXTHREADS 64
+
+typedef struct {
+	long	id;		/* line no. in input, used as tag */
+	char	text[81];	/* formula as read */
+	int	status;		/* ISO_OK or error code */
+	int	mass;		/* nominal mass of TM0 */
+	float	tm[4];		/* TM0...TM3, scaled like the screen output */
+	} batchjob;
+
+typedef struct {
+	batchjob	*jobs;
+	int		njobs;
+	int		next;		/* next job to be taken */
+	int		fraction;
+	pthread_mutex_t	lock;
+	} batchqueue;
+
+
+void *batchworker(void *arg)
+{
+batchqueue *bq = (batchqueue *)arg;
+batchjob *job;
+atom at[MAXAT];
+peak tm[4];
+int i, n, nat, ii;
+
+while (1)
+	{
+	pthread_mutex_lock(&bq->lock);
+	i = bq->next++;
+	pthread_mutex_unlock(&bq->lock);
+	if (i >= bq->njobs)
+		return NULL;
+
+	job = bq->jobs + i;
+	if (job->status != ISO_OK)		/* line too long */
+		continue;
+	job->status = iso_formula(&usertab, job->text, at, MAXAT, &nat);
+	if (job->status == ISO_OK)
+		job->status = iso_pattern(&usertab, at, nat,
+				bq->fraction ? ISO_FRACTION : 0, tm, 4, &n);
+	if (job->status != ISO_OK)
+		continue;
+
+	job->mass = tm[0].mass;
+	for (ii = 0;  ii < 4 && ii < n;  ii++)
+		job->tm[ii] = bq->fraction ? tm[ii].intens : tm[ii].intens * 100;
+	}
+}
 
-	addel[eadd].niso++;
-	if(first)
+
+void batchwrite(FILE *out, batchjob *job, int binary)
+{
+int hdr[3], len;
+
+if (binary)
+	{
+	hdr[0] = (int)job->id;
+	hdr[1] = job->status;
+	hdr[2] = job->mass;
+	len = strlen(job->text);
+	fwrite(hdr, sizeof(int), 3, out);
+	fwrite(job->tm, sizeof(float), 4, out);
+	fwrite(&len, sizeof(int), 1, out);
+	fwrite(job->text, 1, len, out);
+	}
+else
+	fprintf(out, "%ld;%s;%d;%.10f;%.10f;%.10f;%.10f;%s\n", job->id, job->text,
+		job->mass, job->tm[0], job->tm[1], job->tm[2], job->tm[3],
+		job->status == ISO_OK ? "ok" : iso_strerror(job->status));
+}
+
+
+/***************************************************************************
+* BATCH:	Calculates TM0...TM3 for all formulas of a file, in parallel.	   *
+* Input: 	input file ('-' = stdin), output file (NULL = stdout),	   *
+*		no. of threads (0 = one per core), output flags.		   *
+* Returns:	0 if OK, 1 if error.					   *
+****************************************************************************/
+int batch(char *inname, char *outname, int nthreads, int binary, int fraction)
+{
+FILE *in, *out;
+char buf[81];
+batchjob *jobs, *job;
+batchqueue bq;
+pthread_t tid[MAXTHREADS];
+long line;
+int i, k, c, eof, extra;
+
+if (nthreads <= 0)
+	nthreads = ncores();
+if (nthreads > MAXTHREADS)
+	nthreads = MAXTHREADS;
+
+in = (0 == strcmp(inname, "-")) ? stdin : fopen(inname, "r");
+if (in == NULL)
+	{
+	fprintf(stderr, "Error: Cannot open %s.\n", inname);
+	return 1;
+	}
+out = (outname == NULL) ? stdout : fopen(outname, binary ? "wb" : "w");
+if (out == NULL)
+	{
+	fprintf(stderr, "Error: Cannot open %s.\n", outname);
+	return 1;
+	}
+jobs = (batchjob *)malloc(BATCHSIZE * sizeof(batchjob));
+if (jobs == NULL)
+	{
+	fprintf(stderr, "Error: %s\n", iso_strerror(ISO_ENOMEM));
+	return 1;
+	}
+
+if (binary)
+	fwrite("SMI1", 1, 4, out);
+else
+	fprintf(out, "ID;Formula;Mass;TM0;TM1;TM2;TM3;Status\n");
+
+pthread_mutex_init(&bq.lock, NULL);
+bq.jobs = jobs;
+bq.fraction = fraction;
+line = 0;
+eof = 0;
+
+while (!eof)
+	{
+	bq.njobs = 0;			/* read one chunk */
+	while (bq.njobs < BATCHSIZE)
 		{
-		addel[eadd].p = addiso + iadd;
-		first = 0;
+		if (NULL == fgets(buf, 80, in))
+			{
+			eof = 1;
+			break;
+			}
+		line++;
+		buf[80] = 0;
+		extra = 0;			/* rest of a line longer than buf */
+		if (strchr(buf, '\n') == NULL)
+			while (((c = getc(in)) != EOF) && (c != '\n'))
+				if (c != '\r')
+					extra++;
+		squob(buf);
+		for (k = 0;  buf[k];  k++)		/* stop at CR or LF */
+			if (buf[k] == '\n' || buf[k] == '\r')
+				{
+				buf[k] = 0;
+				break;
+				}
+		if (buf[0] == 0 || buf[0] == ';')	/* empty or comment line */
+			continue;
+		if ((buf[0] == 'q' || buf[0] == 'Q') && buf[1] == 0)
+			{
+			eof = 1;
+			break;
+			}
+
+		job = jobs + bq.njobs++;
+		job->id = line;
+		strcpy(job->text, buf);		/* its start, if too long */
+		job->status = extra ? ISO_ETOOLONG : ISO_OK;
+		job->mass = 0;
+		job->tm[0] = job->tm[1] = job->tm[2] = job->tm[3] = 0;
 		}
-	iadd++;
-   }
-eadd++;
+
+	bq.next = 0;			/* compute it */
+	for (i = 0;  i < nthreads;  i++)
+		pthread_create(&tid[i], NULL, batchworker, &bq);
+	for (i = 0;  i < nthreads;  i++)
+		pthread_join(tid[i], NULL);
+
+	for (i = 0;  i < bq.njobs;  i++)	/* stream it out */
+		batchwrite(out, jobs + i, binary);
+	fflush(out);
+	}
+
+pthread_mutex_destroy(&bq.lock);
+free(jobs);
+if (in != stdin)
+	fclose(in);
+if (out != stdout)
+	fclose(out);
+return 0;
 }
 
 
+/***************************************************************************
+* PARSEBENCH:	Measures the throughput of the formula parser.		   *
+* Input: 	file of formulas, one per line ('-' = stdin).		   *
+* Returns:	0 if OK, 1 if error. The result goes to stdout.		   *
+* Note:		All formulas are read first, then parsed repeatedly for	   *
+*		at least one second; only iso_counts() is timed.	   *
+****************************************************************************/
+int parsebench(char *inname)
+{
+FILE *in;
+char buf[256], *text, *p;
+long n, nbad, size, len, used, rounds, i;
+int counts[ISO_NCOUNTS];
+struct timespec t0, t1;
+double secs;
+
+in = (0 == strcmp(inname, "-")) ? stdin : fopen(inname, "r");
+if (in == NULL)
+	{
+	fprintf(stderr, "Error: Cannot open %s.\n", inname);
+	return 1;
+	}
+
+size = 1 << 20;			/* all formulas, 0-terminated, in a row */
+used = n = 0;
+text = (char *)malloc(size);
+while (text != NULL && fgets(buf, sizeof(buf), in))
+	{
+	buf[strcspn(buf, "\r\n")] = 0;
+	if (buf[0] == 0 || buf[0] == ';')
+		continue;
+	len = strlen(buf) + 1;
+	if (used + len > size)
+		text = (char *)realloc(text, size *= 2);
+	if (text != NULL)
+		memcpy(text + used, buf, len);
+	used += len;
+	n++;
+	}
+if (in != stdin)
+	fclose(in);
+if (text == NULL)
+	{
+	fprintf(stderr, "Error: %s\n", iso_strerror(ISO_ENOMEM));
+	return 1;
+	}
+
+rounds = nbad = 0;
+clock_gettime(CLOCK_MONOTONIC, &t0);
+do	{
+	for (i = 0, p = text;  i < n;  i++, p += strlen(p) + 1)
+		{
+		memset(counts, 0, sizeof(counts));
+		if (iso_counts(&usertab, p, counts, ISO_NCOUNTS) != ISO_OK && rounds == 0)
+			nbad++;
+		}
+	rounds++;
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	secs = (t1.tv_sec - t0.tv_sec) + 1e-9 * (t1.tv_nsec - t0.tv_nsec);
+	} while (secs < 1.0 && n > 0);
+
+printf("%ld formulas (%ld bad), %ld bytes, %ld rounds in %.3f s: %.0f formulas/s, %.1f MB/s\n",
+	n, nbad, used, rounds, secs, n * rounds / secs, used * rounds / secs / 1e6);
+free(text);
+return 0;
+}
+
 
 int main (int argc, char *argv[])
 {
-int i, j, m, q, nold, nnew, oldmin, oldmax, newmin, newmax, ii, csvi, ix, fraction, ns, read_cmd, tmp;
+int ii, fraction, ns, read_cmd, tmp, nthreads, binary, err, parseonly;
 register int k;
-char buf[81], stars[71];
-float fr, maxintens, sumintens;
-isotope s;
-element e;
-peak *old, *new;
-register peak *pp;
+char buf[81], stars[71], *batchname, *outname;
+float maxintens;
+atom atoms[MAXAT];
+peak *new;
+int natoms, nnew;
 
 static char *id =
 "isotope version %s. Copyright (C) by Joerg Hau 1996...2005, modified by Robert Winkler (RW) 2014 \n";
 
 static char *msg =
-"\nusage: isotope [-h] [-v] [-f] [formula]\n\nValid command line options are:\n"
+"\nusage: isotope [-h] [-v] [-f] [formula]\n"
+"       isotope [-f] [-r] [-j n] [-o outfile] -b infile\n"
+"       isotope -p -b infile\n\nValid command line options are:\n"
 "    -h       This Help screen.\n"
 "    -v       Display version information.\n"
 "    -f       Print fractional intensities (default: scaled to 100%).\n"
-"    formula  Chemical formula, e.g. 'C12H11O11'. 2H=D, 13C=C, 15N=M.\n";
+"    -b file  Batch mode: one formula per line from 'file' ('-' = stdin),\n"
+"             one record ID;Formula;Mass;TM0;TM1;TM2;TM3;Status per formula.\n"
+"    -o file  Write batch records to 'file' (default: stdout).\n"
+"    -j n     Use n threads in batch mode (default: one per core).\n"
+"    -r       Write batch records in binary format.\n"
+"    -p       Only parse the batch input and print the parser throughput.\n"
+"    formula  Chemical formula, e.g. 'C12H11O11', 'Ni(CO)4', 'CuSO4.5H2O'.\n"
+"             2H=D, 13C=X, 15N=M.\n";
 
 static char *disclaimer =
 "\nThis program is free software; you can redistribute it and/or modify it under\n"
@@ -857,13 +575,14 @@ static char *disclaimer =
 
 fraction = 0;   /* normalize to 100 max, or print fractions on -f cmd switch */
 read_cmd = 0;   /* != 0 if formula is read via cmd line */
-setpointers();
-nnew = 0;
-new = NULL;
+batchname = outname = NULL;
+nthreads = 0;	/* 0 = one thread per core */
+binary = 0;
+parseonly = 0;
 
 /* decode and read the command line */
 
-while ((tmp = getopt(argc, argv, "hvf")) != EOF)
+while ((tmp = getopt(argc, argv, "hvfrpb:o:j:")) != EOF)
 	switch (tmp)
 		{
 		case 'h':     	  		/* help me */
@@ -877,12 +596,32 @@ while ((tmp = getopt(argc, argv, "hvf")) != EOF)
 		case 'f':    			/* print fractional intensities */
 			fraction = 1;
 			continue;
+		case 'b':			/* batch input */
+			batchname = optarg;
+			continue;
+		case 'o':			/* batch output */
+			outname = optarg;
+			continue;
+		case 'j':			/* no. of threads */
+			nthreads = atoi(optarg);
+			continue;
+		case 'r':			/* binary batch records */
+			binary = 1;
+			continue;
+		case 'p':			/* parser benchmark */
+			parseonly = 1;
+			continue;
 		case '~':    	  	/* invalid arg */
 		default:
 			printf ("'%s -h' for help.\n", argv[0]);
 			return 1;
 		}
 
+if (batchname != NULL && parseonly)
+	return parsebench(batchname);
+if (batchname != NULL)
+	return batch(batchname, outname, nthreads, binary, fraction);
+
 if (argv[optind] != NULL)	 /* remaining parameter on cmd line? */
     {
 	strcpy(buf, argv[optind]);     /* read it */
@@ -893,7 +632,7 @@ while(1)
 	{
     if (!read_cmd)          /* if NOT read via cmd line, use interactive mode */
         {
-        printf("Enter a formula (no brackets). Q to quit, E to define an extra element.\n:");
+        printf("Enter a formula. Q to quit, E to define an extra element.\n:");
 	    fgets(buf, 80, stdin);				/* read line from stdin */
 	    buf[80] = 0;					/* terminate string */
         }
@@ -917,105 +656,32 @@ while(1)
 		continue;
 		}
 
-	natoms = 0;					/* init. */
-	k = formula(buf);
-	if (k == 0)                 /* problem ? */
+	err = iso_formula(&usertab, buf, atoms, MAXAT, &natoms);
+	if (err == ISO_OK)
+		{
+		new = (peak *)malloc(iso_maxpeaks(&usertab, atoms, natoms) * sizeof(peak));
+		err = (new == NULL) ? ISO_ENOMEM
+			: iso_pattern(&usertab, atoms, natoms, fraction ? ISO_FRACTION : 0,
+				new, iso_maxpeaks(&usertab, atoms, natoms), &nnew);
+		}
+	if (err != ISO_OK)                 /* problem ? */
         {
-        if (read_cmd)           /* if formula was read via cmd line, */
+        printf("%s\n\n", iso_strerror(err));
+        if (read_cmd || err == ISO_ENOMEM)  /* if formula was read via cmd line, */
             exit (1);           /* quit here */
         continue;
         }
 
-	old = (peak *)malloc(sizeof(peak));		/* init. */
-	old->mass = 0;
-	old->intens = 1;
-	nold = 1;
-	oldmin = oldmax = 0;
-
-	for (i = 0;  i < natoms;  i++)				/* for all elements */
-		{
-		for(j = 0;  j < atoms[i].count;  j++)		/* for all atoms of an element */
-			{
-			s = imin(atoms[i].atno);
-			newmin = oldmin + s.m;			/* min. mass */
-			s = imax(atoms[i].atno);
-			newmax = oldmax + s.m;			/* max. mass */
-			nnew = newmax - newmin + 1;		/* number */
-			new = (peak *)malloc(nnew * sizeof(peak));
-			if (new == NULL)
-				{
-				printf("\nOut of Memory!\n");
-				exit(1);
-				}
-			for (k = 0;  k < nnew;  k++)
-				new[k].intens = 0;		/* init. */
-
-			if (atoms[i].atno < ADDBASE)
-				e = el[atoms[i].atno - 1];
-			else
-				e = addel[atoms[i].atno - ADDBASE];
-				
-				
-			for (k = 0;  k < e.niso;  k++)          /* for all isotopes */
-				{
-				m = (k + e.p)->m;		/* mass */
-				fr = (k + e.p)->fr;		/* inty */
-				for (q = 0;  q < nold;  q++)
-					{
-					ix = m + old[q].mass - newmin;
-					new[ix].mass = m + old[q].mass;		/* shift mass */
-					new[ix].intens += fr * old[q].intens; 	/* add inty */
-					}
-				}	/* end of 'k' loop (isotopes) */
-
-		       /* normalize to maximum intensity of 1.0 */
-			maxintens = 0;
-			for (ii = 0;  ii < nnew;  ii++)
-				if (new[ii].intens > maxintens)		/* find max. value */
-					maxintens = new[ii].intens;
-			for(ii = 0;  ii < nnew;  ii++)
-					new[ii].intens /= maxintens;
-
-			/* throw away very small peaks */
-			for (ii = 0;  ii < nnew;  ii++)
-				{
-				if(new[ii].intens < CUTOFF)
-					{
-					for (k = ii, pp = new + ii;  k < nnew-1;  k++, pp++)
-						{
-						pp->mass = (pp+1)->mass;
-						pp->intens = (pp+1)->intens;   /* inner loop...*/
-						}                            /* avoid structure copy */
-					nnew--;
-					ii--;
-					}
-				}
-			free(old);
-			old = new;
-			nold = nnew;
-			oldmin = newmin;
-			oldmax = newmax;
-			}	/* end of 'j' loop (atoms) */
-	       }		/* end of 'i' loop (elements) */
-
-	maxintens = sumintens = 0;
+	maxintens = 0;
 	for (ii=0;  ii<nnew;  ii++)		/* find max. */
-		{
-		sumintens += new[ii].intens;
 		if (new[ii].intens > maxintens)
 			maxintens = new[ii].intens;
-		}
-	for (ii = 0;  ii < nnew;  ii++)		/* calculate fraction/percent */
+	if (!fraction)
 		{
-		if (fraction)
-			new[ii].intens /= sumintens;
-		else
+		for (ii = 0;  ii < nnew;  ii++)		/* calculate percent */
 			new[ii].intens *= 100;  /* they are already normalized to max=1 */
-		}
-	if (fraction)
-		maxintens /= sumintens;
-	else
 		maxintens *= 100;
+		}
 
 	
 	for(ii = 0;  ii < nnew;  ii++)
@@ -1034,7 +700,7 @@ while(1)
 	
 	for(ii = 0;  ii < 4;  ii++) //RW
 		{
-		fprintf(isotopefile,"%.10f;",new[ii].intens); //RW write intensities to output file
+		fprintf(isotopefile,"%.10f;", ii < nnew ? new[ii].intens : 0.0); //RW write intensities to output file
 		}
 	fclose(isotopefile); //RW close the output file
 	
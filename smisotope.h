@@ -0,0 +1,123 @@
+/*
+
+SMISOTOPE.H
+
+ Reentrant library interface of the isotope pattern calculation of
+ SMISOTOPE.C. All state lives in the caller's buffers (and in an optional
+ table of user-defined elements), so the functions may be called from
+ several threads at once and from the formula generator (smformula).
+ Errors are returned as ISO_E* codes; nothing calls exit().
+
+ Copyright (c) 1996...2005 Joerg Hau, 2014 Robert Winkler.
+ Distributed under the terms of version 2 of the GNU General Public
+ License, see SMISOTOPE.C.
+
+*/
+
+#ifndef SMISOTOPE_H
+#define SMISOTOPE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ADDBASE 100        /* above the natural elements */
+#define MAXADD 10          /* space for user-defined 'elements' */
+#define MAXAT  50          /* default max. no. of entries in one formula */
+#define ISO_NCOUNTS (ADDBASE + MAXADD)	/* size of a count vector indexed by atom # */
+
+/* --- error codes --- */
+
+#define ISO_OK		0
+#define ISO_EFORMULA	1	/* not a valid formula */
+#define ISO_ETOOLONG	2	/* more entries than the atom buffer holds */
+#define ISO_ENOMEM	3	/* out of memory */
+#define ISO_EELEMENT	4	/* unknown atom number */
+#define ISO_EFULL	5	/* no space left for user-defined elements */
+
+/* --- flags for iso_pattern() --- */
+
+#define ISO_FRACTION	1	/* normalize to sum = 1 (default: max. = 1) */
+
+typedef struct {int m; float fr; }                  isotope;    /* mass, abundance */
+typedef struct {char *sym; int niso;  isotope *p; } element;    /* symbol, no. of isotopes, ptr */
+typedef struct {int atno; int count; }              atom;
+typedef struct {int mass; float intens; }           peak;
+
+typedef struct {			/* user-defined 'elements', e.g. isotope enriched ones */
+	element	addel[MAXADD];
+	isotope	addiso[5 * MAXADD];
+	char	addsym[MAXADD][3];
+	int	eadd, iadd;		/* added elements & isotopes */
+	} isotable;
+
+/* Atom # of an element symbol, or 0 if 'sym' is not valid. User-defined
+   elements of 't' get numbers from ADDBASE on. 't' may be NULL. */
+int	iso_atno(const isotable *t, const char *sym);
+
+/* Parses 'in' and adds the no. of atoms of each element to counts[atom #],
+   which the caller clears; 'ncounts' is its size (ISO_NCOUNTS covers all
+   elements). Single pass, no allocation. Besides "CH3OH" it understands
+   brackets "Ni(CO)4", "[Cu(NH3)4]SO4", nested up to 16 deep, and hydrates
+   or other adducts with a coefficient, "CuSO4·5H2O" (also '.' or '*').
+   On error, counts[] may be partly filled. */
+int	iso_counts(const isotable *t, const char *in, int *counts, int ncounts);
+
+/* Like iso_counts(), but as at most 'maxatoms' (element, count) pairs,
+   one per element, in the order of atom numbers. */
+int	iso_formula(const isotable *t, const char *in, atom *atoms, int maxatoms, int *natoms);
+
+/* Upper bound of the no. of peaks of a composition, to size buffers. */
+int	iso_maxpeaks(const isotable *t, const atom *atoms, int natoms);
+
+/* Calculates the isotope pattern of a composition. At most 'maxpeaks'
+   peaks (lowest masses first) are written to 'out'; '*npeaks' is set to
+   the no. of peaks in the whole pattern, which may be larger. Intensities
+   are normalized to max. = 1, or to sum = 1 with ISO_FRACTION. */
+int	iso_pattern(const isotable *t, const atom *atoms, int natoms, int flags,
+		peak *out, int maxpeaks, int *npeaks);
+
+/* Adds a user-defined element with 'niso' isotopes (masses, abundances
+   as fractions) to 't'. */
+int	iso_addelement(isotable *t, const char *sym, const int *m, const float *fr, int niso);
+
+const char *iso_strerror(int err);
+
+
+/* --- closed-form M+1/M+2, for the first pass over many candidates ---
+
+   Relative to M0 (the peak of the lightest isotopes) and in the nominal
+   mass model of iso_pattern(), with a1, a2 = abundance of the isotope one
+   or two mass units above the lightest one, relative to the lightest:
+
+	M+1/M0 = sum n*a1
+	M+2/M0 = sum n*a2 + ((sum n*a1)^2 - sum n*a1^2) / 2
+
+   These are the exact first two terms of the multinomial expansion, so
+   the only differences to iso_pattern() are float rounding and the
+   peaks it drops below its cutoff. Against iso_pattern() on 10^5 random
+   CHNOPS/F/Cl/Br/Si/Na/D/X/M formulas up to 2000 Da, the error of both
+   M+1/M0 and M+2/M0 was below 1e-5 * max(1, M+k/M0), i.e. below 0.001
+   percentage points of M0 for anything without several Cl/Br. This holds
+   when the lightest isotope of every element is its most abundant one
+   (true for all elements of smformula); elements with a rare lightest
+   isotope (e.g. Se, Xe) are not covered.
+
+   The candidates are a column-major matrix: counts[e * ncand + j] is
+   the count of element e (atom # atnos[e]) in candidate j. */
+
+#define ISO_MAXCOL	32	/* max. no. of elements (columns) */
+
+typedef struct {
+	int	nelem;
+	float	a1[ISO_MAXCOL], a2[ISO_MAXCOL], a11[ISO_MAXCOL];
+	} isoapprox;
+
+int	iso_approx_init(const isotable *t, const int *atnos, int nelem, isoapprox *ap);
+void	iso_approx(const isoapprox *ap, const int *counts, int ncand, float *m1, float *m2);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,461 @@
+/*
+
+SMISOTOPE_LIB.C
+
+ Element and isotope tables and the isotope pattern calculation of
+ SMISOTOPE.C, as a reentrant library (see SMISOTOPE.H). The tables are
+ made from the database in SMISODB.H (generated by formulae/isotopes.py)
+ and only read after initialisation; parsed formulas, patterns and
+ user-defined elements live in the caller's buffers.
+
+ Copyright (c) 1996...2005 Joerg Hau <joerg.hau(at)dplanet.ch>,
+ modified by Robert Winkler, 2014, for integration in SpiderMass.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of version 2 of the GNU General Public
+ License as published by the Free Software Foundation. See the
+ file LICENSE for details.
+
+*/
+
+#define CUTOFF 1e-7
+
+#include <stdio.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <assert.h>
+#include "smisotope.h"
+#include "smisodb.h"
+
+/* --- element and isotope tables, from the database (smisodb.h) --- */
+
+static element el[] =
+{
+#define E(sym, c1, c2, atno, niso, first)	{ sym, niso, NULL },
+ISODB_ELEMENTS(E)
+#undef E
+};
+
+static isotope iso[] =
+{
+#define I(m, mass, fr)				{ m, fr },
+ISODB_ISOTOPES(I)
+#undef I
+};
+
+static int nel = sizeof(el) / sizeof(element);
+
+/* --- element symbols ---
+   A symbol is one uppercase letter and an optional lowercase one, so
+   SYMKEY() maps every possible symbol to its own slot of symtab[]: a
+   perfect hash, set up at compile time instead of a strcmp() over el[].
+   The entries are atom numbers (0 = no element) in the order of el[]. */
+
+#define SYMKEY(a, b)	(((a) - 'A') * 27 + ((b) ? (b) - 'a' + 1 : 0))
+#define NSYMKEY		(26 * 27)
+
+static const unsigned char symtab[NSYMKEY] =
+{
+#define E(sym, c1, c2, atno, niso, first)	[SYMKEY(c1, c2)] = atno,
+ISODB_ELEMENTS(E)
+#undef E
+};
+
+#define MAXTOKEN 256		/* (element, count) pairs pending inside brackets */
+#define MAXDEPTH 16		/* nesting of brackets */
+#define MAXCOUNT 1000000	/* per number, product and element total: no overflow */
+
+static pthread_once_t pointers_once = PTHREAD_ONCE_INIT;
+
+
+static void setpointers (void)  /* set pointers in el entries to start of isotopes */
+{                               /* for that element in the iso table */
+int i;
+isotope *p;
+
+p = iso;
+for (i = 0;  i < nel;  i++)
+	{
+	el[i].p = p;
+	p += el[i].niso;
+	assert(symtab[SYMKEY(el[i].sym[0], el[i].sym[1])] == i + 1);	/* see symtab[] */
+	}
+}
+
+
+/* isotopes of element atno, NULL if there is no such element */
+static const isotope *isotopes(const isotable *t, int atno, int *niso)
+{
+int i, off;
+
+pthread_once(&pointers_once, setpointers);
+if (atno >= 1 && atno <= nel)			/* element 1 is in table entry 0, etc. */
+	{
+	*niso = el[atno - 1].niso;
+	return el[atno - 1].p;
+	}
+if (t == NULL || atno < ADDBASE || atno >= ADDBASE + t->eadd)
+	return NULL;
+for (i = off = 0;  i < atno - ADDBASE;  i++)	/* user-def. isotopes are stored in a row */
+	off += t->addel[i].niso;
+*niso = t->addel[atno - ADDBASE].niso;
+return t->addiso + off;
+}
+
+
+
+int iso_atno(const isotable *t, const char *str)  /* return atom # or 0 if str not valid element symbol */
+{
+const unsigned char *s = (const unsigned char *)str;
+int i;
+
+if (isupper(s[0]) && (s[1] == 0 || (islower(s[1]) && s[2] == 0)))
+	if (symtab[SYMKEY(s[0], s[1])])		/* natural elements first */
+		return symtab[SYMKEY(s[0], s[1])];
+
+if (t != NULL)
+	for (i = 0;  i < t->eadd;  i++)		/* try 'user-def.' elements */
+	    if (0 == strcmp(t->addsym[i], str))	/* if symbol is found in 'user-def.'elem. table */
+		return(i + ADDBASE);            /* return a high 'atomic #' on user-defined elements */
+
+return 0;				/* this is 'else' */
+}
+
+
+static int number(const unsigned char **s, int dflt)	/* count after a symbol etc., -1 if too big */
+{
+int n;
+
+if (!isdigit(**s))
+	return dflt;
+for (n = 0;  isdigit(**s);  (*s)++)
+	{
+	n = 10 * n + **s - '0';
+	if (n > MAXCOUNT)
+		return -1;
+	}
+return n;
+}
+
+
+static int add_count(int *count, int n, int mult)	/* *count += n * mult, 0 if too big */
+{
+if (n > MAXCOUNT / (mult ? mult : 1))
+	return 0;
+n *= mult;
+if (*count > MAXCOUNT - n)
+	return 0;
+*count += n;
+return 1;
+}
+
+
+int iso_counts(const isotable *t, const char *in, int *counts, int ncounts)
+{
+const unsigned char *s = (const unsigned char *)in;
+atom tok[MAXTOKEN];		/* pending inside brackets */
+int grp[MAXDEPTH];		/* first token of each open bracket */
+char close[MAXDEPTH];		/* matching closing bracket */
+int ntok, depth, mult, nsym, a, n, i;
+char sym[3];
+
+ntok = depth = nsym = 0;
+if ((mult = number(&s, 1)) < 0)		/* leading coefficient, e.g. 2H2O */
+	return ISO_EFORMULA;
+
+while (*s)
+	{
+	if (isupper(*s))			/* element symbol and count */
+		{
+		sym[0] = *s++;
+		sym[1] = islower(*s) ? *s++ : 0;
+		sym[2] = 0;
+		if ((a = symtab[SYMKEY(sym[0], sym[1])]) == 0 && (a = iso_atno(t, sym)) == 0)
+			return ISO_EFORMULA;
+		if (a >= ncounts)
+			return ISO_EELEMENT;
+		if ((n = number(&s, 1)) < 0)
+			return ISO_EFORMULA;
+		nsym++;
+		if (depth == 0)
+			{
+			if (!add_count(&counts[a], n, mult))
+				return ISO_EFORMULA;
+			}
+		else if (ntok >= MAXTOKEN)
+			return ISO_ETOOLONG;
+		else
+			{
+			tok[ntok].atno = a;
+			tok[ntok].count = n;
+			ntok++;
+			}
+		}
+	else if (*s == '(' || *s == '[' || *s == '{')	/* open group */
+		{
+		if (depth >= MAXDEPTH)
+			return ISO_ETOOLONG;
+		close[depth] = (*s == '(') ? ')' : (*s == '[') ? ']' : '}';
+		grp[depth++] = ntok;
+		s++;
+		}
+	else if (*s == ')' || *s == ']' || *s == '}')	/* close group, multiply it */
+		{
+		if (depth == 0 || *s++ != close[--depth])
+			return ISO_EFORMULA;
+		if ((n = number(&s, 1)) < 0)
+			return ISO_EFORMULA;
+		for (i = grp[depth];  i < ntok;  i++)
+			{
+			if (tok[i].count > MAXCOUNT / (n ? n : 1))
+				return ISO_EFORMULA;
+			tok[i].count *= n;
+			}
+		if (depth == 0)
+			{
+			for (i = 0;  i < ntok;  i++)
+				if (!add_count(&counts[tok[i].atno], tok[i].count, mult))
+					return ISO_EFORMULA;
+			ntok = 0;
+			}
+		}
+	else if (*s == '.' || *s == '*' || (*s == 0xC2 && s[1] == 0xB7))	/* hydrate etc.: .nH2O */
+		{
+		if (depth != 0)
+			return ISO_EFORMULA;
+		s += (*s == 0xC2) ? 2 : 1;
+		if ((mult = number(&s, 1)) < 0)
+			return ISO_EFORMULA;
+		}
+	else if (*s == ' ' || *s == '\t' || *s == '\n' || *s == '\r')
+		s++;
+	else
+		return ISO_EFORMULA;
+	}
+
+if (depth != 0 || nsym == 0)
+	return ISO_EFORMULA;
+return ISO_OK;
+}
+
+
+int iso_formula(const isotable *t, const char *in, atom *atoms, int maxatoms, int *natoms)
+/* Determine if input is valid formula. Set composition in 'atoms'. */
+{
+int counts[ISO_NCOUNTS];
+int a, err;
+
+*natoms = 0;
+memset(counts, 0, sizeof(counts));
+if ((err = iso_counts(t, in, counts, ISO_NCOUNTS)) != ISO_OK)
+	return err;
+
+for (a = 1;  a < ISO_NCOUNTS;  a++)		/* one entry per element */
+	if (counts[a] > 0)
+		{
+		if (*natoms >= maxatoms)
+			return ISO_ETOOLONG;
+		atoms[*natoms].atno = a;
+		atoms[*natoms].count = counts[a];
+		(*natoms)++;
+		}
+return ISO_OK;
+}
+
+
+int iso_maxpeaks(const isotable *t, const atom *atoms, int natoms)
+{
+const isotope *p;
+int i, niso, n;
+
+n = 1;
+for (i = 0;  i < natoms;  i++)
+	if ((p = isotopes(t, atoms[i].atno, &niso)) != NULL)
+		n += atoms[i].count * (p[niso - 1].m - p[0].m);
+return n;
+}
+
+
+int iso_pattern(const isotable *t, const atom *atoms, int natoms, int flags,
+		peak *out, int maxpeaks, int *npeaks)
+{
+int i, j, k, m, q, nold, nnew, newmin, newmax, ii, ix, niso;
+float fr, maxintens, sumintens;
+const isotope *p;
+peak *old, *new;
+register peak *pp;
+
+*npeaks = 0;
+for (i = 0;  i < natoms;  i++)			/* check first, fail early */
+	if (isotopes(t, atoms[i].atno, &niso) == NULL)
+		return ISO_EELEMENT;
+
+old = (peak *)malloc(sizeof(peak));		/* init. */
+if (old == NULL)
+	return ISO_ENOMEM;
+old->mass = 0;
+old->intens = 1;
+nold = nnew = 1;
+new = old;
+
+for (i = 0;  i < natoms;  i++)				/* for all elements */
+	{
+	p = isotopes(t, atoms[i].atno, &niso);
+	for(j = 0;  j < atoms[i].count;  j++)		/* for all atoms of an element */
+		{
+		newmin = old[0].mass + p[0].m;		/* min. mass */
+		newmax = old[nold - 1].mass + p[niso - 1].m;	/* max. mass */
+		nnew = newmax - newmin + 1;		/* number */
+		new = (peak *)malloc(nnew * sizeof(peak));
+		if (new == NULL)
+			{
+			free(old);
+			return ISO_ENOMEM;
+			}
+		for (k = 0;  k < nnew;  k++)
+			{
+			new[k].mass = newmin + k;
+			new[k].intens = 0;		/* init. */
+			}
+
+		for (k = 0;  k < niso;  k++)          /* for all isotopes */
+			{
+			m = p[k].m;			/* mass */
+			fr = p[k].fr;			/* inty */
+			for (q = 0;  q < nold;  q++)
+				{
+				ix = m + old[q].mass - newmin;
+				new[ix].intens += fr * old[q].intens; 	/* add inty */
+				}
+			}	/* end of 'k' loop (isotopes) */
+
+	       /* normalize to maximum intensity of 1.0 */
+		maxintens = 0;
+		for (ii = 0;  ii < nnew;  ii++)
+			if (new[ii].intens > maxintens)		/* find max. value */
+				maxintens = new[ii].intens;
+		for(ii = 0;  ii < nnew;  ii++)
+				new[ii].intens /= maxintens;
+
+		/* throw away very small peaks */
+		for (ii = k = 0, pp = new;  ii < nnew;  ii++)
+			if (new[ii].intens >= CUTOFF)
+				pp[k++] = new[ii];
+		nnew = k;
+
+		free(old);
+		old = new;
+		nold = nnew;
+		}	/* end of 'j' loop (atoms) */
+       }		/* end of 'i' loop (elements) */
+
+if (flags & ISO_FRACTION)
+	{
+	sumintens = 0;
+	for (ii = 0;  ii < nnew;  ii++)
+		sumintens += new[ii].intens;
+	for (ii = 0;  ii < nnew;  ii++)
+		new[ii].intens /= sumintens;
+	}
+
+for (ii = 0;  ii < nnew && ii < maxpeaks;  ii++)
+	out[ii] = new[ii];
+*npeaks = nnew;
+free(new);
+return ISO_OK;
+}
+
+
+int iso_addelement(isotable *t, const char *sym, const int *m, const float *fr, int niso)
+{
+int i;
+
+if (t->eadd >= MAXADD || t->iadd + niso > 5 * MAXADD)
+	return ISO_EFULL;
+if (!isupper(sym[0]) || (sym[1] != 0 && (!islower(sym[1]) || sym[2] != 0)))
+	return ISO_EFORMULA;
+
+strcpy(t->addsym[t->eadd], sym);
+t->addel[t->eadd].sym = t->addsym[t->eadd];
+t->addel[t->eadd].niso = niso;
+t->addel[t->eadd].p = NULL;		/* see isotopes() */
+for (i = 0;  i < niso;  i++, t->iadd++)
+	{
+	t->addiso[t->iadd].m = m[i];
+	t->addiso[t->iadd].fr = fr[i];
+	}
+t->eadd++;
+return ISO_OK;
+}
+
+
+const char *iso_strerror(int err)
+{
+static const char *msg[] = {
+	"OK",
+	"Bad formula",
+	"Formula too long",
+	"Out of Memory!",
+	"Unknown element",
+	"No space left for another element",
+	};
+
+if (err < 0 || err >= (int)(sizeof(msg) / sizeof(msg[0])))
+	return "Unknown error";
+return msg[err];
+}
+
+
+/* --- closed-form M+1/M+2 (see iso_approx() in SMISOTOPE.H) --- */
+
+int iso_approx_init(const isotable *t, const int *atnos, int nelem, isoapprox *ap)
+{
+const isotope *p;
+int e, k, niso;
+
+if (nelem > ISO_MAXCOL)
+	return ISO_ETOOLONG;
+ap->nelem = nelem;
+for (e = 0;  e < nelem;  e++)
+	{
+	if ((p = isotopes(t, atnos[e], &niso)) == NULL)
+		return ISO_EELEMENT;
+	ap->a1[e] = ap->a2[e] = 0;		/* relative to the lightest isotope */
+	for (k = 1;  k < niso;  k++)
+		{
+		if (p[k].m == p[0].m + 1)
+			ap->a1[e] += p[k].fr / p[0].fr;
+		else if (p[k].m == p[0].m + 2)
+			ap->a2[e] += p[k].fr / p[0].fr;
+		}
+	ap->a11[e] = ap->a1[e] * ap->a1[e];
+	}
+return ISO_OK;
+}
+
+
+void iso_approx(const isoapprox *ap, const int *counts, int ncand, float *m1, float *m2)
+{
+const int *n;
+float a1, a2;
+int e, j;
+
+for (j = 0;  j < ncand;  j++)
+	m1[j] = m2[j] = 0;
+
+for (e = 0;  e < ap->nelem;  e++)	/* m1 = sum n*a1, m2 = sum n*(a2 - a1^2/2) for now */
+	{
+	n = counts + (long)e * ncand;
+	a1 = ap->a1[e];
+	a2 = ap->a2[e] - 0.5f * ap->a11[e];
+	for (j = 0;  j < ncand;  j++)	/* contiguous, no branches: vectorizes */
+		{
+		m1[j] += n[j] * a1;
+		m2[j] += n[j] * a2;
+		}
+	}
+for (j = 0;  j < ncand;  j++)		/* pairs of +1 isotopes */
+	m2[j] += 0.5f * m1[j] * m1[j];
+}
@@ -0,0 +1,231 @@
+/*
+
+SMNETWORK.CPP
+
+ Mass-difference network: for the peaks of a spectrum or a feature
+ table, every pair whose mass difference fits a formula of the
+ difference table is an edge, with that formula. The table holds the
+ transformations below (name and formula) and, for small differences,
+ all formulas of the element ranges (a bounded decomposition: 0 to the
+ max. count of each element, an even no. of electrons, and at most 3
+ rings/double bonds lost), sorted by mass.
+
+ The peaks are sorted by mass and swept with two pointers: for peak a,
+ b runs up while the difference is within the largest one of the
+ table; since the differences grow with b, a third pointer runs up the
+ table alongside, so each pair costs O(1) plus its edges, instead of a
+ formula search per pair.
+
+ Copyright (c) 2026, distributed under the terms of version 2 of the
+ GNU General Public License, see smformula_stdout.cpp.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <sstream>
+#include <utility>
+#include <string>
+#include <vector>
+#include "smformula.h"
+using namespace std;
+
+#define NET_RDB_LOSS	3	/* max. rings/double bonds lost in a decomposition */
+
+typedef struct	{
+		const char *name;
+		const char *formula;
+		} Transformation;
+
+static const Transformation transformations[] =	/* b = a + formula */
+{
+{ "hydrogenation",		"H2" },
+{ "methylation",		"CH2" },
+{ "ethylation",			"C2H4" },
+{ "oxidation",			"O" },
+{ "hydration",			"H2O" },
+{ "amination",			"NH" },
+{ "ammonia",			"NH3" },
+{ "carbonylation",		"CO" },
+{ "carboxylation",		"CO2" },
+{ "acetylation",		"C2H2O" },
+{ "malonylation",		"C3H2O3" },
+{ "sulfation",			"SO3" },
+{ "phosphorylation",		"HPO3" },
+{ "glycine conjugation",	"C2H3NO" },
+{ "taurine conjugation",	"C2H5NO2S" },
+{ "cysteine conjugation",	"C3H5NOS" },
+{ "pentose",			"C5H8O4" },
+{ "deoxyhexose",		"C6H10O4" },
+{ "hexose",			"C6H10O5" },
+{ "glucuronidation",		"C6H8O6" },
+{ "glutathione conjugation",	"C10H15N3O6S" },
+};
+#define NTRANS (int)(sizeof(transformations) / sizeof(transformations[0]))
+
+typedef struct	{
+		double	mass;		/* calc_mass(cnt, 0) */
+		int	cnt[NEL];
+		const char *name;	/* NULL = decomposition */
+		} NetEntry;
+
+static vector<NetEntry> net_tab;	/* sorted by mass */
+static double net_max;			/* largest mass of net_tab */
+
+static bool lighter_entry(const NetEntry &a, const NetEntry &b)
+{
+return a.mass < b.mass;
+}
+
+
+/* all formulas of the element ranges up to 'limit' Da; counts of order[k...] */
+static void decompose(const int *order, int k, int *cnt, double sum, double limit)
+{
+NetEntry n;
+int e, c, dbe, i;
+
+if (k == nr_el)
+	{
+	for (i = 0, dbe = 0; i < nr_el; i++)
+		dbe += (int)el[i].val * cnt[i];
+	if ((sum > 0.0) && !(dbe & 1) && (dbe / 2 >= -NET_RDB_LOSS))
+		{
+		memcpy(n.cnt, cnt, sizeof(n.cnt));
+		n.mass = calc_mass(cnt, 0.0);
+		n.name = NULL;
+		net_tab.push_back(n);
+		}
+	return;
+	}
+e = order[k];
+for (c = 0; (c <= el[e].max) && (sum + c * el[e].mass <= limit); c++)
+	{
+	cnt[e] = c;
+	decompose(order, k + 1, cnt, sum + c * el[e].mass, limit);
+	}
+cnt[e] = 0;
+}
+
+
+static bool heavier_element(int a, int b)
+{
+return el[a].mass > el[b].mass;
+}
+
+
+/************************************************************************
+* NET_OPEN:	Builds the difference table: the transformations up	*
+*		to 'maxdiff' Da (those with elements not in el[] are	*
+*		left out), and all formulas of the element ranges up	*
+*		to 'maxdecomp' Da that are not a transformation.	*
+* Returns. 	no. of entries.						*
+*************************************************************************/
+long net_open(double maxdiff, double maxdecomp)
+{
+NetEntry n;
+int order[NEL], cnt[NEL];
+size_t j, k, ntrans;
+int i;
+
+net_tab.clear();
+for (i = 0; i < NTRANS; i++)
+	if (parse_formula(transformations[i].formula, n.cnt))
+		{
+		n.mass = calc_mass(n.cnt, 0.0);
+		n.name = transformations[i].name;
+		if (n.mass <= maxdiff)
+			net_tab.push_back(n);
+		}
+ntrans = net_tab.size();
+
+for (i = 0; i < nr_el; i++)
+	order[i] = i;
+sort(order, order + nr_el, heavier_element);	/* prunes on mass early */
+memset(cnt, 0, sizeof(cnt));
+decompose(order, 0, cnt, 0.0, min(maxdiff, maxdecomp));
+for (j = ntrans, k = ntrans; j < net_tab.size(); j++)	/* drop the named ones */
+	{
+	for (i = 0; (size_t)i < ntrans; i++)
+		if (!memcmp(net_tab[i].cnt, net_tab[j].cnt, sizeof(net_tab[j].cnt)))
+			break;
+	if ((size_t)i == ntrans)
+		net_tab[k++] = net_tab[j];
+	}
+net_tab.resize(k);
+
+stable_sort(net_tab.begin(), net_tab.end(), lighter_entry);
+net_max = net_tab.empty() ? 0.0 : net_tab.back().mass;
+return net_tab.size();
+}
+
+
+/************************************************************************
+* NET_EDGES:	The edges of one spectrum or feature table.		*
+* Input: 	neutral masses of the peaks, tolerance of each in mmu	*
+*		(that of a difference is twice that), edges are		*
+*		appended to 'edges': a lighter than b, in the order of	*
+*		the masses.						*
+* Returns. 	no. of edges.						*
+*************************************************************************/
+long net_edges(const vector<double> &mass, double tolerance, vector<NetEdge> &edges)
+{
+vector< pair<double, size_t> > by_mass(mass.size());	/* mass, peak */
+NetEdge e;
+double t = 2.0 * tolerance / 1000.0, d;
+size_t a, b, first, p, n = edges.size();
+
+for (a = 0; a < mass.size(); a++)
+	by_mass[a] = make_pair(mass[a], a);
+sort(by_mass.begin(), by_mass.end());
+
+for (a = 0; a < by_mass.size(); a++)
+	{
+	first = 0;			/* table pointer, up with the difference */
+	for (b = a + 1; b < by_mass.size(); b++)
+		{
+		d = by_mass[b].first - by_mass[a].first;
+		if (d > net_max + t)
+			break;
+		while ((first < net_tab.size()) && (net_tab[first].mass < d - t))
+			first++;
+		for (p = first; (p < net_tab.size()) && (net_tab[p].mass <= d + t); p++)
+			{
+			e.a = by_mass[a].second;
+			e.b = by_mass[b].second;
+			e.entry = p;
+			e.error = 1000.0 * (d - net_tab[p].mass);
+			edges.push_back(e);
+			}
+		}
+	}
+return edges.size() - n;
+}
+
+
+/************************************************************************
+* NET_FORMULA:	Formula and transformation name ("" for a		*
+*		decomposition) of an edge.				*
+*************************************************************************/
+string net_formula(const NetEdge &e)
+{
+ostringstream f;
+int i;
+
+for (i = 0; i < nr_el; i++)
+	if (net_tab[e.entry].cnt[i] > 0)
+		f << el[i].sym << net_tab[e.entry].cnt[i];
+return f.str();
+}
+
+const char *net_name(const NetEdge &e)
+{
+return (net_tab[e.entry].name != NULL) ? net_tab[e.entry].name : "";
+}
+
+double net_mass(const NetEdge &e)
+{
+return net_tab[e.entry].mass;
+}
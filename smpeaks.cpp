@@ -0,0 +1,664 @@
+/*
+
+SMPEAKS.CPP
+
+ Streaming readers of peak lists, so that a whole LC-MS run can be
+ annotated without preparing mass lists: next_peak() returns one peak
+ after the other, and only one spectrum is held in memory at a time.
+
+ MGF	BEGIN IONS ... END IONS; TITLE=, SCANS=, RTINSECONDS= and MSLEVEL=
+	of the spectrum, then lines "m/z intensity". Each spectrum without
+	SCANS gets its no. in the file.
+ mzML	centroided spectra (profile spectra are an error); the m/z and
+	intensity arrays as 32 or 64 bit floats, uncompressed or zlib, the
+	scan no. from "scan=" in the spectrum id, the retention time from
+	"scan start time" (s or min), the MS level. Chromatograms and the
+	index of indexedmzML are skipped. Local files only, no schema or
+	other validation.
+ CSV	a header line with the columns mz (or m/z, mass), intensity (int,
+	abundance), rt (retention time; rt_min or "rt (min)" in minutes,
+	else in seconds), scan, level and title (id, name), in any order,
+	separated by ',', ';' or tab; columns not known are skipped. The
+	peaks of a scan are numbered in the order of the lines. Without a
+	header: mz, intensity, rt.
+
+ Lines may be of any length.
+
+ Copyright (c) 2026, distributed under the terms of version 2 of the
+ GNU General Public License, see smformula_stdout.cpp.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <zlib.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "smformula.h"
+using namespace std;
+
+#define NCOLS	6		/* CSV columns known */
+#define COL_MZ		0
+#define COL_INT		1
+#define COL_RT		2
+#define COL_SCAN	3
+#define COL_LEVEL	4
+#define COL_TITLE	5
+
+struct PeakReader {
+		FILE	*f;
+		int	format;		/* PEAKS_... */
+		long	line;		/* MGF, CSV: line no., for errors */
+		string	buf;		/* current line / XML tag */
+		char	err[MAXLEN];	/* of the last next_peak() = -1 */
+		long	nspec;		/* spectra so far */
+		Peak	cur;		/* spectrum of the next peak (scan, title, ...) */
+		bool	in_ions;	/* MGF: between BEGIN and END IONS */
+		int	col[NCOLS];	/* CSV: column of COL_..., -1 = none */
+		char	sep;
+		double	rt_scale;	/* CSV: to seconds */
+		/* mzML: the spectrum being read, its peaks */
+		bool	in_spectrum, in_array, in_binary, profile;
+		int	arr_kind, arr_bits, arr_zlib;	/* 1 = m/z, 2 = intensity; 32/64; 0/1 */
+		long	arr_len;	/* defaultArrayLength */
+		string	text;		/* <binary> */
+		string	group;		/* <referenceableParamGroup> being read */
+		map<string, vector<string> > groups;	/* their cvParams: accession, value, unit */
+		vector<double> mz, intens;
+		size_t	next;		/* peak of mz[] returned next */
+		};
+
+
+/************************************************************************
+* PEAK_FORMAT:	Format of a peak list by the file name extension.	*
+* Returns. 	PEAKS_..., PEAKS_TEXT if not known.			*
+*************************************************************************/
+int peak_format(const char *file)
+{
+const char *ext = strrchr(file, '.');
+
+if (ext == NULL)
+	return PEAKS_TEXT;
+if (!strcasecmp(ext, ".mgf"))
+	return PEAKS_MGF;
+if (!strcasecmp(ext, ".mzml"))
+	return PEAKS_MZML;
+if (!strcasecmp(ext, ".csv") || !strcasecmp(ext, ".tsv"))
+	return PEAKS_CSV;
+return PEAKS_TEXT;
+}
+
+
+static int fail(PeakReader *r, const char *msg)
+{
+if ((r->format == PEAKS_MZML) || (r->line == 0))
+	snprintf(r->err, sizeof(r->err), "%s", msg);
+else
+	snprintf(r->err, sizeof(r->err), "line %ld: %s", r->line, msg);
+return -1;
+}
+
+
+/* the next line without its end into r->buf; 0 at the end of the file */
+static int read_line(PeakReader *r)
+{
+int c;
+
+r->buf.clear();
+while (((c = getc(r->f)) != EOF) && (c != '\n'))
+	if (c != '\r')
+		r->buf += (char)c;
+if ((c == EOF) && r->buf.empty())
+	return 0;
+r->line++;
+return 1;
+}
+
+
+static void new_spectrum(PeakReader *r)
+{
+r->nspec++;
+r->cur.scan = -1;
+r->cur.peak = 0;
+r->cur.level = 0;
+r->cur.rt = -1.0;
+*r->cur.title = 0;
+}
+
+
+static void set_title(Peak *p, const char *text, size_t len)
+{
+if (len >= sizeof(p->title))
+	len = sizeof(p->title) - 1;
+memcpy(p->title, text, len);
+p->title[len] = 0;
+}
+
+
+/* --- MGF --- */
+
+static int next_mgf(PeakReader *r, Peak *p)
+{
+const char *s;
+char *end;
+double mz;
+
+while (read_line(r))
+	{
+	s = r->buf.c_str();
+	while (isspace((unsigned char)*s))
+		s++;
+	if (!strncasecmp(s, "BEGIN IONS", 10))
+		{
+		new_spectrum(r);
+		r->cur.level = 2;
+		r->in_ions = true;
+		continue;
+		}
+	if (!strncasecmp(s, "END IONS", 8))
+		{
+		r->in_ions = false;
+		continue;
+		}
+	if (!r->in_ions || (*s == 0) || strchr("#;!/", *s))	/* global parameters, comments */
+		continue;
+	if (!strncasecmp(s, "TITLE=", 6))
+		set_title(&r->cur, s + 6, strlen(s + 6));
+	else if (!strncasecmp(s, "SCANS=", 6))
+		r->cur.scan = atol(s + 6);
+	else if (!strncasecmp(s, "RTINSECONDS=", 12))
+		r->cur.rt = atof(s + 12);
+	else if (!strncasecmp(s, "MSLEVEL=", 8))
+		r->cur.level = atoi(s + 8);
+	else if (isdigit((unsigned char)*s) || (*s == '.'))
+		{
+		mz = strtod(s, &end);
+		if (end == s)
+			return fail(r, "need 'm/z intensity'");
+		*p = r->cur;
+		if (p->scan < 0)
+			p->scan = r->nspec;
+		p->peak = ++r->cur.peak;
+		p->mz = mz;
+		p->intensity = strtod(end, NULL);
+		return 1;
+		}
+	/* other parameters (PEPMASS, CHARGE, ...) are not needed */
+	}
+if (r->in_ions)
+	return fail(r, "END IONS missing");
+return 0;
+}
+
+
+/* --- CSV --- */
+
+static int split_fields(const string &line, char sep, vector<string> &fields)
+{
+size_t a = 0, b;
+
+fields.clear();
+do	{
+	b = line.find(sep, a);
+	if (b == string::npos)
+		b = line.size();
+	fields.push_back(line.substr(a, b - a));
+	a = b + 1;
+	} while (b < line.size());
+return fields.size();
+}
+
+
+static void trim(string &s)
+{
+size_t a = 0, b = s.size();
+
+while ((a < b) && (isspace((unsigned char)s[a]) || (s[a] == '"')))
+	a++;
+while ((b > a) && (isspace((unsigned char)s[b - 1]) || (s[b - 1] == '"')))
+	b--;
+s = s.substr(a, b - a);
+}
+
+
+/* column names -> r->col[], r->rt_scale; 0 if this is no header line */
+static int csv_header(PeakReader *r, vector<string> &fields)
+{
+size_t j;
+const char *s;
+int i;
+
+for (i = 0; i < NCOLS; i++)
+	r->col[i] = -1;
+r->rt_scale = 1.0;
+for (j = 0; j < fields.size(); j++)
+	{
+	trim(fields[j]);
+	s = fields[j].c_str();
+	if (isdigit((unsigned char)*s) || (*s == '.'))
+		return 0;
+	if (!strcasecmp(s, "mz") || !strcasecmp(s, "m/z") || !strcasecmp(s, "mass"))
+		r->col[COL_MZ] = j;
+	else if (!strcasecmp(s, "intensity") || !strcasecmp(s, "int") || !strcasecmp(s, "abundance"))
+		r->col[COL_INT] = j;
+	else if (!strcasecmp(s, "rt") || !strcasecmp(s, "rt_s") || !strcasecmp(s, "rt (s)")
+			|| !strcasecmp(s, "retention time"))
+		r->col[COL_RT] = j;
+	else if (!strcasecmp(s, "rt_min") || !strcasecmp(s, "rt (min)"))
+		{
+		r->col[COL_RT] = j;
+		r->rt_scale = 60.0;
+		}
+	else if (!strcasecmp(s, "scan"))
+		r->col[COL_SCAN] = j;
+	else if (!strcasecmp(s, "level") || !strcasecmp(s, "ms_level"))
+		r->col[COL_LEVEL] = j;
+	else if (!strcasecmp(s, "title") || !strcasecmp(s, "id") || !strcasecmp(s, "name"))
+		r->col[COL_TITLE] = j;
+	}
+return 1;
+}
+
+
+static int next_csv(PeakReader *r, Peak *p)
+{
+vector<string> fields;
+const char *s;
+char *end;
+long scan;
+int i;
+
+while (read_line(r))
+	{
+	if (r->line == 1)		/* the separator and the columns */
+		{
+		r->sep = (r->buf.find('\t') != string::npos) ? '\t'
+			: (r->buf.find(';') != string::npos) ? ';' : ',';
+		split_fields(r->buf, r->sep, fields);
+		if (csv_header(r, fields))
+			{
+			if (r->col[COL_MZ] < 0)
+				return fail(r, "no column mz");
+			continue;
+			}
+		r->col[COL_MZ] = 0;	/* no header */
+		r->col[COL_INT] = 1;
+		r->col[COL_RT] = 2;
+		}
+	if (r->buf.find_first_not_of(" \t") == string::npos)
+		continue;
+	split_fields(r->buf, r->sep, fields);
+	for (i = 0; i < NCOLS; i++)
+		if (r->col[i] >= (int)fields.size())
+			fields.resize(r->col[i] + 1);	/* missing columns are empty */
+
+	s = fields[r->col[COL_MZ]].c_str();
+	p->mz = strtod(s, &end);
+	if (end == s)
+		return fail(r, "no m/z");
+	p->intensity = (r->col[COL_INT] >= 0) ? atof(fields[r->col[COL_INT]].c_str()) : 0.0;
+	p->rt = -1.0;
+	if ((r->col[COL_RT] >= 0) && !fields[r->col[COL_RT]].empty())
+		p->rt = atof(fields[r->col[COL_RT]].c_str()) * r->rt_scale;
+	p->level = (r->col[COL_LEVEL] >= 0) ? atoi(fields[r->col[COL_LEVEL]].c_str()) : 0;
+	*p->title = 0;
+	if (r->col[COL_TITLE] >= 0)
+		{
+		trim(fields[r->col[COL_TITLE]]);
+		set_title(p, fields[r->col[COL_TITLE]].c_str(), fields[r->col[COL_TITLE]].size());
+		}
+
+	/* the peaks of one scan are numbered; without scans, each line is one */
+	scan = (r->col[COL_SCAN] >= 0) ? atol(fields[r->col[COL_SCAN]].c_str()) : r->nspec + 1;
+	if ((r->nspec == 0) || (scan != r->cur.scan))
+		{
+		new_spectrum(r);
+		r->cur.scan = scan;
+		}
+	p->scan = scan;
+	p->peak = ++r->cur.peak;
+	return 1;
+	}
+return 0;
+}
+
+
+/* --- mzML --- */
+
+/* value of attribute 'name' of the tag in r->buf, "" if none */
+static string attribute(const PeakReader *r, const char *name)
+{
+size_t a, b, n = strlen(name);
+
+for (a = r->buf.find(name); a != string::npos; a = r->buf.find(name, a + 1))
+	if ((a > 0) && isspace((unsigned char)r->buf[a - 1])
+			&& (r->buf.compare(a + n, 2, "=\"") == 0))
+		{
+		a += n + 2;
+		b = r->buf.find('"', a);
+		return r->buf.substr(a, (b == string::npos) ? string::npos : b - a);
+		}
+return "";
+}
+
+
+/* tag name of r->buf: "spectrum", "/spectrum", ...; a namespace prefix is dropped */
+static string tag_name(const PeakReader *r)
+{
+size_t b = r->buf.find_first_of(" \t\r\n/>", 1);
+string name;
+size_t colon;
+
+if (r->buf[0] == '/')
+	b = r->buf.find_first_of(" \t\r\n>", 1);
+name = r->buf.substr(0, b);
+colon = name.find(':');
+if (colon != string::npos)
+	name = ((name[0] == '/') ? "/" : "") + name.substr(colon + 1);
+return name;
+}
+
+
+/* the next tag (without < >) into r->buf; text before it is kept in
+   r->text while in <binary>. 0 at the end of the file */
+static int read_tag(PeakReader *r)
+{
+int c, quote = 0;
+
+while (((c = getc(r->f)) != EOF) && (c != '<'))
+	if (r->in_binary)
+		r->text += (char)c;
+if (c == EOF)
+	return 0;
+r->buf.clear();
+while ((c = getc(r->f)) != EOF)
+	{
+	if ((c == '>') && !quote)
+		break;
+	if ((c == '"') || (c == '\''))
+		quote = (quote == c) ? 0 : (quote ? quote : c);
+	r->buf += (char)c;
+	if ((r->buf.size() == 3) && (r->buf == "!--"))	/* comment */
+		{
+		while ((c = getc(r->f)) != EOF)
+			{
+			r->buf += (char)c;
+			if ((c == '>') && (r->buf.compare(r->buf.size() - 3, 3, "-->") == 0))
+				break;
+			}
+		r->buf = "!--";
+		return (c != EOF);
+		}
+	}
+return (c != EOF);
+}
+
+
+static int base64_value(int c)
+{
+if ((c >= 'A') && (c <= 'Z'))
+	return c - 'A';
+if ((c >= 'a') && (c <= 'z'))
+	return c - 'a' + 26;
+if ((c >= '0') && (c <= '9'))
+	return c - '0' + 52;
+if (c == '+')
+	return 62;
+if (c == '/')
+	return 63;
+return -1;
+}
+
+
+static void base64_decode(const string &text, vector<unsigned char> &out)
+{
+unsigned long bits = 0;
+int v, nbits = 0;
+size_t j;
+
+out.clear();
+for (j = 0; j < text.size(); j++)
+	{
+	if ((v = base64_value((unsigned char)text[j])) < 0)	/* white space, '=' */
+		continue;
+	bits = (bits << 6) | v;
+	nbits += 6;
+	if (nbits >= 8)
+		{
+		nbits -= 8;
+		out.push_back((bits >> nbits) & 0xff);
+		}
+	}
+}
+
+
+/* the <binary> just read into mz[] or intens[]; mzML is little endian */
+static int decode_array(PeakReader *r)
+{
+vector<unsigned char> raw, data;
+vector<double> &arr = (r->arr_kind == 1) ? r->mz : r->intens;
+unsigned long long u;
+uLongf len;
+size_t j, width = r->arr_bits / 8;
+unsigned int u32;
+float f;
+double d;
+int k;
+
+base64_decode(r->text, raw);
+if (r->arr_zlib)
+	{
+	len = r->arr_len * width;
+	data.resize(len + 1);
+	if ((uncompress(&data[0], &len, raw.empty() ? NULL : &raw[0], raw.size()) != Z_OK)
+			|| (len != r->arr_len * width))
+		return fail(r, "damaged zlib array");
+	data.resize(len);
+	}
+else
+	data.swap(raw);
+
+arr.clear();
+for (j = 0; j + width <= data.size(); j += width)
+	{
+	for (u = 0, k = width - 1; k >= 0; k--)
+		u = (u << 8) | data[j + k];
+	if (width == 4)
+		{
+		u32 = (unsigned int)u;
+		memcpy(&f, &u32, sizeof(f));
+		arr.push_back(f);
+		}
+	else
+		{
+		memcpy(&d, &u, sizeof(d));
+		arr.push_back(d);
+		}
+	}
+return 1;
+}
+
+
+static void mzml_cvparam(PeakReader *r, const string &acc, const string &value, const string &unit)
+{
+if (r->in_array)
+	{
+	if (acc == "MS:1000514")		/* m/z array */
+		r->arr_kind = 1;
+	else if (acc == "MS:1000515")		/* intensity array */
+		r->arr_kind = 2;
+	else if (acc == "MS:1000521")		/* 32-bit float */
+		r->arr_bits = 32;
+	else if (acc == "MS:1000523")		/* 64-bit float */
+		r->arr_bits = 64;
+	else if ((acc == "MS:1000519") || (acc == "MS:1000522"))	/* integers */
+		r->arr_bits = -1;
+	else if (acc == "MS:1000574")		/* zlib compression */
+		r->arr_zlib = 1;
+	else if (acc.compare(0, 7, "MS:1002") == 0)	/* numpress */
+		r->arr_zlib = -1;
+	return;
+	}
+if (acc == "MS:1000511")			/* ms level */
+	r->cur.level = atoi(value.c_str());
+else if (acc == "MS:1000128")			/* profile spectrum */
+	r->profile = true;
+else if (acc == "MS:1000016")			/* scan start time */
+	{
+	r->cur.rt = atof(value.c_str());
+	if (unit == "UO:0000031")		/* minute */
+		r->cur.rt *= 60.0;
+	}
+}
+
+
+static int next_mzml(PeakReader *r, Peak *p)
+{
+string name, id;
+size_t a;
+
+for (;;)
+	{
+	if (!r->in_spectrum && (r->next < r->mz.size()))	/* peaks of the spectrum read */
+		{
+		*p = r->cur;
+		p->peak = ++r->cur.peak;
+		p->mz = r->mz[r->next];
+		p->intensity = (r->next < r->intens.size()) ? r->intens[r->next] : 0.0;
+		r->next++;
+		return 1;
+		}
+	if (!read_tag(r))
+		return r->in_spectrum ? fail(r, "end of file in a spectrum") : 0;
+
+	name = tag_name(r);
+	if (name == "spectrum")
+		{
+		new_spectrum(r);
+		r->in_spectrum = true;
+		r->profile = false;
+		r->mz.clear();
+		r->intens.clear();
+		r->next = 0;
+		r->arr_len = atol(attribute(r, "defaultArrayLength").c_str());
+		id = attribute(r, "id");
+		set_title(&r->cur, id.c_str(), id.size());
+		a = id.find("scan=");
+		r->cur.scan = (a != string::npos) ? atol(id.c_str() + a + 5) : r->nspec;
+		}
+	else if (name == "referenceableParamGroup")
+		r->group = attribute(r, "id");
+	else if (name == "/referenceableParamGroup")
+		r->group.clear();
+	else if ((name == "cvParam") && !r->group.empty())	/* kept for the refs */
+		{
+		vector<string> &g = r->groups[r->group];
+		g.push_back(attribute(r, "accession"));
+		g.push_back(attribute(r, "value"));
+		g.push_back(attribute(r, "unitAccession"));
+		}
+	else if (!r->in_spectrum)		/* chromatograms, index, ... */
+		continue;
+	else if (name == "cvParam")
+		mzml_cvparam(r, attribute(r, "accession"), attribute(r, "value"),
+			attribute(r, "unitAccession"));
+	else if (name == "referenceableParamGroupRef")
+		{
+		vector<string> &g = r->groups[attribute(r, "ref")];
+		for (a = 0; a + 2 < g.size(); a += 3)
+			mzml_cvparam(r, g[a], g[a + 1], g[a + 2]);
+		}
+	else if (name == "binaryDataArray")
+		{
+		r->in_array = true;
+		r->arr_kind = 0;
+		r->arr_bits = 64;
+		r->arr_zlib = 0;
+		}
+	else if (name == "binary")
+		{
+		r->text.clear();
+		r->in_binary = (r->buf[r->buf.size() - 1] != '/');
+		}
+	else if (name == "/binary")
+		{
+		r->in_binary = false;
+		if ((r->arr_kind == 0) || r->profile)
+			continue;
+		if (r->arr_bits < 0)
+			return fail(r, "integer arrays are not supported");
+		if (r->arr_zlib < 0)
+			return fail(r, "numpress arrays are not supported");
+		if (decode_array(r) < 0)
+			return -1;
+		}
+	else if (name == "/binaryDataArray")
+		r->in_array = false;
+	else if (name == "/spectrum")
+		{
+		r->in_spectrum = false;
+		if (r->profile && (r->arr_len > 0))
+			{
+			snprintf(r->err, sizeof(r->err),
+				"spectrum %.100s is profile data, centroid it first", r->cur.title);
+			return -1;
+			}
+		if (r->mz.size() != r->intens.size())
+			r->intens.resize(r->mz.size(), 0.0);
+		}
+	}
+}
+
+
+/************************************************************************
+* OPEN_PEAKS:	Opens a peak list for next_peak().			*
+* Input: 	file, PEAKS_MGF, PEAKS_MZML or PEAKS_CSV.		*
+* Returns. 	reader, NULL if the file can't be opened.		*
+*************************************************************************/
+PeakReader *open_peaks(const char *file, int format)
+{
+PeakReader *r;
+FILE *f;
+
+if ((format != PEAKS_MGF) && (format != PEAKS_MZML) && (format != PEAKS_CSV))
+	return NULL;
+if ((f = fopen(file, "r")) == NULL)
+	return NULL;
+r = new PeakReader();
+r->f = f;
+r->format = format;
+return r;
+}
+
+
+/************************************************************************
+* NEXT_PEAK:	Reads the next peak, in the order of the file.		*
+* Returns. 	1 = peak, 0 = end of the list, -1 = error, see		*
+*		peaks_error().						*
+*************************************************************************/
+int next_peak(PeakReader *r, Peak *p)
+{
+*r->err = 0;
+if (r->format == PEAKS_MGF)
+	return next_mgf(r, p);
+if (r->format == PEAKS_MZML)
+	return next_mzml(r, p);
+return next_csv(r, p);
+}
+
+
+const char *peaks_error(const PeakReader *r)
+{
+return r->err;
+}
+
+
+void close_peaks(PeakReader *r)
+{
+fclose(r->f);
+delete r;
+}
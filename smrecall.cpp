@@ -0,0 +1,462 @@
+/*
+
+SMRECALL.CPP
+
+ Recall and latency of the formula calculation against known formulas.
+ The formulas of formulae/metabolites.tsv (see formulae/metabolites.py)
+ are turned into measured masses, fuzzed by a ppm error like fuzz_mass()
+ in formulae/utils.py, and searched with the element ranges of
+ formulae/data.py for their mass, at the same ppm tolerance. For each
+ configuration (element ratio rules on/off, adduct ions, isotope scoring)
+ and ppm level this gives the rank of the true formula among the hits
+ (by mass error, or by isotope score with scoring), the recall within
+ the first 1/5/10 hits, p50/p99 latency and queries per second, as JSON.
+
+ usage: smrecall [-l] [-f file] [-n num] [-s seed] [-p ppm,...] [-q name]
+                 [-a] [-N noise] [-c | -C] [-o file]
+
+ The fast engine (search_formulas) is used; a speed-up of the engine
+ must not lower the recall here. With adapted maxima (-b), the ranges
+ are the max. of the formulae/data.py tiers up to the mass, and "lost"
+ counts the true formulas within them that the adapted maxima exclude;
+ -c makes that an error ("make check"); -C checks only that, without
+ the searches, for tests/bounds.tsv (above 2000 Da, with more F, Br, S,
+ Cl or H than the 3000 Da tier allows, too many hits to search all).
+
+ Copyright (c) 2026, distributed under the terms of version 2 of the
+ GNU General Public License, see smformula_stdout.cpp.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "smformula.h"
+using namespace std;
+
+#define VERSION "20261019"
+#define MAXPPM	16
+
+typedef struct	{
+		const char *name;
+		int	rules;		/* element ratio checks on/off */
+		const char *adduct;	/* measured as this adduct ion, NULL = neutral */
+		int	iso;		/* rank by isotope score */
+		int	bounds;		/* ranges lowered by adapt_bounds() (-b) */
+		} RecallConfig;
+
+static const RecallConfig configs[] =
+{
+{ "rules",        1, NULL,      0, 0 },
+{ "norules",      0, NULL,      0, 0 },
+{ "rules_M+H",    1, "[M+H]+",  0, 0 },
+{ "rules_M+Na",   1, "[M+Na]+", 0, 0 },
+{ "rules_M-H",    1, "[M-H]-",  0, 0 },
+{ "rules_iso",    1, NULL,      1, 0 },
+{ "norules_iso",  0, NULL,      1, 0 },
+{ "rules_bounds", 1, NULL,      0, 1 },
+};
+#define NCONFIGS (int)(sizeof(configs) / sizeof(configs[0]))
+
+typedef struct	{
+		string	formula, name;
+		int	cnt[NEL];
+		double	mass;		/* neutral monoisotopic mass */
+		} Known;
+
+/* element maxima by mass, formulae/data.py (element_restrictions) */
+static const struct { double mass; const char *ranges; } tiers[] =
+{
+{ 500,  "C39 H72 N20 O20 P9 S10 F16 L10 B5 I8" },
+{ 1000, "C78 H126 N25 O27 P9 S14 F34 L12 B8 I14" },
+{ 2000, "C156 H236 N32 O63 P9 S14 F48 L12 B10 I15" },
+{ 3000, "C162 H208 N48 O78 P9 S9 F16 L11 B4 I15" },
+};
+#define NTIERS (int)(sizeof(tiers) / sizeof(tiers[0]))
+
+static const char chnops[] = "CHNOPS";	/* keys searched without -a */
+
+static unsigned long long rng;
+
+
+static unsigned long long next_random(void)	/* xorshift64*, as smdiff */
+{
+rng ^= rng >> 12;
+rng ^= rng << 25;
+rng ^= rng >> 27;
+return rng * 2685821657736338717ULL;
+}
+
+static double uniform(void)
+{
+return (next_random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double fuzz_mass(double mass, double ppm)	/* formulae/utils.py */
+{
+double r = uniform();
+
+return (r > 0.5) ? mass + r * ppm * 1e-6 * mass : mass - r * ppm * 1e-6 * mass;
+}
+
+
+/************************************************************************
+* PARSE_KNOWN:	"C6H12O6" -> counts indexed like el[].			*
+* Returns. 	1 if OK, 0 if it has elements not in el[].		*
+*************************************************************************/
+static int parse_known(const char *p, int *cnt)
+{
+int i, n, len;
+
+memset(cnt, 0, NEL * sizeof(int));
+while (*p)
+	{
+	len = 0;
+	for (i = 0; i < nr_el; i++)		/* "C" must not match the "Cl" */
+		{
+		len = strlen(el[i].sym);
+		if (!strncmp(p, el[i].sym, len) && ((len == 2) || !((p[1] >= 'a') && (p[1] <= 'z'))))
+			break;
+		}
+	if ((i == nr_el) || (i == el_index("X")) || (i == el_index("D")) || (i == el_index("M")))	/* unknown, or labels */
+		return 0;
+	p += len;
+	n = 0;
+	while ((*p >= '0') && (*p <= '9'))
+		n = 10 * n + *p++ - '0';
+	cnt[i] += (n > 0) ? n : 1;
+	}
+return 1;
+}
+
+
+static vector<Known> load_known(const char *fname, int *skipped)
+{
+vector<Known> list;
+Known k;
+char buf[512], *tab;
+FILE *f;
+
+*skipped = 0;
+if ((f = fopen(fname, "r")) == NULL)
+	return list;
+while (fgets(buf, sizeof(buf), f))
+	{
+	if ((*buf == '#') || (*buf == '\n'))
+		continue;
+	buf[strcspn(buf, "\r\n")] = 0;
+	tab = strchr(buf, '\t');
+	if (tab != NULL)
+		*tab++ = 0;
+	if (!parse_known(buf, k.cnt))
+		{
+		(*skipped)++;
+		continue;
+		}
+	k.formula = buf;
+	k.name = tab ? tab : "";
+	k.mass = calc_mass(k.cnt, 0.0);
+	list.push_back(k);
+	}
+fclose(f);
+return list;
+}
+
+
+/* element ranges of mass2formula_args() in formulae/utils.py; with
+   'envelope' the max. of the tiers up to mz, as the caps of adapt_bounds() */
+static void set_query_ranges(Query *q, double mz, int all_elements, int envelope)
+{
+const char *p;
+int i, t, u, n;
+
+for (t = 0; (t < NTIERS - 1) && (mz > tiers[t].mass); t++)
+	;
+for (i = 0; i < NEL; i++)
+	q->min[i] = q->max[i] = 0;
+for (u = envelope ? 0 : t; u <= t; u++)
+	for (p = tiers[u].ranges; *p; p++)
+		{
+		if ((*p < 'A') || (*p > 'Z'))
+			continue;
+		for (i = 0; (i < nr_el) && (el[i].key != *p); i++)
+			;
+		n = atoi(p + 1);
+		if ((i < nr_el) && (all_elements || strchr(chnops, *p)) && (n > q->max[i]))
+			q->max[i] = n;
+		}
+}
+
+
+static bool by_error(const Candidate &a, const Candidate &b)
+{
+return fabs(a.error) < fabs(b.error);
+}
+
+static double percentile(vector<double> &v, double p)
+{
+size_t k;
+
+if (v.empty())
+	return 0.0;
+sort(v.begin(), v.end());
+k = (size_t)(p * (v.size() - 1) + 0.5);
+return v[k];
+}
+
+
+int main (int argc, char *argv[])
+{
+vector<Known> known;
+const char *fname = "formulae/metabolites.tsv", *select = NULL, *outname = NULL;
+char *ppmlist = NULL, *tok;
+double ppm[MAXPPM], noise = 5.0;
+int nppm, i, j, c, k, tmp, skipped, rank, list = 0, all_elements = 0, first = 1;
+int check = 0;
+long lost_total = 0;
+long nsample = 300;
+FILE *json;
+time_t now;
+char date[32];
+
+static const char *msg =
+"Recall and latency of the formula calculation against known formulas, as JSON.\n\n"
+"usage: smrecall [options]\n\nValid command line options are:\n"
+"-h      This Help screen.\n"
+"-l      List the configurations and exit.\n"
+"-f file Known formulas, 'formula<TAB>name' (default formulae/metabolites.tsv).\n"
+"-n num  Use num formulas, drawn at random (default 300, 0 = all).\n"
+"-s seed Seed of the draw and the mass errors (default 1).\n"
+"-p ppm  Comma separated ppm levels (default 1,2,5,10).\n"
+"-q txt  Run only the configurations whose name contains 'txt'.\n"
+"-a      Search all elements of formulae/data.py, not only CHNOPS.\n"
+"-N pct  Noise of the 'measured' isotope pattern, in % (default 5).\n"
+"-c      Check: exit 1 if the adapted maxima lose a true formula.\n"
+"-C      The same check only, no searches (the recall is 0).\n"
+"-o file Write the JSON to 'file' (default: stdout).\n";
+
+rng = 1;
+while ((tmp = getopt(argc, argv, "hlf:n:s:p:q:aN:cCo:")) != EOF)
+	switch (tmp)
+		{
+		case 'h':
+			printf("%s", msg);
+			return 0;
+		case 'l':
+			list = 1;
+			continue;
+		case 'f':
+			fname = optarg;
+			continue;
+		case 'n':
+			nsample = atol(optarg);
+			continue;
+		case 's':
+			rng = strtoull(optarg, NULL, 10);
+			continue;
+		case 'p':
+			ppmlist = optarg;
+			continue;
+		case 'q':
+			select = optarg;
+			continue;
+		case 'a':
+			all_elements = 1;
+			continue;
+		case 'N':
+			noise = atof(optarg);
+			continue;
+		case 'c':
+			check = 1;
+			continue;
+		case 'C':
+			check = 2;		/* no searches */
+			continue;
+		case 'o':
+			outname = optarg;
+			continue;
+		default:
+			printf ("'%s -h' for help.\n", argv[0]);
+			return 1;
+		}
+if (rng == 0)
+	rng = 0x9E3779B97F4A7C15ULL;
+
+if (list)
+	{
+	for (c = 0; c < NCONFIGS; c++)
+		printf("%-12s rules %s, %s%s%s\n", configs[c].name, configs[c].rules ? "on " : "off",
+			configs[c].adduct ? configs[c].adduct : "neutral",
+			configs[c].iso ? ", ranked by isotope score" : "",
+			configs[c].bounds ? ", adapted maxima" : "");
+	return 0;
+	}
+
+nppm = 0;
+if (ppmlist == NULL)
+	{
+	ppm[nppm++] = 1;
+	ppm[nppm++] = 2;
+	ppm[nppm++] = 5;
+	ppm[nppm++] = 10;
+	}
+else
+	for (tok = strtok(ppmlist, ","); (tok != NULL) && (nppm < MAXPPM); tok = strtok(NULL, ","))
+		ppm[nppm++] = atof(tok);
+
+init_elements();
+known = load_known(fname, &skipped);
+if (known.empty())
+	{
+	fprintf(stderr, "Error: no formulas in %s.\n", fname);
+	return 1;
+	}
+for (i = known.size() - 1; i > 0; i--)		/* draw the sample */
+	swap(known[i], known[next_random() % (i + 1)]);
+if ((nsample > 0) && (nsample < (long)known.size()))
+	known.resize(nsample);
+
+json = (outname != NULL) ? fopen(outname, "w") : stdout;
+if (json == NULL)
+	{
+	fprintf(stderr, "Error: Cannot open %s.\n", outname);
+	return 1;
+	}
+now = time(NULL);
+strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+fprintf(json, "{\n\"benchmark\": \"smrecall\",\n\"version\": \"%s\",\n\"engine\": \"fast\",\n"
+	"\"date\": \"%s\",\n\"formulas\": \"%s\",\n\"sample\": %d,\n\"skipped\": %d,\n"
+	"\"elements\": \"%s\",\n\"isotope_noise_pct\": %.2f,\n\"results\": [",
+	VERSION, date, fname, (int)known.size(), skipped, all_elements ? "all" : "CHNOPS", noise);
+
+for (c = 0; c < NCONFIGS; c++)
+	{
+	const RecallConfig &cf = configs[c];
+	const Adduct *add = cf.adduct ? find_adduct(cf.adduct) : NULL;
+
+	if ((select != NULL) && (strstr(cf.name, select) == NULL))
+		continue;
+	for (j = 0; j < nppm; j++)
+		{
+		vector<double> lat, ranks;
+		long found = 0, top1 = 0, top5 = 0, top10 = 0, hits = 0, lost = 0;
+		double total = 0.0;
+
+		for (i = 0; i < (int)known.size(); i++)
+			{
+			const Known &kn = known[i];
+			vector<Candidate> cands;
+			Candidate truth;
+			Query q;
+			double mz;
+			long long t0;
+			size_t h;
+
+			mz = add ? adduct_mz(add, kn.mass) : kn.mass;
+			mz = fuzz_mass(mz, ppm[j]);
+			memset(&q, 0, sizeof(q));	/* no budget, as make_query() */
+			q.share = 1.0;
+			q.tol = ppm[j] * 1e-6 * mz * 1e3;	/* mass2formula_args() */
+			q.mass = mz;
+			q.charge = 0.0;
+			q.rules = cf.rules;
+			if (add != NULL)
+				{
+				q.mass = adduct_neutral(add, mz);
+				q.tol *= abs(add->z) / (double)add->nmol;
+				}
+			set_query_ranges(&q, mz, all_elements, cf.bounds);
+			if (cf.bounds)
+				{
+				for (k = 0; (k < nr_el) && (kn.cnt[k] <= q.max[k]); k++)
+					;
+				adapt_bounds(&q);
+				if (k == nr_el)		/* within the ranges before */
+					{
+					for (k = 0; (k < nr_el) && (kn.cnt[k] <= q.max[k]); k++)
+						;
+					lost += (k < nr_el);
+					}
+				}
+			if (check > 1)
+				continue;
+
+			if (cf.iso)			/* the "measured" pattern: truth plus noise */
+				{
+				memcpy(truth.cnt, kn.cnt, sizeof(truth.cnt));
+				calc_isotopes(&truth);
+				niso_meas = MAXISO;
+				for (k = 0; k < MAXISO; k++)
+					iso_meas[k] = truth.iso[k] * (k ? 1.0 + noise / 100.0 * (2.0 * uniform() - 1.0) : 1.0);
+				}
+			else
+				niso_meas = 0;
+
+			t0 = clock_ns();
+			search_formulas(&q, cands);
+			if (cf.iso)
+				{
+				for (h = 0; h < cands.size(); h++)
+					{
+					calc_isotopes(&cands[h]);
+					cands[h].score = score_isotopes(&cands[h]);
+					}
+				sort(cands.begin(), cands.end(), better_candidate);
+				}
+			else
+				sort(cands.begin(), cands.end(), by_error);
+			lat.push_back((clock_ns() - t0) / 1e6);
+			total += lat.back();
+			hits += cands.size();
+
+			rank = 0;
+			for (h = 0; h < cands.size(); h++)
+				if (!memcmp(cands[h].cnt, kn.cnt, sizeof(kn.cnt)))
+					{
+					rank = h + 1;
+					break;
+					}
+			if (rank > 0)
+				{
+				found++;
+				ranks.push_back(rank);
+				top1 += (rank <= 1);
+				top5 += (rank <= 5);
+				top10 += (rank <= 10);
+				}
+			}
+
+		fprintf(json, "%s\n{\"config\": \"%s\", \"rules\": %s, \"adduct\": %s%s%s, \"iso\": %s, "
+			"\"bounds\": %s, \"ppm\": %.3f, \"queries\": %d, ",
+			first ? "" : ",", cf.name, cf.rules ? "true" : "false",
+			add ? "\"" : "", add ? add->name : "null", add ? "\"" : "",
+			cf.iso ? "true" : "false", cf.bounds ? "true" : "false", ppm[j], (int)known.size());
+		fprintf(json, "\"found\": %.4f, \"top1\": %.4f, \"top5\": %.4f, \"top10\": %.4f, "
+			"\"median_rank\": %.0f, \"mean_hits\": %.2f, \"lost\": %ld, ",
+			found / (double)known.size(), top1 / (double)known.size(),
+			top5 / (double)known.size(), top10 / (double)known.size(),
+			percentile(ranks, 0.5), hits / (double)known.size(), lost);
+		fprintf(json, "\"p50_ms\": %.4f, \"p99_ms\": %.4f, \"queries_per_s\": %.1f}",
+			percentile(lat, 0.5), percentile(lat, 0.99), total > 0 ? known.size() / (total / 1e3) : 0.0);
+		fflush(json);
+		first = 0;
+		lost_total += lost;
+		}
+	}
+
+fprintf(json, "\n]\n}\n");
+if (json != stdout)
+	fclose(json);
+if (check && (lost_total > 0))
+	{
+	fprintf(stderr, "Error: the adapted maxima lose %ld true formulas (see \"lost\").\n", lost_total);
+	return 1;
+	}
+return 0;
+}
@@ -0,0 +1,369 @@
+/*
+
+SMSUSPECT.CPP
+
+ Suspect screening: instead of a formula search, the m/z is looked up
+ in a table of known formulas (a list 'formula<TAB>name' such as
+ formulae/metabolites.tsv), each expanded over all adducts of
+ adducts[]. The m/z of the adduct ions are kept sorted in one array
+ of doubles, with the formula and adduct of each in a second one, so
+ a query is a binary search plus the ions within the window.
+
+ With a store file, the table is written there once and later mapped
+ (mmap) instead of reading the list again: "SMS2", the no. of elements
+ and their masses, size and time of the list, the counts, then the
+ adducts (M count, charge and delta of each; the store is rebuilt if
+ any of these differ), the m/z array, the ion array, the formulas and
+ their names.
+
+ Copyright (c) 2026, distributed under the terms of version 2 of the
+ GNU General Public License, see smformula_stdout.cpp.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "smformula.h"
+using namespace std;
+
+typedef struct	{			/* an adduct ion of a suspect */
+		int	formula;	/* index in the formulas */
+		int	adduct;		/* index in adducts[] */
+		} SuspectIon;
+
+typedef struct	{			/* a suspect */
+		double	mass;		/* neutral */
+		float	rdb, lewis;
+		long long name;		/* offset in the names */
+		short	cnt[NEL];
+		} SuspectFormula;
+
+typedef struct	{			/* head of the store */
+		char	magic[4];
+		int	nel;
+		double	mass[NEL];
+		long long size, mtime;	/* of the list */
+		long long nions, nformulas, nnames;
+		int	nadducts;	/* StoreAdducts after the head */
+		} SuspectStore;
+
+typedef struct	{			/* an adduct of adducts[] the table was built for */
+		int	nmol, z;
+		double	delta;
+		} StoreAdduct;
+
+int     suspect_mode;			/* 1 = suspect_search() instead of the formula search */
+
+static const double *ion_mz;		/* sorted */
+static const SuspectIon *ions;
+static const SuspectFormula *formulas;
+static const char *names;
+static long long nions;
+static const Adduct *only;		/* NULL = all adducts */
+
+static vector<double> build_mz;		/* the table if not mapped */
+static vector<SuspectIon> build_ions;
+static vector<SuspectFormula> build_formulas;
+static string build_names;
+static void *map;			/* the store if mapped */
+static size_t map_size;
+
+
+static bool lighter_ion(const pair<double, SuspectIon> &a, const pair<double, SuspectIon> &b)
+{
+return a.first < b.first;
+}
+
+
+/* the store if it holds the table of 'list' now, else 0 */
+static int map_store(const char *store, const struct stat *ls)
+{
+const SuspectStore *h;
+const StoreAdduct *a;
+struct stat st;
+const char *p;
+int fd, i, ok;
+
+if ((fd = open(store, O_RDONLY)) < 0)
+	return 0;
+if ((fstat(fd, &st) != 0) || (st.st_size < (off_t)sizeof(SuspectStore)))
+	{
+	close(fd);
+	return 0;
+	}
+map_size = st.st_size;
+map = mmap(NULL, map_size, PROT_READ, MAP_SHARED, fd, 0);
+close(fd);
+if (map == MAP_FAILED)
+	{
+	map = NULL;
+	return 0;
+	}
+
+h = (const SuspectStore *)map;
+a = (const StoreAdduct *)((const char *)map + sizeof(SuspectStore));
+if (memcmp(h->magic, "SMS2", 4) || (h->nel != nr_el) || (h->nadducts != nr_adducts)
+		|| (h->size != (long long)ls->st_size) || (h->mtime != (long long)ls->st_mtime)
+		|| (map_size != sizeof(SuspectStore) + h->nadducts * sizeof(StoreAdduct)
+			+ h->nions * (sizeof(double) + sizeof(SuspectIon))
+			+ h->nformulas * sizeof(SuspectFormula) + h->nnames))
+	ok = 0;
+else
+	{
+	for (i = 0, ok = 1; i < nr_el; i++)
+		if (h->mass[i] != el[i].mass)
+			ok = 0;
+	for (i = 0; i < nr_adducts; i++)	/* else the ions of other adducts */
+		if ((a[i].nmol != adducts[i].nmol) || (a[i].z != adducts[i].z)
+				|| (a[i].delta != adducts[i].delta))
+			ok = 0;
+	}
+if (!ok)
+	{
+	munmap(map, map_size);
+	map = NULL;
+	return 0;
+	}
+
+p = (const char *)map + sizeof(SuspectStore) + h->nadducts * sizeof(StoreAdduct);
+nions = h->nions;
+ion_mz = (const double *)p;
+p += nions * sizeof(double);
+ions = (const SuspectIon *)p;
+p += nions * sizeof(SuspectIon);
+formulas = (const SuspectFormula *)p;
+p += h->nformulas * sizeof(SuspectFormula);
+names = p;
+return 1;
+}
+
+
+static int write_store(const char *store, const struct stat *ls)
+{
+SuspectStore h;
+StoreAdduct a;
+FILE *f;
+int i;
+
+memset(&h, 0, sizeof(h));
+memcpy(h.magic, "SMS2", 4);
+h.nel = nr_el;
+for (i = 0; i < nr_el; i++)
+	h.mass[i] = el[i].mass;
+h.size = ls->st_size;
+h.mtime = ls->st_mtime;
+h.nions = build_mz.size();
+h.nformulas = build_formulas.size();
+h.nnames = build_names.size();
+h.nadducts = nr_adducts;
+
+if ((f = fopen(store, "wb")) == NULL)
+	return 0;
+fwrite(&h, sizeof(h), 1, f);
+for (i = 0; i < nr_adducts; i++)
+	{
+	memset(&a, 0, sizeof(a));
+	a.nmol = adducts[i].nmol;
+	a.z = adducts[i].z;
+	a.delta = adducts[i].delta;
+	fwrite(&a, sizeof(a), 1, f);
+	}
+fwrite(build_mz.data(), sizeof(double), build_mz.size(), f);
+fwrite(build_ions.data(), sizeof(SuspectIon), build_ions.size(), f);
+fwrite(build_formulas.data(), sizeof(SuspectFormula), build_formulas.size(), f);
+fwrite(build_names.data(), 1, build_names.size(), f);
+return (fclose(f) == 0);
+}
+
+
+/* reads the list, expands it over the adducts; returns no. of lines skipped, -1 if none read */
+static long read_list(const char *list)
+{
+vector< pair<double, SuspectIon> > by_mz;
+SuspectFormula s;
+SuspectIon ion;
+FILE *f;
+char buf[1024], *tab;
+int cnt[NEL];
+long skipped = 0;
+size_t j;
+int i;
+
+if ((f = fopen(list, "r")) == NULL)
+	return -1;
+build_formulas.clear();
+build_names.clear();
+while (fgets(buf, sizeof(buf), f))
+	{
+	if ((*buf == '#') || (*buf == '\n') || (*buf == '\r'))
+		continue;
+	buf[strcspn(buf, "\r\n")] = 0;
+	tab = strchr(buf, '\t');
+	if (tab != NULL)
+		*tab++ = 0;
+	if (!parse_formula(buf, cnt))		/* elements not in el[] */
+		{
+		skipped++;
+		continue;
+		}
+	memset(&s, 0, sizeof(s));
+	for (i = 0; i < nr_el; i++)
+		s.cnt[i] = cnt[i];
+	s.mass = calc_mass(cnt, 0.0);
+	s.rdb = calc_rdb(cnt);
+	s.lewis = (float)(fmod(s.rdb, 1));
+	s.name = build_names.size();
+	build_names += (tab != NULL) ? tab : "";
+	build_names += '\0';
+	build_formulas.push_back(s);
+	}
+fclose(f);
+if (build_formulas.empty())
+	return -1;
+
+for (j = 0; j < build_formulas.size(); j++)
+	for (i = 0; i < nr_adducts; i++)
+		{
+		ion.formula = j;
+		ion.adduct = i;
+		by_mz.push_back(make_pair(adduct_mz(&adducts[i], build_formulas[j].mass), ion));
+		}
+stable_sort(by_mz.begin(), by_mz.end(), lighter_ion);
+build_mz.resize(by_mz.size());
+build_ions.resize(by_mz.size());
+for (j = 0; j < by_mz.size(); j++)
+	{
+	build_mz[j] = by_mz[j].first;
+	build_ions[j] = by_mz[j].second;
+	}
+return skipped;
+}
+
+
+/************************************************************************
+* SUSPECT_OPEN:	Switches suspect screening on: the table of the list	*
+*		'formula<TAB>name' ('#' comments) over all adducts,	*
+*		mapped from 'store' if that holds it, else read and	*
+*		written there (NULL = no store).			*
+* Input: 	list, store, adduct searched (NULL = all), no. of lines	*
+*		skipped (formulas with elements not in el[]) returned.	*
+* Returns. 	no. of adduct ions, 0 if the list has none or can't be	*
+*		read.							*
+*************************************************************************/
+long suspect_open(const char *list, const char *store, const Adduct *adduct, long *skipped)
+{
+struct stat ls;
+
+suspect_close();
+only = adduct;
+*skipped = 0;
+if (stat(list, &ls) != 0)
+	return 0;
+if ((store != NULL) && map_store(store, &ls))
+	{
+	suspect_mode = 1;
+	return nions;
+	}
+
+if ((*skipped = read_list(list)) < 0)
+	{
+	*skipped = 0;
+	return 0;
+	}
+if (store != NULL)
+	write_store(store, &ls);	/* else read again next time */
+ion_mz = build_mz.data();
+ions = build_ions.data();
+formulas = build_formulas.data();
+names = build_names.data();
+nions = build_mz.size();
+suspect_mode = 1;
+return nions;
+}
+
+
+/************************************************************************
+* SUSPECT_CLOSE:	Switches suspect screening off.			*
+*************************************************************************/
+void suspect_close(void)
+{
+if (map != NULL)
+	munmap(map, map_size);
+map = NULL;
+build_mz.clear();
+build_ions.clear();
+build_formulas.clear();
+build_names.clear();
+nions = 0;
+suspect_mode = 0;
+}
+
+
+/************************************************************************
+* SUSPECT_SEARCH:	The suspects whose adduct ions are within the	*
+*		window of q, in the order of their m/z: q->mass is the	*
+*		measured m/z, the sign of q->charge the polarity of the	*
+*		adducts (0 = both). The hits are the neutral formulas,	*
+*		error is that of the m/z, see suspect_label().		*
+* Input: 	query, vector the hits are appended to, optional stats.	*
+* Returns. 	number of hits.	       				*
+*************************************************************************/
+long suspect_search(const Query *q, vector<Candidate> &hits, SearchStats *stats)
+{
+const double *p;
+Candidate c;
+double lo, hi;
+size_t first = hits.size();
+long long t0, evaluated = 0;
+int i;
+
+t0 = clock_ns();
+lo = q->mass - (q->tol / 1000.0);
+hi = q->mass + (q->tol / 1000.0);
+memset(&c, 0, sizeof(c));
+for (p = lower_bound(ion_mz, ion_mz + nions, lo); (p < ion_mz + nions) && (*p <= hi); p++)
+	{
+	const SuspectIon &ion = ions[p - ion_mz];
+	const SuspectFormula &s = formulas[ion.formula];
+
+	evaluated++;
+	if ((only != NULL) ? (&adducts[ion.adduct] != only) : (q->charge * adducts[ion.adduct].z < 0))
+		continue;
+	for (i = 0; i < nr_el; i++)
+		c.cnt[i] = s.cnt[i];
+	c.rdb = s.rdb;
+	c.lewis = s.lewis;
+	c.mass = s.mass;
+	c.error = 1000.0 * (q->mass - *p);
+	c.ref = p - ion_mz;
+	hits.push_back(c);
+	}
+
+if (stats != NULL)
+	{
+	memset(stats, 0, sizeof(*stats));
+	stats->evaluated = evaluated;
+	stats->hits = hits.size() - first;
+	stats->ns_enumerate = clock_ns() - t0;
+	}
+return hits.size() - first;
+}
+
+
+/************************************************************************
+* SUSPECT_LABEL:	Adduct and name of a hit of suspect_search(),	*
+*		"[M+H]+;Ala".						*
+*************************************************************************/
+string suspect_label(const Candidate &c)
+{
+return string(adducts[ions[c.ref].adduct].name) + ";" + (names + formulas[ions[c.ref].formula].name);
+}
@@ -0,0 +1,296 @@
+/*
+
+SMWORKERS.CPP
+
+ A batch of queries on worker processes, shared-nothing: the queries
+ are split into parts by split_batch() of smbatch.cpp (a single large
+ query along its outermost levels), the parts are dealt to the workers longest
+ first, each to the one with the least work so far (LPT), and every
+ worker is a fork()ed process (optionally pinned to a CPU) that
+ searches its parts and sends the hits back on a pipe. The coordinator
+ joins the parts of each query in their order, so the result does
+ not depend on which worker was faster, and ranks them (join_parts()).
+
+ Frames on the pipe, of fixed-size fields only (no pointers, so the
+ same could go to another host of the same byte order): a FrameHead
+ (magic "SMW1", the part no., the no. of hits, the stats of the part),
+ then the hits as WireHit records; a frame with part -1 ends the
+ stream. A worker that dies before it is an error.
+
+ Copyright (c) 2026, distributed under the terms of version 2 of the
+ GNU General Public License, see smformula_stdout.cpp.
+
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE			/* sched_setaffinity() */
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <vector>
+#include "smformula.h"
+using namespace std;
+
+typedef struct	{
+		char	magic[4];	/* "SMW1" */
+		int	part;		/* -1 = end of the stream */
+		long long nhits;
+		SearchStats st;
+		} FrameHead;
+
+typedef struct	{			/* a hit on the wire */
+		int	cnt[NEL];
+		float	rdb, lewis;
+		double	mass, error;
+		long	ref;		/* suspect_search(): the adduct ion */
+		} WireHit;
+
+static int write_all(int fd, const void *buf, size_t n)
+{
+const char *p = (const char *)buf;
+ssize_t k;
+
+while (n > 0)
+	{
+	k = write(fd, p, n);
+	if ((k < 0) && (errno == EINTR))
+		continue;
+	if (k <= 0)
+		return 0;
+	p += k;
+	n -= k;
+	}
+return 1;
+}
+
+
+/* the worker: its parts, in order, then the end frame */
+static void run_worker(vector<QueryPart> &parts, const vector<int> &worker, int w, int fd, int pin)
+{
+vector<WireHit> wire;
+FrameHead h;
+cpu_set_t cpus;
+size_t k, i;
+
+if (pin)
+	{
+	CPU_ZERO(&cpus);
+	CPU_SET(w % sysconf(_SC_NPROCESSORS_ONLN), &cpus);
+	sched_setaffinity(0, sizeof(cpus), &cpus);	/* best effort */
+	}
+for (k = 0; k < parts.size(); k++)
+	{
+	if (worker[k] != w)
+		continue;
+	parts[k].hits.clear();
+	memset(&h, 0, sizeof(h));
+	search_hits(&parts[k].q, parts[k].hits, &h.st);
+	memcpy(h.magic, "SMW1", 4);
+	h.part = k;
+	h.nhits = parts[k].hits.size();
+	wire.resize(parts[k].hits.size());
+	for (i = 0; i < parts[k].hits.size(); i++)
+		{
+		memcpy(wire[i].cnt, parts[k].hits[i].cnt, sizeof(wire[i].cnt));
+		wire[i].rdb = parts[k].hits[i].rdb;
+		wire[i].lewis = parts[k].hits[i].lewis;
+		wire[i].mass = parts[k].hits[i].mass;
+		wire[i].error = parts[k].hits[i].error;
+		wire[i].ref = parts[k].hits[i].ref;
+		}
+	if (!write_all(fd, &h, sizeof(h)) || !write_all(fd, wire.data(), wire.size() * sizeof(WireHit)))
+		_exit(1);
+	vector<Candidate>().swap(parts[k].hits);
+	}
+memset(&h, 0, sizeof(h));
+memcpy(h.magic, "SMW1", 4);
+h.part = -1;
+_exit(write_all(fd, &h, sizeof(h)) ? 0 : 1);
+}
+
+
+/* complete frames at the start of buf into the parts; returns 1 at the end frame, -1 if bad */
+static int read_frames(vector<char> &buf, vector<QueryPart> &parts, vector<char> &done)
+{
+FrameHead h;
+const WireHit *wire;
+Candidate c;
+size_t used = 0, need;
+long long i;
+int end = 0;
+
+memset(&c, 0, sizeof(c));
+while (!end && (buf.size() - used >= sizeof(FrameHead)))
+	{
+	memcpy(&h, &buf[used], sizeof(h));
+	if (memcmp(h.magic, "SMW1", 4) || (h.part >= (int)parts.size()) || (h.nhits < 0))
+		return -1;
+	if (h.part < 0)
+		{
+		used += sizeof(h);
+		end = 1;
+		break;
+		}
+	need = sizeof(h) + h.nhits * sizeof(WireHit);
+	if (buf.size() - used < need)
+		break;
+	wire = (const WireHit *)&buf[used + sizeof(h)];
+	QueryPart &p = parts[h.part];
+	for (i = 0; i < h.nhits; i++)
+		{
+		memcpy(c.cnt, wire[i].cnt, sizeof(c.cnt));
+		c.rdb = wire[i].rdb;
+		c.lewis = wire[i].lewis;
+		c.mass = wire[i].mass;
+		c.error = wire[i].error;
+		c.ref = wire[i].ref;
+		p.hits.push_back(c);
+		}
+	p.st = h.st;
+	done[h.part] = 1;
+	used += need;
+	}
+buf.erase(buf.begin(), buf.begin() + used);
+return end;
+}
+
+
+/************************************************************************
+* FORK_SEARCH:	search_ranked() of every query of a batch on 'nworkers'	*
+*		fork()ed processes (see above); a single query is split	*
+*		among them along its outer levels.			*
+* Input: 	queries, hits[j] for qs[j] (hits are appended), optional	*
+*		stats[j], no. of workers, 1 = pin worker w to CPU w,	*
+*		optional no. of parts returned.				*
+* Returns. 	total no. of hits, -1 if a worker failed.		*
+*************************************************************************/
+long fork_search(const vector<Query> &qs, vector< vector<Candidate> > &hits,
+		SearchStats *stats, int nworkers, int pin, long *nparts)
+{
+vector<QueryPart> parts;
+vector< pair<double, size_t> > order;
+vector<double> load;
+vector<int> worker;
+vector<char> done;
+vector<pid_t> pid;
+vector<int> fd;
+vector<struct pollfd> pfd;
+vector< vector<char> > buf;
+vector<size_t> first;
+char chunk[65536];
+size_t j, k;
+ssize_t n;
+long nhits = 0;
+int w, open_fds, status, failed = 0, p[2], r;
+
+hits.resize(qs.size());
+if (nworkers < 1)
+	nworkers = 1;
+split_batch(qs, nworkers, parts, first);
+worker.assign(parts.size(), 0);
+done.assign(parts.size(), 0);
+
+for (k = 0; k < parts.size(); k++)	/* LPT: longest first, to the least loaded */
+	order.push_back(make_pair(-parts[k].cost, k));
+sort(order.begin(), order.end());
+load.assign(nworkers, 0.0);
+for (k = 0; k < order.size(); k++)
+	{
+	w = min_element(load.begin(), load.end()) - load.begin();
+	worker[order[k].second] = w;
+	load[w] += parts[order[k].second].cost;
+	}
+
+fflush(stdout);				/* not twice from the children */
+fflush(stderr);
+for (w = 0; w < nworkers; w++)
+	{
+	if (pipe(p) != 0)
+		{
+		failed = 1;
+		break;
+		}
+	pid.push_back(fork());
+	if (pid.back() == 0)
+		{
+		close(p[0]);
+		for (k = 0; k < fd.size(); k++)
+			close(fd[k]);
+		run_worker(parts, worker, w, p[1], pin);
+		}
+	close(p[1]);
+	if (pid.back() < 0)
+		{
+		close(p[0]);
+		pid.pop_back();
+		failed = 1;
+		break;
+		}
+	fd.push_back(p[0]);
+	}
+
+/* gather: whatever a worker has sent, until each sent its end frame */
+buf.resize(fd.size());
+pfd.resize(fd.size());
+for (k = 0; k < fd.size(); k++)
+	{
+	pfd[k].fd = fd[k];
+	pfd[k].events = POLLIN;
+	}
+for (open_fds = fd.size(); open_fds > 0; )
+	{
+	if (poll(pfd.data(), pfd.size(), -1) < 0)
+		{
+		if (errno == EINTR)
+			continue;
+		failed = 1;
+		break;
+		}
+	for (k = 0; k < pfd.size(); k++)
+		{
+		if ((pfd[k].fd < 0) || !(pfd[k].revents & (POLLIN | POLLHUP | POLLERR)))
+			continue;
+		n = read(pfd[k].fd, chunk, sizeof(chunk));
+		if ((n < 0) && (errno == EINTR))
+			continue;
+		r = 0;
+		if (n > 0)
+			{
+			buf[k].insert(buf[k].end(), chunk, chunk + n);
+			r = read_frames(buf[k], parts, done);
+			}
+		if ((n <= 0) || (r != 0))	/* end frame, EOF or garbage */
+			{
+			if (r <= 0)
+				failed = 1;
+			close(pfd[k].fd);
+			pfd[k].fd = -1;
+			open_fds--;
+			}
+		}
+	}
+for (k = 0; k < pid.size(); k++)
+	if ((waitpid(pid[k], &status, 0) != pid[k]) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+		failed = 1;
+for (k = 0; k < parts.size(); k++)
+	if (!done[k])
+		failed = 1;
+if (nparts != NULL)
+	*nparts = parts.size();
+if (failed)
+	return -1;
+
+for (j = 0; j < qs.size(); j++)		/* join in order, rank */
+	{
+	join_parts(&qs[j], parts, first[j], first[j + 1], hits[j], (stats != NULL) ? &stats[j] : NULL);
+	nhits += hits[j].size();
+	}
+return nhits;
+}